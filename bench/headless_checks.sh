@@ -0,0 +1,40 @@
+#!/bin/bash
+# Runs the headless update commands against an empty registry, as on a
+# machine where nothing was installed from a URL, and checks that each
+# returns promptly with "nothing to do".
+#
+# Usage: bench/headless_checks.sh <VSC-INSTALLER-PLUS binary>
+
+set -euo pipefail
+
+INSTALLER=${1:?"Uso: $0 <binario>"}
+HOME_DIR=$(mktemp -d /tmp/vscip-headless.XXXXXX)
+
+cleanup() {
+    rm -rf "$HOME_DIR"
+}
+trap cleanup EXIT
+
+# A fresh HOME and XDG dirs give the installer an empty registry
+run() {
+    HOME="$HOME_DIR" XDG_DATA_HOME="$HOME_DIR/data" XDG_CACHE_HOME="$HOME_DIR/cache" \
+        timeout 30 "$INSTALLER" "$@" > "$HOME_DIR/out.log" 2>&1
+}
+
+status=0
+for command in --check-updates --prefetch-updates; do
+    if run "$command"; then
+        printf '%-20s ok\n' "$command"
+    else
+        code=$?
+        if [ "$code" -eq 124 ]; then
+            printf '%-20s no terminó en 30 s\n' "$command"
+        else
+            printf '%-20s código de salida %d\n' "$command" "$code"
+        fi
+        cat "$HOME_DIR/out.log"
+        status=1
+    fi
+done
+
+exit "$status"
@@ -0,0 +1,93 @@
+#!/bin/bash
+# Measures how much an install slows down an I/O-heavy workload running at
+# the same time, with the default policy and with --background / --io-limit.
+#
+# Usage: bench/io_contention.sh <VSC-INSTALLER-PLUS binary> [tarball] [io-limit MB/s]
+#
+# Without a tarball a synthetic editor-like archive (many small files plus a
+# few large ones, ~600 MB unpacked) is generated. Everything is written under
+# $BENCH_DIR (default: a directory in /var/tmp, i.e. on disk rather than tmpfs).
+
+set -euo pipefail
+
+INSTALLER=${1:?"Uso: $0 <binario> [tarball] [limite MB/s]"}
+TARBALL=${2:-}
+IO_LIMIT=${3:-40}
+BENCH_DIR=${BENCH_DIR:-$(mktemp -d /var/tmp/vscip-bench.XXXXXX)}
+LOAD_MB=${LOAD_MB:-2048}
+
+cleanup() {
+    rm -rf "$BENCH_DIR"
+}
+trap cleanup EXIT
+
+make_tarball() {
+    local src="$BENCH_DIR/payload/bench-editor"
+    mkdir -p "$src/resources/app/node_modules"
+    for i in $(seq 1 4000); do
+        head -c $((RANDOM * 4)) /dev/urandom > "$src/resources/app/node_modules/f$i.js"
+    done
+    for i in 1 2 3; do
+        head -c $((100 * 1024 * 1024)) /dev/urandom > "$src/lib$i.so"
+    done
+    printf '#!/bin/sh\necho 1.0.0\n' > "$src/bench-editor"
+    chmod +x "$src/bench-editor"
+    tar -C "$BENCH_DIR/payload" -czf "$BENCH_DIR/bench-editor.tar.gz" bench-editor
+    rm -rf "$BENCH_DIR/payload"
+    TARBALL="$BENCH_DIR/bench-editor.tar.gz"
+}
+
+# Stand-in for a build: sequential writes synced to disk, then read back
+# uncached. Prints MB/s.
+workload() {
+    local file="$BENCH_DIR/load.bin"
+    local start end
+    start=$(date +%s.%N)
+    dd if=/dev/zero of="$file" bs=1M count="$LOAD_MB" conv=fdatasync status=none
+    dd if="$file" of=/dev/null bs=1M iflag=direct status=none
+    end=$(date +%s.%N)
+    rm -f "$file"
+    echo "scale=1; 2 * $LOAD_MB / ($end - $start)" | bc
+}
+
+cached_mb() {
+    awk '/^Cached:/ { print int($2 / 1024) }' /proc/meminfo
+}
+
+run_install() {
+    local target="$BENCH_DIR/apps-$1"
+    shift
+    rm -rf "$target"
+    mkdir -p "$target"
+    local start end
+    start=$(date +%s.%N)
+    "$INSTALLER" --install "$TARBALL" --install-path "$target" "$@" > "$BENCH_DIR/install.log" 2>&1
+    end=$(date +%s.%N)
+    rm -rf "$target"
+    echo "scale=1; ($end - $start) / 1" | bc
+}
+
+# Runs the workload while an install with the given flags is in progress
+contended() {
+    local name=$1
+    shift
+    sync
+    local before
+    before=$(cached_mb)
+    run_install "$name" "$@" > "$BENCH_DIR/install-time" &
+    local pid=$!
+    sleep 1
+    local rate
+    rate=$(workload)
+    wait "$pid"
+    printf '%-28s %10s %12s %14s\n' "$name" "$rate" "$(cat "$BENCH_DIR/install-time")" "$(( $(cached_mb) - before ))"
+}
+
+[ -n "$TARBALL" ] || make_tarball
+
+printf '%-28s %10s %12s %14s\n' "escenario" "carga MB/s" "instalar s" "cache +MB"
+sync
+printf '%-28s %10s %12s %14s\n' "solo carga" "$(workload)" "-" "-"
+contended "normal"
+contended "--background" --background
+contended "--background --io-limit $IO_LIMIT" --background --io-limit "$IO_LIMIT"
@@ -0,0 +1,734 @@
+// Times the phases of an install (extraction, executable lookup, copy into
+// place, manifest hashing, removal) on synthetic archives shaped like an
+// Electron editor, in every archive format the installer accepts.
+//
+// Usage: vscip_bench [--files N] [--seed N] [--runs N] [--formats a,b]
+//                    [--work-dir DIR] [--output FILE] [--drop-caches]
+//
+// The payload is generated from the seed alone and archived with fixed
+// ordering, owners and times, so the same options give byte-identical
+// archives on every machine. Results are written as JSON.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <fcntl.h>
+#include <random>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Installer.h"
+#include "InstallManifest.h"
+
+namespace {
+
+const QString EDITOR_NAME = "bench-editor";
+// 2024-01-01T00:00:00Z, the time of every generated file and archive entry
+const qint64 PAYLOAD_EPOCH = 1704067200;
+
+QTextStream &err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+// Resource counters of this process and its reaped children
+struct Counters
+{
+    qint64 rchar = 0;
+    qint64 wchar = 0;
+    qint64 syscr = 0;
+    qint64 syscw = 0;
+    qint64 readBytes = 0;     // Bytes that reached the block layer
+    qint64 writeBytes = 0;
+    qint64 minorFaults = 0;
+    qint64 majorFaults = 0;
+    qint64 contextSwitches = 0;
+    double cpuSeconds = 0;
+    qint64 childMaxRssKb = 0;
+};
+
+double seconds(const timeval &time)
+{
+    return time.tv_sec + time.tv_usec / 1e6;
+}
+
+Counters sampleCounters()
+{
+    Counters counters;
+
+    // /proc/self/io includes children that were waited for, like tar and xz
+    QFile io("/proc/self/io");
+    if (io.open(QIODevice::ReadOnly)) {
+        foreach (const QByteArray &line, io.readAll().split('\n')) {
+            QList<QByteArray> field = line.split(':');
+            if (field.size() != 2) {
+                continue;
+            }
+            qint64 value = field.at(1).trimmed().toLongLong();
+            if (field.at(0) == "rchar") {
+                counters.rchar = value;
+            } else if (field.at(0) == "wchar") {
+                counters.wchar = value;
+            } else if (field.at(0) == "syscr") {
+                counters.syscr = value;
+            } else if (field.at(0) == "syscw") {
+                counters.syscw = value;
+            } else if (field.at(0) == "read_bytes") {
+                counters.readBytes = value;
+            } else if (field.at(0) == "write_bytes") {
+                counters.writeBytes = value;
+            }
+        }
+    }
+
+    rusage self = {};
+    rusage children = {};
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+
+    counters.minorFaults = self.ru_minflt + children.ru_minflt;
+    counters.majorFaults = self.ru_majflt + children.ru_majflt;
+    counters.contextSwitches = self.ru_nvcsw + self.ru_nivcsw + children.ru_nvcsw + children.ru_nivcsw;
+    counters.cpuSeconds = seconds(self.ru_utime) + seconds(self.ru_stime)
+                          + seconds(children.ru_utime) + seconds(children.ru_stime);
+    counters.childMaxRssKb = children.ru_maxrss;
+    return counters;
+}
+
+// Peak RSS is a high-water mark; writing 5 to clear_refs restarts it, so
+// each phase reports its own peak instead of the largest one so far
+void resetPeakRss()
+{
+    int fd = ::open("/proc/self/clear_refs", O_WRONLY);
+    if (fd >= 0) {
+        ssize_t written = ::write(fd, "5", 1);
+        Q_UNUSED(written);
+        ::close(fd);
+    }
+}
+
+qint64 peakRssKb()
+{
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly)) {
+        foreach (const QByteArray &line, status.readAll().split('\n')) {
+            if (line.startsWith("VmHWM:")) {
+                return line.mid(6).trimmed().split(' ').first().toLongLong();
+            }
+        }
+    }
+    return 0;
+}
+
+void dropCaches()
+{
+    ::sync();
+    QFile control("/proc/sys/vm/drop_caches");
+    if (control.open(QIODevice::WriteOnly)) {
+        control.write("3\n");
+    }
+}
+
+// Measured run of one phase
+struct PhaseResult
+{
+    QString name;
+    double wallSeconds = 0;
+    qint64 bytes = 0;
+    int files = 0;
+    bool ok = true;
+    qint64 peakRssKb = 0;
+    Counters delta;
+};
+
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(const QString &name)
+    {
+        m_result.name = name;
+        resetPeakRss();
+        m_before = sampleCounters();
+        m_timer.start();
+    }
+
+    PhaseResult finish(qint64 bytes, int files, bool ok)
+    {
+        m_result.wallSeconds = m_timer.nsecsElapsed() / 1e9;
+        Counters after = sampleCounters();
+
+        m_result.bytes = bytes;
+        m_result.files = files;
+        m_result.ok = ok;
+        m_result.peakRssKb = peakRssKb();
+        m_result.delta.rchar = after.rchar - m_before.rchar;
+        m_result.delta.wchar = after.wchar - m_before.wchar;
+        m_result.delta.syscr = after.syscr - m_before.syscr;
+        m_result.delta.syscw = after.syscw - m_before.syscw;
+        m_result.delta.readBytes = after.readBytes - m_before.readBytes;
+        m_result.delta.writeBytes = after.writeBytes - m_before.writeBytes;
+        m_result.delta.minorFaults = after.minorFaults - m_before.minorFaults;
+        m_result.delta.majorFaults = after.majorFaults - m_before.majorFaults;
+        m_result.delta.contextSwitches = after.contextSwitches - m_before.contextSwitches;
+        m_result.delta.cpuSeconds = after.cpuSeconds - m_before.cpuSeconds;
+        // Only grows; a child peak above every earlier one belongs to this phase
+        m_result.delta.childMaxRssKb = after.childMaxRssKb > m_before.childMaxRssKb ? after.childMaxRssKb : 0;
+        return m_result;
+    }
+
+private:
+    PhaseResult m_result;
+    Counters m_before;
+    QElapsedTimer m_timer;
+};
+
+QJsonObject toJson(const PhaseResult &result)
+{
+    double wall = qMax(result.wallSeconds, 1e-9);
+
+    QJsonObject json;
+    json["phase"] = result.name;
+    json["ok"] = result.ok;
+    json["wall_seconds"] = result.wallSeconds;
+    json["cpu_seconds"] = result.delta.cpuSeconds;
+    json["bytes"] = double(result.bytes);
+    json["files"] = result.files;
+    json["mb_per_second"] = result.bytes / wall / (1024.0 * 1024.0);
+    json["files_per_second"] = result.files / wall;
+    json["peak_rss_kb"] = double(result.peakRssKb);
+    json["child_peak_rss_kb"] = double(result.delta.childMaxRssKb);
+    json["read_syscalls"] = double(result.delta.syscr);
+    json["write_syscalls"] = double(result.delta.syscw);
+    json["read_chars"] = double(result.delta.rchar);
+    json["write_chars"] = double(result.delta.wchar);
+    json["block_read_bytes"] = double(result.delta.readBytes);
+    json["block_write_bytes"] = double(result.delta.writeBytes);
+    json["minor_faults"] = double(result.delta.minorFaults);
+    json["major_faults"] = double(result.delta.majorFaults);
+    json["context_switches"] = double(result.delta.contextSwitches);
+    return json;
+}
+
+// Deterministic editor-shaped tree: a few large binaries and .pak files,
+// locale packs, and a node_modules forest of small scripts
+class PayloadGenerator
+{
+public:
+    PayloadGenerator(quint32 seed, int files)
+        : m_random(seed)
+        , m_files(files)
+        , m_bytes(0)
+        , m_written(0)
+    {
+        // Source text draws from a fixed vocabulary so it compresses like code
+        static const char *keywords[] = {
+            "function", "const", "return", "export", "import", "require", "this", "new",
+            "if", "else", "for", "while", "async", "await", "class", "extends", "null",
+            "undefined", "true", "false", "typeof", "module", "exports", "Promise",
+        };
+        for (const char *keyword : keywords) {
+            m_vocabulary << QByteArray(keyword);
+        }
+        for (int i = 0; i < 488; ++i) {
+            QByteArray word;
+            int length = 3 + int(m_random() % 10);
+            for (int c = 0; c < length; ++c) {
+                word.append(char('a' + m_random() % 26));
+            }
+            m_vocabulary << word;
+        }
+    }
+
+    bool generate(const QString &root)
+    {
+        QString base = root + "/" + EDITOR_NAME;
+
+        // Large natives: executable, V8 snapshot, ICU data, shared libraries
+        writeBinary(base + "/" + EDITOR_NAME, 48 * 1024 * 1024, true);
+        writeBinary(base + "/chrome-sandbox", 256 * 1024, true);
+        writeBinary(base + "/chrome_crashpad_handler", 1536 * 1024, true);
+        writeBinary(base + "/libffmpeg.so", 3 * 1024 * 1024, false);
+        writeBinary(base + "/libEGL.so", 512 * 1024, false);
+        writeBinary(base + "/libGLESv2.so", 7 * 1024 * 1024, false);
+        writeBinary(base + "/libvk_swiftshader.so", 5 * 1024 * 1024, false);
+        writeBinary(base + "/v8_context_snapshot.bin", 2 * 1024 * 1024, false);
+        writeBinary(base + "/icudtl.dat", 10 * 1024 * 1024, false);
+        writePak(base + "/resources.pak", 8 * 1024 * 1024);
+        writePak(base + "/chrome_100_percent.pak", 1024 * 1024);
+        writePak(base + "/chrome_200_percent.pak", 1536 * 1024);
+
+        static const char *locales[] = {
+            "af", "am", "ar", "bg", "bn", "ca", "cs", "da", "de", "el", "en-GB", "en-US",
+            "es", "es-419", "et", "fa", "fi", "fil", "fr", "gu", "he", "hi", "hr", "hu",
+            "id", "it", "ja", "kn", "ko", "lt", "lv", "ml", "mr", "ms", "nb", "nl", "pl",
+            "pt-BR", "pt-PT", "ro", "ru", "sk", "sl", "sr", "sv", "sw", "ta", "te", "th",
+            "tr", "uk", "ur", "vi", "zh-CN", "zh-TW",
+        };
+        for (const char *locale : locales) {
+            writeText(base + "/locales/" + locale + ".pak", 250 * 1024 + int(m_random() % (400 * 1024)));
+        }
+
+        writeText(base + "/resources/app/package.json", 4 * 1024, "{\"name\":\"bench-editor\",\"version\":\"1.0.0\",");
+        writeText(base + "/resources/app/product.json", 32 * 1024);
+        writeText(base + "/LICENSES.chromium.html", 8 * 1024 * 1024);
+
+        // Whatever is left of the file count goes to small scripts, about 20
+        // per package as in a real node_modules
+        static const char *extensions[] = { ".js", ".js", ".js", ".json", ".map", ".d.ts", ".md" };
+        int package = 0;
+        while (m_written < m_files) {
+            QString dir = QString("%1/resources/app/node_modules/pkg%2").arg(base).arg(package, 4, 10, QChar('0'));
+            int depth = int(m_random() % 3);
+            for (int level = 0; level < depth; ++level) {
+                dir += QString("/%1").arg(QString::fromLatin1(m_vocabulary.at(24 + int(m_random() % 64))));
+            }
+
+            int count = qMin(10 + int(m_random() % 21), m_files - m_written);
+            for (int i = 0; i < count; ++i) {
+                // Mostly a few KiB, now and then up to 128 KiB; std:: distributions
+                // differ between standard libraries, so the shape is drawn by hand
+                qint64 size = 64 + qint64(m_random() % (1u << (7 + m_random() % 11)));
+                QString name = QString("file%1%2").arg(i).arg(extensions[m_random() % 7]);
+                if (!writeText(dir + "/" + name, size)) {
+                    return false;
+                }
+            }
+            package++;
+        }
+
+        // The bin/ launcher of the real archives
+        QDir().mkpath(base + "/bin");
+        QFile::link("../" + EDITOR_NAME, base + "/bin/" + EDITOR_NAME);
+
+        return !m_failed && setTimes(root + "/" + EDITOR_NAME);
+    }
+
+    qint64 bytes() const { return m_bytes; }
+    int files() const { return m_written; }
+
+private:
+    bool writeFile(const QString &path, const QByteArray &data, bool executable)
+    {
+        QDir().mkpath(QFileInfo(path).path());
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size()) {
+            m_failed = true;
+            return false;
+        }
+        file.setPermissions(executable ? QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner
+                                             | QFileDevice::ReadGroup | QFileDevice::ExeGroup
+                                             | QFileDevice::ReadOther | QFileDevice::ExeOther
+                                       : QFileDevice::ReadOwner | QFileDevice::WriteOwner
+                                             | QFileDevice::ReadGroup | QFileDevice::ReadOther);
+        m_bytes += data.size();
+        m_written++;
+        return true;
+    }
+
+    // Machine code compresses to about half: random bytes interleaved with
+    // repeated runs
+    bool writeBinary(const QString &path, qint64 size, bool executable)
+    {
+        QByteArray data(int(size), Qt::Uninitialized);
+        for (qint64 i = 0; i < size; i += 8) {
+            quint64 word = (i / 4096) % 2 ? 0x9090909048c3c031ULL : quint64(m_random());
+            memcpy(data.data() + i, &word, size_t(qMin<qint64>(8, size - i)));
+        }
+        if (executable) {
+            memcpy(data.data(), "\x7f" "ELF\x02\x01\x01", 7);
+        }
+        return writeFile(path, data, executable);
+    }
+
+    // Resource packs: a header, then mostly compressible text and some images
+    bool writePak(const QString &path, qint64 size)
+    {
+        QByteArray data = text(size / 2);
+        QByteArray images(int(size - data.size()), Qt::Uninitialized);
+        for (int i = 0; i + 8 <= images.size(); i += 8) {
+            quint64 word = m_random();
+            memcpy(images.data() + i, &word, 8);
+        }
+        data.prepend(QByteArray("\x05\x00\x00\x00", 4));
+        return writeFile(path, data + images, false);
+    }
+
+    bool writeText(const QString &path, qint64 size, const QByteArray &prefix = QByteArray())
+    {
+        QByteArray data = prefix + text(size - prefix.size());
+        return writeFile(path, data, false);
+    }
+
+    QByteArray text(qint64 size)
+    {
+        QByteArray data;
+        data.reserve(int(size) + 16);
+        while (data.size() < size) {
+            data.append(m_vocabulary.at(int(m_random() % m_vocabulary.size())));
+            int punctuation = int(m_random() % 8);
+            data.append(punctuation == 0 ? "(" : punctuation == 1 ? ");\n" : punctuation == 2 ? "." : " ");
+        }
+        data.truncate(int(size));
+        return data;
+    }
+
+    bool setTimes(const QString &root)
+    {
+        timespec times[2] = { { PAYLOAD_EPOCH, 0 }, { PAYLOAD_EPOCH, 0 } };
+        QStringList pending(root);
+        while (!pending.isEmpty()) {
+            QString path = pending.takeLast();
+            QFileInfo info(path);
+            if (info.isDir() && !info.isSymLink()) {
+                foreach (const QString &name, QDir(path).entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot | QDir::Hidden)) {
+                    pending << path + "/" + name;
+                }
+            }
+            if (utimensat(AT_FDCWD, QFile::encodeName(path).constData(), times, AT_SYMLINK_NOFOLLOW) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::mt19937 m_random;
+    QList<QByteArray> m_vocabulary;
+    int m_files;
+    qint64 m_bytes;
+    int m_written;
+    bool m_failed = false;
+};
+
+bool run(const QString &program, const QStringList &arguments, const QString &workingDir = QString(),
+         const QString &inputFile = QString(), const QString &outputFile = QString())
+{
+    QProcess process;
+    if (!workingDir.isEmpty()) {
+        process.setWorkingDirectory(workingDir);
+    }
+    if (!inputFile.isEmpty()) {
+        process.setStandardInputFile(inputFile);
+    }
+    if (!outputFile.isEmpty()) {
+        process.setStandardOutputFile(outputFile);
+    }
+    process.start(program, arguments);
+    return process.waitForFinished(-1) && process.exitStatus() == QProcess::NormalExit
+           && process.exitCode() == 0;
+}
+
+// Writes the payload in each requested format with reproducible flags.
+// Returns format name to archive path.
+QList<QPair<QString, QString>> buildArchives(const QString &payloadDir, const QString &archiveDir,
+                                             const QStringList &formats)
+{
+    QList<QPair<QString, QString>> archives;
+    QDir().mkpath(archiveDir);
+
+    QString tar = archiveDir + "/" + EDITOR_NAME + ".tar";
+    QStringList tarArguments;
+    tarArguments << "--sort=name" << QString("--mtime=@%1").arg(PAYLOAD_EPOCH)
+                 << "--owner=0" << "--group=0" << "--numeric-owner" << "--format=gnu"
+                 << "-C" << payloadDir << "-cf" << tar << EDITOR_NAME;
+    if (!run("tar", tarArguments)) {
+        err() << "ERROR: No se pudo crear " << tar << "\n";
+        return archives;
+    }
+
+    struct Encoder {
+        const char *format;
+        const char *program;
+        QStringList arguments;
+    };
+    QList<Encoder> encoders;
+    encoders << Encoder{ "tar.gz", "gzip", QStringList() << "-n" << "-6" << "-c" }
+             << Encoder{ "tar.bz2", "bzip2", QStringList() << "-9" << "-c" }
+             << Encoder{ "tar.xz", "xz", QStringList() << "-6" << "-T1" << "-c" }
+             << Encoder{ "tar.zst", "zstd", QStringList() << "-q" << "-19" << "-T1" << "-c" };
+
+    foreach (const QString &format, formats) {
+        QString path = archiveDir + "/" + EDITOR_NAME + "." + format;
+        bool ok = false;
+        bool known = false;
+
+        if (format == "tar") {
+            known = true;
+            ok = true;
+        } else if (format == "zip") {
+            known = true;
+            if (QStandardPaths::findExecutable("zip").isEmpty()) {
+                err() << "Omitido zip: no se encontró el programa zip\n";
+                continue;
+            }
+            QFile::remove(path);
+            // -X: no extra uid/gid fields; -y: store symlinks as links
+            ok = run("zip", QStringList() << "-q" << "-r" << "-X" << "-y" << path << EDITOR_NAME, payloadDir);
+        } else {
+            bool missing = false;
+            foreach (const Encoder &encoder, encoders) {
+                if (format != encoder.format) {
+                    continue;
+                }
+                known = true;
+                missing = QStandardPaths::findExecutable(encoder.program).isEmpty();
+                if (missing) {
+                    err() << "Omitido " << format << ": no se encontró " << encoder.program << "\n";
+                } else {
+                    ok = run(encoder.program, encoder.arguments, QString(), tar, path);
+                }
+            }
+            if (missing) {
+                continue;
+            }
+        }
+
+        if (!known) {
+            err() << "Formato desconocido: " << format << "\n";
+        } else if (!ok) {
+            err() << "ERROR: No se pudo crear " << path << "\n";
+        } else {
+            archives << qMakePair(format, path);
+        }
+    }
+
+    return archives;
+}
+
+qint64 treeBytes(const QVector<ManifestEntry> &entries, int *files)
+{
+    qint64 bytes = 0;
+    *files = 0;
+    foreach (const ManifestEntry &entry, entries) {
+        if (entry.kind == ManifestEntry::File) {
+            bytes += entry.size;
+            (*files)++;
+        }
+    }
+    return bytes;
+}
+
+} // namespace
+
+// Befriended by Installer to reach the phases that are not public API
+class PipelineBench
+{
+public:
+    PipelineBench(Installer &installer, const QString &workDir, bool coldCache)
+        : m_installer(installer)
+        , m_workDir(workDir)
+        , m_coldCache(coldCache)
+    {
+    }
+
+    QJsonArray measure(const QString &archivePath, qint64 payloadBytes, int payloadFiles)
+    {
+        QJsonArray phases;
+        QString extractDir = m_workDir + "/extract";
+        QString copyDir = m_workDir + "/copy";
+        QDir(extractDir).removeRecursively();
+        QDir(copyDir).removeRecursively();
+        QDir().mkpath(extractDir);
+
+        prepare();
+        PhaseTimer extract("extract");
+        bool ok = m_installer.extractTarball(archivePath, extractDir);
+        phases.append(toJson(extract.finish(payloadBytes, payloadFiles, ok)));
+        if (!ok) {
+            return phases;
+        }
+
+        QString tree = extractDir + "/" + EDITOR_NAME;
+        prepare();
+        PhaseTimer lookup("find_executable");
+        QString executable = m_installer.findExecutableInDirectoryRecursive(extractDir, 0);
+        phases.append(toJson(lookup.finish(0, 1, executable.endsWith("/" + EDITOR_NAME))));
+
+        prepare();
+        PhaseTimer copy("copy");
+        ok = m_installer.copyDirectoryRecursively(tree, copyDir);
+        phases.append(toJson(copy.finish(payloadBytes, payloadFiles, ok)));
+
+        prepare();
+        PhaseTimer manifest("manifest");
+        QVector<ManifestEntry> entries = InstallManifest::scanTree(copyDir);
+        int hashedFiles = 0;
+        qint64 hashedBytes = treeBytes(entries, &hashedFiles);
+        phases.append(toJson(manifest.finish(hashedBytes, hashedFiles, hashedFiles == payloadFiles)));
+
+        prepare();
+        PhaseTimer removal("remove");
+        int failures = InstallManifest::removeEntries(entries);
+        ok = QDir(extractDir).removeRecursively() && QDir(copyDir).removeRecursively() && failures == 0;
+        phases.append(toJson(removal.finish(0, payloadFiles * 2, ok)));
+
+        return phases;
+    }
+
+private:
+    void prepare()
+    {
+        if (m_coldCache) {
+            dropCaches();
+        }
+    }
+
+    Installer &m_installer;
+    QString m_workDir;
+    bool m_coldCache;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("vscip_bench");
+
+    // The installer's database and caches go to a throwaway location
+    QStandardPaths::setTestModeEnabled(true);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Mide las fases de instalación con paquetes sintéticos");
+    parser.addHelpOption();
+
+    QCommandLineOption filesOption("files", "Número de archivos del paquete (10000-50000).", "N", "20000");
+    QCommandLineOption seedOption("seed", "Semilla del contenido generado.", "N", "1");
+    QCommandLineOption runsOption("runs", "Repeticiones por formato; se informa la mediana.", "N", "3");
+    QCommandLineOption formatsOption("formats", "Formatos separados por comas.", "lista",
+                                     "tar,tar.gz,tar.bz2,tar.xz,tar.zst,zip");
+    QCommandLineOption workDirOption("work-dir", "Directorio de trabajo (mejor en disco que en tmpfs).", "dir");
+    QCommandLineOption outputOption("output", "Archivo JSON de resultados (por defecto, la salida estándar).", "archivo");
+    QCommandLineOption dropCachesOption("drop-caches", "Vacía la caché de páginas antes de cada fase (requiere root).");
+    parser.addOption(filesOption);
+    parser.addOption(seedOption);
+    parser.addOption(runsOption);
+    parser.addOption(formatsOption);
+    parser.addOption(workDirOption);
+    parser.addOption(outputOption);
+    parser.addOption(dropCachesOption);
+    parser.process(app);
+
+    int files = qBound(100, parser.value(filesOption).toInt(), 200000);
+    quint32 seed = parser.value(seedOption).toUInt();
+    int runs = qMax(1, parser.value(runsOption).toInt());
+    QStringList formats = parser.value(formatsOption).split(',', QString::SkipEmptyParts);
+
+    bool ownWorkDir = !parser.isSet(workDirOption);
+    QString workDir = ownWorkDir
+                      ? QString("/var/tmp/vscip-bench-%1").arg(QCoreApplication::applicationPid())
+                      : QDir(parser.value(workDirOption)).absolutePath();
+    if (!QDir().mkpath(workDir)) {
+        err() << "ERROR: No se pudo crear " << workDir << "\n";
+        return 1;
+    }
+
+    err() << "Generando " << files << " archivos (semilla " << seed << ") en " << workDir << "\n";
+    err().flush();
+    QString payloadDir = workDir + "/payload";
+    QDir(payloadDir).removeRecursively();
+    PayloadGenerator generator(seed, files);
+    if (!generator.generate(payloadDir)) {
+        err() << "ERROR: No se pudo generar el contenido\n";
+        return 1;
+    }
+
+    QList<QPair<QString, QString>> archives = buildArchives(payloadDir, workDir + "/archives", formats);
+    QDir(payloadDir).removeRecursively();
+
+    bool coldCache = parser.isSet(dropCachesOption);
+    if (coldCache && geteuid() != 0) {
+        err() << "Aviso: --drop-caches requiere root; se mide con caché caliente\n";
+        coldCache = false;
+    }
+
+    Installer installer;
+    PipelineBench bench(installer, workDir + "/run", coldCache);
+
+    QJsonArray results;
+    bool allOk = true;
+    for (const auto &archive : archives) {
+        err() << archive.first << ": " << QFileInfo(archive.second).size() / (1024 * 1024) << " MB\n";
+        err().flush();
+
+        // Each phase keeps the run with the median wall time
+        QMap<QString, QList<QJsonObject>> samples;
+        QStringList order;
+        for (int i = 0; i < runs; ++i) {
+            foreach (const QJsonValue &value, bench.measure(archive.second, generator.bytes(), generator.files())) {
+                QJsonObject phase = value.toObject();
+                if (!samples.contains(phase["phase"].toString())) {
+                    order << phase["phase"].toString();
+                }
+                samples[phase["phase"].toString()] << phase;
+            }
+        }
+
+        QJsonArray phases;
+        foreach (const QString &name, order) {
+            QList<QJsonObject> runsOfPhase = samples.value(name);
+            std::sort(runsOfPhase.begin(), runsOfPhase.end(), [](const QJsonObject &a, const QJsonObject &b) {
+                return a["wall_seconds"].toDouble() < b["wall_seconds"].toDouble();
+            });
+            QJsonObject median = runsOfPhase.at(runsOfPhase.size() / 2);
+            median["min_wall_seconds"] = runsOfPhase.first()["wall_seconds"];
+            median["runs"] = runsOfPhase.size();
+            allOk = allOk && median["ok"].toBool();
+            phases.append(median);
+
+            err() << QString("  %1 %2 s  %3 MB/s  %4 archivos/s%5\n")
+                         .arg(name, -16)
+                         .arg(median["wall_seconds"].toDouble(), 8, 'f', 3)
+                         .arg(median["mb_per_second"].toDouble(), 8, 'f', 1)
+                         .arg(median["files_per_second"].toDouble(), 9, 'f', 0)
+                         .arg(median["ok"].toBool() ? "" : "  FALLO");
+        }
+        err().flush();
+
+        QJsonObject result;
+        result["format"] = archive.first;
+        result["archive_bytes"] = double(QFileInfo(archive.second).size());
+        result["phases"] = phases;
+        results.append(result);
+    }
+
+    QJsonObject report;
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["seed"] = double(seed);
+    report["files"] = generator.files();
+    report["payload_bytes"] = double(generator.bytes());
+    report["runs"] = runs;
+    report["cold_cache"] = coldCache;
+    report["cpus"] = QThread::idealThreadCount();
+    report["results"] = results;
+
+    QByteArray json = QJsonDocument(report).toJson();
+    if (parser.isSet(outputOption)) {
+        QFile output(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate) || output.write(json) != json.size()) {
+            err() << "ERROR: No se pudo escribir " << output.fileName() << "\n";
+            return 1;
+        }
+    } else {
+        QFile output;
+        output.open(stdout, QIODevice::WriteOnly);
+        output.write(json);
+    }
+
+    if (ownWorkDir) {
+        QDir(workDir).removeRecursively();
+    }
+
+    return allOk && !archives.isEmpty() ? 0 : 1;
+}
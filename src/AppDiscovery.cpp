@@ -0,0 +1,299 @@
+#include "AppDiscovery.h"
+#include "IconTheme.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+// Executables that ship next to an application but are not it
+const char *const HELPER_NAMES[] = {
+    "sh",
+    "bash",
+    "chmod",
+    "ln",
+    "chrome-sandbox",
+    "chrome_crashpad_handler",
+    "crashpad_handler",
+    "xdg-open",
+    "uninstall",
+    "uninstaller"
+};
+
+// Large trees that never hold the application itself
+const char *const SKIPPED_DIRS[] = {
+    "node_modules",
+    "locales",
+    "lib",
+    "share",
+    ".git"
+};
+
+struct CategoryKeywords
+{
+    const char *category;
+    const char *keywords[12];
+};
+
+// First match wins; checked against the proposed name and the file name
+const CategoryKeywords CATEGORIES[] = {
+    { "Development", { "code", "studio", "ide", "idea", "charm", "clion", "eclipse", "sublime", "git", "postman", "dbeaver", nullptr } },
+    { "Graphics", { "gimp", "inkscape", "krita", "blender", "image", "photo", "draw", "paint", "figma", "darktable", nullptr } },
+    { "AudioVideo", { "video", "audio", "music", "player", "vlc", "obs", "spotify", "kdenlive", "audacity", "mpv", nullptr } },
+    { "Network", { "browser", "firefox", "chrom", "brave", "mail", "telegram", "discord", "slack", "zoom", "signal", "torrent", nullptr } },
+    { "Office", { "office", "writer", "calc", "pdf", "obsidian", "notion", "zotero", "note", nullptr } },
+    { "Game", { "game", "steam", "lutris", "minecraft", "emulat", nullptr } },
+    { "Education", { "anki", "geogebra", "stellarium", nullptr } },
+    { "System", { "system", "monitor", "terminal", "disk", "virtualbox", "docker", nullptr } }
+};
+
+bool isHelper(const QString &fileName)
+{
+    QString name = fileName.toLower();
+    if (name.contains(".so")) {
+        return true;
+    }
+    for (const char *helper : HELPER_NAMES) {
+        if (name == QLatin1String(helper)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isSkippedDir(const QString &dirName)
+{
+    for (const char *skipped : SKIPPED_DIRS) {
+        if (dirName == QLatin1String(skipped)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// "Obsidian-1.4.16.AppImage" and "VSCode-linux-x64" become "Obsidian" and "VSCode"
+QString stem(const QString &fileName)
+{
+    QString name = fileName;
+    if (name.endsWith(".AppImage", Qt::CaseInsensitive)) {
+        name.chop(9);
+    }
+    static const QRegularExpression suffix("[-_ .](v?\\d|linux|x86_64|x64|amd64|aarch64|arm64).*$",
+                                           QRegularExpression::CaseInsensitiveOption);
+    name.remove(suffix);
+    return name;
+}
+
+QString normalized(const QString &text)
+{
+    QString result;
+    foreach (QChar c, text.toLower()) {
+        if (c.isLetterOrNumber()) {
+            result += c;
+        }
+    }
+    return result;
+}
+
+void findBest(const QString &dirPath, const QString &appDir, int depth,
+              LaunchCandidate *best, const std::atomic<bool> *cancel)
+{
+    QFileInfoList entries = QDir(dirPath).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    foreach (const QFileInfo &entry, entries) {
+        if (cancel && cancel->load()) {
+            return;
+        }
+
+        if (entry.isDir()) {
+            if (!entry.isSymLink() && depth < AppDiscovery::MAX_DEPTH && !isSkippedDir(entry.fileName())) {
+                findBest(entry.filePath(), appDir, depth + 1, best, cancel);
+            }
+            continue;
+        }
+
+        if (!entry.isExecutable()) {
+            continue;
+        }
+
+        AppDiscovery::Kind kind = AppDiscovery::classify(entry.filePath());
+        if (kind != AppDiscovery::Elf && kind != AppDiscovery::AppImage) {
+            continue;
+        }
+
+        int score = AppDiscovery::score(entry.filePath(), kind, appDir, depth);
+        if (score > best->score) {
+            best->path = entry.filePath();
+            best->score = score;
+        }
+    }
+}
+
+LaunchCandidate discover(const QFileInfo &entry, const std::atomic<bool> *cancel)
+{
+    LaunchCandidate candidate;
+    candidate.score = -1;
+    if (cancel && cancel->load()) {
+        return candidate;
+    }
+
+    QString appDir;
+    if (entry.isDir()) {
+        if (entry.isSymLink() || isSkippedDir(entry.fileName())) {
+            return candidate;
+        }
+        appDir = entry.filePath();
+        findBest(appDir, appDir, 0, &candidate, cancel);
+    } else if (entry.isExecutable()) {
+        AppDiscovery::Kind kind = AppDiscovery::classify(entry.filePath());
+        if (kind == AppDiscovery::Elf || kind == AppDiscovery::AppImage) {
+            candidate.path = entry.filePath();
+            candidate.score = AppDiscovery::score(candidate.path, kind, QString(), 0);
+        }
+    }
+
+    if (candidate.path.isEmpty() || candidate.score < 0) {
+        candidate.path.clear();
+        return candidate;
+    }
+
+    QFileInfo exec(candidate.path);
+    candidate.name = AppDiscovery::proposeName(candidate.path, appDir);
+    candidate.category = AppDiscovery::proposeCategory(candidate.name, candidate.path);
+
+    if (!appDir.isEmpty()) {
+        candidate.icon = IconTheme::findSourceIcon(appDir, stem(exec.fileName()));
+    } else {
+        // Loose files share their directory; only an icon named like the file is theirs
+        foreach (const QString &suffix, QStringList() << "svg" << "png") {
+            QString icon = exec.path() + "/" + exec.completeBaseName() + "." + suffix;
+            if (QFileInfo(icon).isFile()) {
+                candidate.icon = icon;
+                break;
+            }
+        }
+    }
+
+    return candidate;
+}
+
+} // namespace
+
+AppDiscovery::Kind AppDiscovery::classify(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return NotExecutable;
+    }
+    QByteArray header = file.read(16);
+
+    // ELF files start with 0x7F 'ELF'; AppImages also carry 'AI' and their type at offset 8
+    if (header.startsWith(QByteArray::fromHex("7F454C46"))) {
+        if (header.size() >= 11 && header.at(8) == 'A' && header.at(9) == 'I'
+            && (header.at(10) == 1 || header.at(10) == 2)) {
+            return AppImage;
+        }
+        return Elf;
+    }
+
+    if (header.startsWith("#!")) {
+        return Script;
+    }
+
+    return NotExecutable;
+}
+
+int AppDiscovery::score(const QString &path, Kind kind, const QString &appDir, int depth)
+{
+    QFileInfo info(path);
+    if (kind == NotExecutable || isHelper(info.fileName())) {
+        return -1;
+    }
+
+    int score = 0;
+    switch (kind) {
+    case AppImage:
+        score = 40;
+        break;
+    case Elf:
+        score = 20;
+        break;
+    case Script:
+    default:
+        score = 5;
+        break;
+    }
+
+    // An app's main executable is usually named after its directory
+    QString name = normalized(stem(info.fileName()));
+    QString dirName = normalized(stem(QFileInfo(appDir).fileName()));
+    if (!name.isEmpty() && !dirName.isEmpty()) {
+        if (name == dirName) {
+            score += 30;
+        } else if (name.size() >= 3 && (dirName.contains(name) || name.contains(dirName))) {
+            score += 15;
+        }
+    }
+
+    if (info.dir().dirName() == "bin") {
+        score += 3;
+    }
+
+    // The deeper the file, the more likely it is a bundled tool
+    return qMax(0, score - 5 * depth);
+}
+
+QVector<LaunchCandidate> AppDiscovery::scan(const QString &root, const std::atomic<bool> *cancel)
+{
+    QFileInfoList entries = QDir(root).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+
+    // One task per top-level entry: each app directory is walked on its own thread
+    QVector<LaunchCandidate> found = QtConcurrent::blockingMapped<QVector<LaunchCandidate>>(
+        entries, [cancel](const QFileInfo &entry) {
+            return discover(entry, cancel);
+        });
+
+    QVector<LaunchCandidate> candidates;
+    foreach (const LaunchCandidate &candidate, found) {
+        if (!candidate.path.isEmpty()) {
+            candidates.append(candidate);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const LaunchCandidate &a, const LaunchCandidate &b) {
+        return a.name.compare(b.name, Qt::CaseInsensitive) < 0;
+    });
+
+    return candidates;
+}
+
+QString AppDiscovery::proposeName(const QString &path, const QString &appDir)
+{
+    QString source = appDir.isEmpty() ? QFileInfo(path).fileName() : QFileInfo(appDir).fileName();
+    QString name = stem(source);
+    name.replace('-', ' ').replace('_', ' ');
+    name = name.simplified();
+
+    if (name.isEmpty()) {
+        return QFileInfo(path).fileName();
+    }
+    name[0] = name.at(0).toUpper();
+    return name;
+}
+
+QString AppDiscovery::proposeCategory(const QString &name, const QString &path)
+{
+    QString text = name.toLower() + " " + QFileInfo(path).fileName().toLower();
+
+    for (const CategoryKeywords &entry : CATEGORIES) {
+        for (int i = 0; entry.keywords[i]; ++i) {
+            if (text.contains(QLatin1String(entry.keywords[i]))) {
+                return QString::fromLatin1(entry.category);
+            }
+        }
+    }
+
+    return "Utility";
+}
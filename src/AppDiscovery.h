@@ -0,0 +1,53 @@
+#ifndef APPDISCOVERY_H
+#define APPDISCOVERY_H
+
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+// An application found by a directory scan, with what its launcher would say
+struct LaunchCandidate
+{
+    QString path;
+    QString name;
+    QString icon;       // Empty when the app ships none
+    QString category;   // Freedesktop main category
+    int score = 0;
+};
+
+// Decides which file of an unpacked application is the one to launch. The
+// installer uses it to pick the executable of an extracted archive and the
+// launcher generator to find every app under a directory, so both agree on
+// what an application's main executable is.
+class AppDiscovery
+{
+public:
+    enum Kind {
+        NotExecutable,
+        Elf,
+        AppImage,
+        Script
+    };
+
+    // Reads the first bytes of an executable file
+    static Kind classify(const QString &path);
+
+    // How likely path is the main executable of the app in appDir; -1 for
+    // shells, sandboxes, crash handlers and other helpers. depth is how far
+    // below appDir the file lies.
+    static int score(const QString &path, Kind kind, const QString &appDir, int depth);
+
+    // Finds applications under root on the thread pool: every AppImage or
+    // ELF directly in root, and the best ELF or AppImage of each
+    // subdirectory. Sorted by name. Blocks; cancel may be set from another
+    // thread to stop early.
+    static QVector<LaunchCandidate> scan(const QString &root, const std::atomic<bool> *cancel = nullptr);
+
+    static QString proposeName(const QString &path, const QString &appDir);
+    static QString proposeCategory(const QString &name, const QString &path);
+
+    // Subdirectories searched below each app directory
+    static const int MAX_DEPTH = 3;
+};
+
+#endif // APPDISCOVERY_H
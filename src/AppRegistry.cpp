@@ -0,0 +1,888 @@
+#include "AppRegistry.h"
+#include <QSqlError>
+#include <QDateTime>
+#include <QVariant>
+
+// Each entry upgrades the schema by one version. Entries are append-only:
+// once shipped, a migration must never be edited, only followed by a new one.
+// Versions 1 and 2 use IF NOT EXISTS because databases created before the
+// schema was versioned already contain those tables.
+static const QStringList MIGRATIONS[] = {
+    // 1: application registry
+    {
+        R"(CREATE TABLE IF NOT EXISTS installed_apps (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            app_name TEXT UNIQUE NOT NULL,
+            version TEXT,
+            install_path TEXT NOT NULL,
+            source_url TEXT,
+            exec_path TEXT,
+            install_date TEXT,
+            created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+        ))"
+    },
+    // 2: per-install file manifest
+    {
+        R"(CREATE TABLE IF NOT EXISTS installed_files (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            app_name TEXT NOT NULL,
+            path TEXT NOT NULL,
+            size INTEGER,
+            mode INTEGER,
+            hash TEXT,
+            kind TEXT NOT NULL
+        ))"
+    },
+    // 3: indexes on lookup columns
+    {
+        "CREATE INDEX IF NOT EXISTS idx_installed_files_app ON installed_files (app_name)",
+        "CREATE INDEX IF NOT EXISTS idx_installed_files_path ON installed_files (path)",
+        "CREATE INDEX IF NOT EXISTS idx_installed_apps_exec ON installed_apps (exec_path)"
+    },
+    // 4: last verified state, for incremental verification
+    {
+        "ALTER TABLE installed_files ADD COLUMN mtime INTEGER DEFAULT 0",
+        "ALTER TABLE installed_files ADD COLUMN ctime INTEGER DEFAULT 0",
+        "ALTER TABLE installed_apps ADD COLUMN last_verified TEXT"
+    },
+    // 5: cross-app deduplication store
+    {
+        R"(CREATE TABLE dedup_blobs (
+            blob_path TEXT PRIMARY KEY,
+            hash TEXT NOT NULL,
+            mode INTEGER NOT NULL,
+            size INTEGER NOT NULL,
+            refcount INTEGER NOT NULL
+        ))",
+        R"(CREATE TABLE dedup_links (
+            path TEXT PRIMARY KEY,
+            app_name TEXT NOT NULL,
+            blob_path TEXT NOT NULL
+        ))",
+        "CREATE INDEX idx_dedup_links_app ON dedup_links (app_name)"
+    },
+    // 6: update checks
+    {
+        "ALTER TABLE installed_apps ADD COLUMN etag TEXT",
+        "ALTER TABLE installed_apps ADD COLUMN last_modified TEXT",
+        "ALTER TABLE installed_apps ADD COLUMN resolved_url TEXT",
+        "ALTER TABLE installed_apps ADD COLUMN content_length INTEGER DEFAULT -1",
+        "ALTER TABLE installed_apps ADD COLUMN update_available INTEGER DEFAULT 0",
+        "ALTER TABLE installed_apps ADD COLUMN update_url TEXT",
+        "ALTER TABLE installed_apps ADD COLUMN last_update_check TEXT"
+    },
+    // 7: updates prefetched into the staging area
+    {
+        R"(CREATE TABLE staged_updates (
+            app_name TEXT PRIMARY KEY,
+            staged_path TEXT NOT NULL,
+            install_path TEXT NOT NULL,
+            exec_path TEXT NOT NULL,
+            version TEXT,
+            source_url TEXT,
+            etag TEXT,
+            last_modified TEXT,
+            resolved_url TEXT,
+            content_length INTEGER DEFAULT -1,
+            archive_sha256 TEXT,
+            staged_at TEXT
+        ))",
+        R"(CREATE TABLE staged_files (
+            app_name TEXT NOT NULL,
+            path TEXT NOT NULL,
+            size INTEGER,
+            mode INTEGER,
+            hash TEXT,
+            kind TEXT NOT NULL,
+            mtime INTEGER DEFAULT 0,
+            ctime INTEGER DEFAULT 0
+        ))",
+        "CREATE INDEX idx_staged_files_app ON staged_files (app_name)"
+    },
+    // 8: files read at startup, for page cache warmup
+    {
+        R"(CREATE TABLE warmup_profiles (
+            app_name TEXT NOT NULL,
+            path TEXT NOT NULL,
+            position INTEGER NOT NULL,
+            PRIMARY KEY (app_name, path)
+        ))"
+    },
+    // 9: journal of installs in progress
+    {
+        R"(CREATE TABLE install_journal (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            source TEXT NOT NULL,
+            install_path TEXT NOT NULL,
+            phase TEXT NOT NULL,
+            pid INTEGER,
+            archive_path TEXT,
+            archive_sha256 TEXT,
+            archive_stamp TEXT,
+            staging_dir TEXT,
+            exec_path TEXT,
+            tree_digest TEXT,
+            final_dir TEXT,
+            backup_dir TEXT,
+            started_at TEXT,
+            updated_at TEXT,
+            UNIQUE (source, install_path)
+        ))"
+    },
+    // 10: fast re-encodings of installed archives, keyed by the original's hash
+    {
+        R"(CREATE TABLE cached_archives (
+            original_sha256 TEXT PRIMARY KEY,
+            original_size INTEGER NOT NULL,
+            app_name TEXT,
+            path TEXT NOT NULL,
+            format TEXT NOT NULL,
+            sha256 TEXT NOT NULL,
+            size INTEGER NOT NULL,
+            created_at TEXT,
+            last_used TEXT
+        ))",
+        "CREATE INDEX idx_cached_archives_size ON cached_archives(original_size)",
+        "CREATE INDEX idx_cached_archives_app ON cached_archives(app_name)"
+    },
+    // 11: duration of each phase and volumes of every install, for trends
+    {
+        R"(CREATE TABLE install_metrics (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            app_name TEXT NOT NULL,
+            version TEXT,
+            kind TEXT NOT NULL,
+            source TEXT NOT NULL,
+            cache_hit INTEGER NOT NULL DEFAULT 0,
+            resumed INTEGER NOT NULL DEFAULT 0,
+            success INTEGER NOT NULL,
+            archive_bytes INTEGER,
+            download_bytes INTEGER,
+            installed_bytes INTEGER,
+            installed_files INTEGER,
+            extract_bytes_per_second REAL,
+            phases TEXT,
+            recorded_at TEXT
+        ))",
+        "CREATE INDEX idx_install_metrics_app ON install_metrics(app_name)"
+    },
+    // 12: disk usage of each install, reused until its tree changes
+    {
+        "ALTER TABLE installed_apps ADD COLUMN disk_usage INTEGER DEFAULT -1",
+        "ALTER TABLE installed_apps ADD COLUMN disk_usage_stamp INTEGER DEFAULT 0"
+    }
+};
+
+static const int SCHEMA_VERSION = sizeof(MIGRATIONS) / sizeof(MIGRATIONS[0]);
+
+// Reads rows of (path, size, mode, hash, kind, mtime, ctime)
+static QVector<ManifestEntry> readManifestRows(QSqlQuery &query)
+{
+    QVector<ManifestEntry> entries;
+
+    while (query.next()) {
+        ManifestEntry entry;
+        entry.path = query.value(0).toString();
+        entry.size = query.value(1).toLongLong();
+        entry.mode = query.value(2).toUInt();
+        entry.hash = query.value(3).toString().toLatin1();
+        entry.kind = InstallManifest::kindFromString(query.value(4).toString());
+        entry.mtime = query.value(5).toLongLong();
+        entry.ctime = query.value(6).toLongLong();
+        entries.append(entry);
+    }
+
+    return entries;
+}
+
+AppRegistry::AppRegistry(const QString &connectionName)
+    : m_connectionName(connectionName)
+    , m_transactionDepth(0)
+    , m_transactionFailed(false)
+{
+}
+
+AppRegistry::~AppRegistry()
+{
+    close();
+}
+
+bool AppRegistry::open(const QString &databasePath)
+{
+    m_db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    m_db.setDatabaseName(databasePath);
+    m_db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
+    if (!m_db.open()) {
+        m_lastError = "No se pudo abrir la base de datos: " + m_db.lastError().text();
+        return false;
+    }
+
+    // WAL lets readers proceed during an install and turns each commit into
+    // a sequential append; NORMAL only syncs at checkpoints, which is still
+    // crash-safe in WAL mode.
+    exec("PRAGMA journal_mode=WAL");
+    exec("PRAGMA synchronous=NORMAL");
+    exec("PRAGMA temp_store=MEMORY");
+
+    return migrate();
+}
+
+void AppRegistry::openOnFirstUse(const QString &databasePath, const std::function<void()> &onOpened)
+{
+    m_deferredPath = databasePath;
+    m_onOpened = onOpened;
+}
+
+bool AppRegistry::ensureOpen()
+{
+    if (m_deferredPath.isEmpty()) {
+        return m_db.isOpen();
+    }
+
+    // Cleared first: a failed open is not retried, and onOpened may use the registry
+    QString path = m_deferredPath;
+    m_deferredPath.clear();
+    if (!open(path)) {
+        return false;
+    }
+
+    if (m_onOpened) {
+        m_onOpened();
+    }
+    return true;
+}
+
+void AppRegistry::close()
+{
+    m_deferredPath.clear();
+    m_statements.clear();
+
+    if (m_db.isOpen()) {
+        m_db.close();
+    }
+
+    m_db = QSqlDatabase();
+    if (QSqlDatabase::contains(m_connectionName)) {
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+bool AppRegistry::isOpen() const
+{
+    return m_db.isOpen();
+}
+
+QString AppRegistry::lastError() const
+{
+    return m_lastError;
+}
+
+int AppRegistry::schemaVersion() const
+{
+    QSqlQuery query("PRAGMA user_version", m_db);
+    if (query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
+}
+
+bool AppRegistry::migrate()
+{
+    int version = schemaVersion();
+
+    while (version < SCHEMA_VERSION) {
+        if (!m_db.transaction()) {
+            m_lastError = "No se pudo iniciar la migración: " + m_db.lastError().text();
+            return false;
+        }
+
+        foreach (const QString &sql, MIGRATIONS[version]) {
+            if (!exec(sql)) {
+                m_db.rollback();
+                return false;
+            }
+        }
+
+        version++;
+        if (!exec(QString("PRAGMA user_version = %1").arg(version)) || !m_db.commit()) {
+            m_db.rollback();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AppRegistry::exec(const QString &sql)
+{
+    QSqlQuery query(m_db);
+    if (!query.exec(sql)) {
+        setError(sql, query);
+        return false;
+    }
+    return true;
+}
+
+void AppRegistry::setError(const QString &context, const QSqlQuery &query)
+{
+    m_lastError = context.simplified() + ": " + query.lastError().text();
+}
+
+bool AppRegistry::beginTransaction()
+{
+    ensureOpen();
+    if (m_transactionDepth++ > 0) {
+        return true;
+    }
+
+    m_transactionFailed = false;
+    if (!m_db.transaction()) {
+        m_lastError = "No se pudo iniciar la transacción: " + m_db.lastError().text();
+        m_transactionDepth = 0;
+        return false;
+    }
+    return true;
+}
+
+bool AppRegistry::commit()
+{
+    if (m_transactionDepth == 0) {
+        return false;
+    }
+
+    if (--m_transactionDepth > 0) {
+        return !m_transactionFailed;
+    }
+
+    if (m_transactionFailed) {
+        m_db.rollback();
+        return false;
+    }
+
+    if (!m_db.commit()) {
+        m_lastError = "No se pudo confirmar la transacción: " + m_db.lastError().text();
+        m_db.rollback();
+        return false;
+    }
+    return true;
+}
+
+void AppRegistry::rollback()
+{
+    if (m_transactionDepth == 0) {
+        return;
+    }
+
+    // An inner rollback poisons the outer transaction
+    m_transactionFailed = true;
+    if (--m_transactionDepth == 0) {
+        m_db.rollback();
+    }
+}
+
+QSqlQuery &AppRegistry::prepared(const QString &sql)
+{
+    ensureOpen();
+    auto it = m_statements.find(sql);
+    if (it == m_statements.end()) {
+        QSqlQuery query(m_db);
+        if (!query.prepare(sql)) {
+            setError(sql, query);
+        }
+        it = m_statements.insert(sql, query);
+    }
+    return it.value();
+}
+
+bool AppRegistry::registerApp(const AppRecord &record, const QVector<ManifestEntry> &manifest)
+{
+    // The app row and its manifest are written together or not at all
+    if (!beginTransaction()) {
+        return false;
+    }
+
+    // REPLACE also resets per-install state such as last_verified and update_available
+    QSqlQuery &upsert = prepared("INSERT OR REPLACE INTO installed_apps "
+                                 "(app_name, version, install_path, source_url, exec_path, install_date, "
+                                 "etag, last_modified, resolved_url, content_length) "
+                                 "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    upsert.addBindValue(record.appName);
+    upsert.addBindValue(record.version);
+    upsert.addBindValue(record.installPath);
+    upsert.addBindValue(record.sourceUrl);
+    upsert.addBindValue(record.execPath);
+    upsert.addBindValue(record.installDate.isEmpty()
+                        ? QDateTime::currentDateTime().toString(Qt::ISODate)
+                        : record.installDate);
+    upsert.addBindValue(record.etag);
+    upsert.addBindValue(record.lastModified);
+    upsert.addBindValue(record.resolvedUrl);
+    upsert.addBindValue(record.contentLength);
+
+    if (!upsert.exec()) {
+        setError("installed_apps", upsert);
+        rollback();
+        return false;
+    }
+
+    QSqlQuery &clear = prepared("DELETE FROM installed_files WHERE app_name = ?");
+    clear.addBindValue(record.appName);
+
+    if (!clear.exec()) {
+        setError("installed_files", clear);
+        rollback();
+        return false;
+    }
+
+    QSqlQuery &insert = prepared("INSERT INTO installed_files (app_name, path, size, mode, hash, kind, mtime, ctime) "
+                                 "VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+
+    foreach (const ManifestEntry &entry, manifest) {
+        insert.addBindValue(record.appName);
+        insert.addBindValue(entry.path);
+        insert.addBindValue(entry.size);
+        insert.addBindValue(entry.mode);
+        insert.addBindValue(QString::fromLatin1(entry.hash));
+        insert.addBindValue(InstallManifest::kindToString(entry.kind));
+        insert.addBindValue(entry.mtime);
+        insert.addBindValue(entry.ctime);
+
+        if (!insert.exec()) {
+            setError("installed_files", insert);
+            rollback();
+            return false;
+        }
+    }
+
+    return commit();
+}
+
+bool AppRegistry::unregisterApp(const QString &appName)
+{
+    if (!beginTransaction()) {
+        return false;
+    }
+
+    QSqlQuery &files = prepared("DELETE FROM installed_files WHERE app_name = ?");
+    files.addBindValue(appName);
+
+    if (!files.exec()) {
+        setError("installed_files", files);
+        rollback();
+        return false;
+    }
+
+    QSqlQuery &profile = prepared("DELETE FROM warmup_profiles WHERE app_name = ?");
+    profile.addBindValue(appName);
+
+    if (!profile.exec()) {
+        setError("warmup_profiles", profile);
+        rollback();
+        return false;
+    }
+
+    QSqlQuery &app = prepared("DELETE FROM installed_apps WHERE app_name = ?");
+    app.addBindValue(appName);
+
+    if (!app.exec()) {
+        setError("installed_apps", app);
+        rollback();
+        return false;
+    }
+
+    return commit();
+}
+
+bool AppRegistry::findApp(const QString &appName, AppRecord *record)
+{
+    QSqlQuery &query = prepared("SELECT app_name, version, install_path, source_url, exec_path, install_date, "
+                                "etag, last_modified, resolved_url, content_length, update_available, update_url "
+                                "FROM installed_apps WHERE app_name = ?");
+    query.addBindValue(appName);
+
+    if (!query.exec() || !query.next()) {
+        query.finish();
+        return false;
+    }
+
+    if (record) {
+        record->appName = query.value(0).toString();
+        record->version = query.value(1).toString();
+        record->installPath = query.value(2).toString();
+        record->sourceUrl = query.value(3).toString();
+        record->execPath = query.value(4).toString();
+        record->installDate = query.value(5).toString();
+        record->etag = query.value(6).toString();
+        record->lastModified = query.value(7).toString();
+        record->resolvedUrl = query.value(8).toString();
+        record->contentLength = query.value(9).isNull() ? -1 : query.value(9).toLongLong();
+        record->updateAvailable = query.value(10).toInt() != 0;
+        record->updateUrl = query.value(11).toString();
+    }
+
+    // Release the read cursor so it does not pin the WAL snapshot
+    query.finish();
+    return true;
+}
+
+QStringList AppRegistry::appNames()
+{
+    QStringList apps;
+
+    QSqlQuery &query = prepared("SELECT app_name FROM installed_apps ORDER BY app_name");
+    if (query.exec()) {
+        while (query.next()) {
+            apps << query.value(0).toString();
+        }
+    }
+    query.finish();
+
+    return apps;
+}
+
+QVector<ManifestEntry> AppRegistry::manifest(const QString &appName)
+{
+    QVector<ManifestEntry> entries;
+
+    QSqlQuery &query = prepared("SELECT path, size, mode, hash, kind, mtime, ctime "
+                                "FROM installed_files WHERE app_name = ?");
+    query.addBindValue(appName);
+
+    if (query.exec()) {
+        entries = readManifestRows(query);
+    }
+    query.finish();
+
+    return entries;
+}
+
+bool AppRegistry::updateVerifiedState(const QString &appName, const QVector<ManifestEntry> &entries)
+{
+    if (!beginTransaction()) {
+        return false;
+    }
+
+    QSqlQuery &update = prepared("UPDATE installed_files SET mtime = ?, ctime = ? "
+                                 "WHERE app_name = ? AND path = ?");
+
+    foreach (const ManifestEntry &entry, entries) {
+        update.addBindValue(entry.mtime);
+        update.addBindValue(entry.ctime);
+        update.addBindValue(appName);
+        update.addBindValue(entry.path);
+
+        if (!update.exec()) {
+            setError("installed_files", update);
+            rollback();
+            return false;
+        }
+    }
+
+    QSqlQuery &stamp = prepared("UPDATE installed_apps SET last_verified = ? WHERE app_name = ?");
+    stamp.addBindValue(QDateTime::currentDateTime().toString(Qt::ISODate));
+    stamp.addBindValue(appName);
+
+    if (!stamp.exec()) {
+        setError("installed_apps", stamp);
+        rollback();
+        return false;
+    }
+
+    return commit();
+}
+
+QVector<InstalledAppStatus> AppRegistry::installedAppStatus()
+{
+    QVector<InstalledAppStatus> apps;
+
+    QSqlQuery &query = prepared("SELECT a.app_name, a.version, a.install_path, a.source_url, a.exec_path, "
+                                "a.install_date, a.update_available, a.update_url, a.last_verified, "
+                                "a.disk_usage, a.disk_usage_stamp, s.version "
+                                "FROM installed_apps a LEFT JOIN staged_updates s ON s.app_name = a.app_name "
+                                "ORDER BY a.app_name");
+    if (query.exec()) {
+        while (query.next()) {
+            InstalledAppStatus app;
+            app.record.appName = query.value(0).toString();
+            app.record.version = query.value(1).toString();
+            app.record.installPath = query.value(2).toString();
+            app.record.sourceUrl = query.value(3).toString();
+            app.record.execPath = query.value(4).toString();
+            app.record.installDate = query.value(5).toString();
+            app.record.updateAvailable = query.value(6).toInt() != 0;
+            app.record.updateUrl = query.value(7).toString();
+            app.lastVerified = query.value(8).toString();
+            app.diskUsage = query.value(9).isNull() ? -1 : query.value(9).toLongLong();
+            app.diskUsageStamp = query.value(10).toLongLong();
+            app.stagedVersion = query.value(11).toString();
+            apps.append(app);
+        }
+    }
+    query.finish();
+
+    return apps;
+}
+
+bool AppRegistry::recordDiskUsage(const QString &appName, qint64 bytes, qint64 stamp)
+{
+    QSqlQuery &update = prepared("UPDATE installed_apps SET disk_usage = ?, disk_usage_stamp = ? WHERE app_name = ?");
+    update.addBindValue(bytes);
+    update.addBindValue(stamp);
+    update.addBindValue(appName);
+
+    if (!update.exec()) {
+        setError("installed_apps", update);
+        return false;
+    }
+    return true;
+}
+
+QVector<UpdateCheckTarget> AppRegistry::updateCheckTargets()
+{
+    QVector<UpdateCheckTarget> targets;
+
+    QSqlQuery &query = prepared("SELECT app_name, source_url, etag, last_modified, resolved_url, content_length "
+                                "FROM installed_apps WHERE source_url IS NOT NULL AND source_url != ''");
+    if (query.exec()) {
+        while (query.next()) {
+            UpdateCheckTarget target;
+            target.appName = query.value(0).toString();
+            target.url = QUrl(query.value(1).toString());
+            target.etag = query.value(2).toString();
+            target.lastModified = query.value(3).toString();
+            target.resolvedUrl = query.value(4).toString();
+            target.contentLength = query.value(5).isNull() ? -1 : query.value(5).toLongLong();
+            targets.append(target);
+        }
+    }
+    query.finish();
+
+    return targets;
+}
+
+bool AppRegistry::recordUpdateCheck(const UpdateCheckResult &result)
+{
+    QString now = QDateTime::currentDateTime().toString(Qt::ISODate);
+
+    if (result.failed) {
+        QSqlQuery &stamp = prepared("UPDATE installed_apps SET last_update_check = ? WHERE app_name = ?");
+        stamp.addBindValue(now);
+        stamp.addBindValue(result.appName);
+        return stamp.exec();
+    }
+
+    // Installs that predate update checks have no validators: adopt the
+    // current remote state as the baseline instead of reporting an update
+    QSqlQuery &baseline = prepared("UPDATE installed_apps SET etag = ?, last_modified = ?, resolved_url = ?, "
+                                   "content_length = ? WHERE app_name = ? "
+                                   "AND COALESCE(etag, '') = '' AND COALESCE(last_modified, '') = '' "
+                                   "AND COALESCE(resolved_url, '') = ''");
+    baseline.addBindValue(result.etag);
+    baseline.addBindValue(result.lastModified);
+    baseline.addBindValue(result.resolvedUrl);
+    baseline.addBindValue(result.contentLength);
+    baseline.addBindValue(result.appName);
+    if (!baseline.exec()) {
+        setError("installed_apps", baseline);
+        return false;
+    }
+
+    QSqlQuery &update = prepared("UPDATE installed_apps SET update_available = ?, update_url = ?, "
+                                 "last_update_check = ? WHERE app_name = ?");
+    update.addBindValue(result.updateAvailable ? 1 : 0);
+    update.addBindValue(result.updateAvailable ? result.resolvedUrl : QString());
+    update.addBindValue(now);
+    update.addBindValue(result.appName);
+    if (!update.exec()) {
+        setError("installed_apps", update);
+        return false;
+    }
+
+    return true;
+}
+
+bool AppRegistry::recordStagedUpdate(const StagedUpdate &update, const QVector<ManifestEntry> &manifest)
+{
+    if (!beginTransaction()) {
+        return false;
+    }
+
+    const AppRecord &record = update.record;
+    QSqlQuery &upsert = prepared("INSERT OR REPLACE INTO staged_updates "
+                                 "(app_name, staged_path, install_path, exec_path, version, source_url, "
+                                 "etag, last_modified, resolved_url, content_length, archive_sha256, staged_at) "
+                                 "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    upsert.addBindValue(record.appName);
+    upsert.addBindValue(update.stagedPath);
+    upsert.addBindValue(record.installPath);
+    upsert.addBindValue(record.execPath);
+    upsert.addBindValue(record.version);
+    upsert.addBindValue(record.sourceUrl);
+    upsert.addBindValue(record.etag);
+    upsert.addBindValue(record.lastModified);
+    upsert.addBindValue(record.resolvedUrl);
+    upsert.addBindValue(record.contentLength);
+    upsert.addBindValue(update.archiveSha256);
+    upsert.addBindValue(QDateTime::currentDateTime().toString(Qt::ISODate));
+
+    if (!upsert.exec()) {
+        setError("staged_updates", upsert);
+        rollback();
+        return false;
+    }
+
+    QSqlQuery &clear = prepared("DELETE FROM staged_files WHERE app_name = ?");
+    clear.addBindValue(record.appName);
+
+    if (!clear.exec()) {
+        setError("staged_files", clear);
+        rollback();
+        return false;
+    }
+
+    QSqlQuery &insert = prepared("INSERT INTO staged_files (app_name, path, size, mode, hash, kind, mtime, ctime) "
+                                 "VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+
+    foreach (const ManifestEntry &entry, manifest) {
+        insert.addBindValue(record.appName);
+        insert.addBindValue(entry.path);
+        insert.addBindValue(entry.size);
+        insert.addBindValue(entry.mode);
+        insert.addBindValue(QString::fromLatin1(entry.hash));
+        insert.addBindValue(InstallManifest::kindToString(entry.kind));
+        insert.addBindValue(entry.mtime);
+        insert.addBindValue(entry.ctime);
+
+        if (!insert.exec()) {
+            setError("staged_files", insert);
+            rollback();
+            return false;
+        }
+    }
+
+    return commit();
+}
+
+bool AppRegistry::findStagedUpdate(const QString &appName, StagedUpdate *update)
+{
+    QSqlQuery &query = prepared("SELECT app_name, staged_path, install_path, exec_path, version, source_url, "
+                                "etag, last_modified, resolved_url, content_length, archive_sha256, staged_at "
+                                "FROM staged_updates WHERE app_name = ?");
+    query.addBindValue(appName);
+
+    if (!query.exec() || !query.next()) {
+        query.finish();
+        return false;
+    }
+
+    if (update) {
+        update->record.appName = query.value(0).toString();
+        update->stagedPath = query.value(1).toString();
+        update->record.installPath = query.value(2).toString();
+        update->record.execPath = query.value(3).toString();
+        update->record.version = query.value(4).toString();
+        update->record.sourceUrl = query.value(5).toString();
+        update->record.etag = query.value(6).toString();
+        update->record.lastModified = query.value(7).toString();
+        update->record.resolvedUrl = query.value(8).toString();
+        update->record.contentLength = query.value(9).isNull() ? -1 : query.value(9).toLongLong();
+        update->archiveSha256 = query.value(10).toString();
+        update->stagedAt = query.value(11).toString();
+    }
+
+    query.finish();
+    return true;
+}
+
+QVector<ManifestEntry> AppRegistry::stagedManifest(const QString &appName)
+{
+    QVector<ManifestEntry> entries;
+
+    QSqlQuery &query = prepared("SELECT path, size, mode, hash, kind, mtime, ctime "
+                                "FROM staged_files WHERE app_name = ?");
+    query.addBindValue(appName);
+
+    if (query.exec()) {
+        entries = readManifestRows(query);
+    }
+    query.finish();
+
+    return entries;
+}
+
+bool AppRegistry::removeStagedUpdate(const QString &appName)
+{
+    if (!beginTransaction()) {
+        return false;
+    }
+
+    QSqlQuery &files = prepared("DELETE FROM staged_files WHERE app_name = ?");
+    files.addBindValue(appName);
+
+    if (!files.exec()) {
+        setError("staged_files", files);
+        rollback();
+        return false;
+    }
+
+    QSqlQuery &update = prepared("DELETE FROM staged_updates WHERE app_name = ?");
+    update.addBindValue(appName);
+
+    if (!update.exec()) {
+        setError("staged_updates", update);
+        rollback();
+        return false;
+    }
+
+    return commit();
+}
+
+QStringList AppRegistry::warmupProfile(const QString &appName)
+{
+    QStringList paths;
+
+    QSqlQuery &query = prepared("SELECT path FROM warmup_profiles WHERE app_name = ? ORDER BY position");
+    query.addBindValue(appName);
+
+    if (query.exec()) {
+        while (query.next()) {
+            paths << query.value(0).toString();
+        }
+    }
+    query.finish();
+
+    return paths;
+}
+
+bool AppRegistry::setWarmupProfile(const QString &appName, const QStringList &paths)
+{
+    if (!beginTransaction()) {
+        return false;
+    }
+
+    QSqlQuery &clear = prepared("DELETE FROM warmup_profiles WHERE app_name = ?");
+    clear.addBindValue(appName);
+
+    if (!clear.exec()) {
+        setError("warmup_profiles", clear);
+        rollback();
+        return false;
+    }
+
+    QSqlQuery &insert = prepared("INSERT OR IGNORE INTO warmup_profiles (app_name, path, position) VALUES (?, ?, ?)");
+
+    for (int i = 0; i < paths.size(); ++i) {
+        insert.addBindValue(appName);
+        insert.addBindValue(paths.at(i));
+        insert.addBindValue(i);
+
+        if (!insert.exec()) {
+            setError("warmup_profiles", insert);
+            rollback();
+            return false;
+        }
+    }
+
+    return commit();
+}
@@ -0,0 +1,123 @@
+#ifndef APPREGISTRY_H
+#define APPREGISTRY_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <functional>
+#include "InstallManifest.h"
+#include "UpdateChecker.h"
+
+struct AppRecord
+{
+    QString appName;
+    QString version;
+    QString installPath;
+    QString sourceUrl;
+    QString execPath;
+    QString installDate;
+
+    // HTTP validators of the installed payload, used by update checks
+    QString etag;
+    QString lastModified;
+    QString resolvedUrl;
+    qint64 contentLength = -1;
+
+    bool updateAvailable = false;
+    QString updateUrl;
+};
+
+// Next version of an app, fully extracted into the staging area. record
+// describes the app as it will be registered once the update is applied.
+struct StagedUpdate
+{
+    AppRecord record;
+    QString stagedPath;
+    QString archiveSha256;
+    QString stagedAt;
+};
+
+// What the installed apps dashboard shows of one app
+struct InstalledAppStatus
+{
+    AppRecord record;
+    QString lastVerified;
+    QString stagedVersion;      // Empty unless an update is staged
+    qint64 diskUsage = -1;      // Bytes allocated, -1 if never measured
+    qint64 diskUsageStamp = 0;  // Tree stamp the usage was measured at
+};
+
+// SQLite-backed registry of installed apps and their manifests.
+// Owns the connection, the schema migrations and a cache of prepared
+// statements so hot paths never re-prepare SQL.
+class AppRegistry
+{
+public:
+    explicit AppRegistry(const QString &connectionName = "vscip_registry");
+    ~AppRegistry();
+
+    bool open(const QString &databasePath);
+    // Defers open() until the registry is first used, so that startup does
+    // not wait on SQLite. onOpened runs right after a successful open.
+    void openOnFirstUse(const QString &databasePath, const std::function<void()> &onOpened = nullptr);
+    // Performs a deferred open now; true if the registry is open
+    bool ensureOpen();
+    void close();
+    bool isOpen() const;
+    QString lastError() const;
+    int schemaVersion() const;
+
+    // Transactions nest: only the outermost begin/commit touches SQLite,
+    // so a whole install (or batch of installs) costs a single fsync.
+    bool beginTransaction();
+    bool commit();
+    void rollback();
+
+    bool registerApp(const AppRecord &record, const QVector<ManifestEntry> &manifest);
+    bool unregisterApp(const QString &appName);
+    bool findApp(const QString &appName, AppRecord *record);
+    QStringList appNames();
+    QVector<ManifestEntry> manifest(const QString &appName);
+    // Stores the times of entries re-hashed successfully and stamps last_verified
+    bool updateVerifiedState(const QString &appName, const QVector<ManifestEntry> &entries);
+    
+    // Every app with its verification, update and disk usage state, by name
+    QVector<InstalledAppStatus> installedAppStatus();
+    bool recordDiskUsage(const QString &appName, qint64 bytes, qint64 stamp);
+
+    // Apps installed from a URL, with the validators of what is installed
+    QVector<UpdateCheckTarget> updateCheckTargets();
+    bool recordUpdateCheck(const UpdateCheckResult &result);
+
+    // manifest already uses the paths the files will have once applied
+    bool recordStagedUpdate(const StagedUpdate &update, const QVector<ManifestEntry> &manifest);
+    bool findStagedUpdate(const QString &appName, StagedUpdate *update);
+    QVector<ManifestEntry> stagedManifest(const QString &appName);
+    bool removeStagedUpdate(const QString &appName);
+
+    // Paths relative to the install directory, in prefetch order. Kept
+    // across reinstalls and updates, dropped with the app.
+    QStringList warmupProfile(const QString &appName);
+    bool setWarmupProfile(const QString &appName, const QStringList &paths);
+
+    // Returns a cached prepared statement for sql, preparing it on first use
+    QSqlQuery &prepared(const QString &sql);
+
+private:
+    bool migrate();
+    bool exec(const QString &sql);
+    void setError(const QString &context, const QSqlQuery &query);
+
+    QString m_connectionName;
+    QString m_deferredPath;
+    std::function<void()> m_onOpened;
+    QSqlDatabase m_db;
+    QHash<QString, QSqlQuery> m_statements;
+    int m_transactionDepth;
+    bool m_transactionFailed;
+    QString m_lastError;
+};
+
+#endif // APPREGISTRY_H
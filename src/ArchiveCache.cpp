@@ -0,0 +1,278 @@
+#include "ArchiveCache.h"
+#include "AppRegistry.h"
+#include "DiskPreflight.h"
+#include "InstallManifest.h"
+#include "IoThrottle.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QStandardPaths>
+#include <QVariant>
+
+namespace {
+
+// A plain tar is only worth its size when the cache has room to spare
+const int PLAIN_TAR_HEADROOM = 4;
+
+// Leftovers of an encoding this old cannot belong to a running one
+const int STALE_PART_SECONDS = 24 * 3600;
+
+// Decompressor for the outer layer of a vendor archive
+QStringList decoderFor(const QString &archivePath)
+{
+    if (archivePath.endsWith(".tar.gz") || archivePath.endsWith(".tgz")) {
+        return QStringList() << "gzip" << "-dc";
+    } else if (archivePath.endsWith(".tar.xz") || archivePath.endsWith(".txz")) {
+        return QStringList() << "xz" << "-dc" << "-T0";
+    } else if (archivePath.endsWith(".tar.bz2") || archivePath.endsWith(".tbz2")) {
+        return QStringList() << "bzip2" << "-dc";
+    }
+    return QStringList();
+}
+
+bool finishedCleanly(QProcess &process)
+{
+    return process.waitForFinished(-1) && process.exitStatus() == QProcess::NormalExit
+           && process.exitCode() == 0;
+}
+
+} // namespace
+
+ArchiveCache::ArchiveCache(AppRegistry &registry)
+    : m_registry(registry)
+{
+}
+
+QString ArchiveCache::cacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/archives";
+}
+
+bool ArchiveCache::canEncode(const QString &archivePath)
+{
+    return !decoderFor(archivePath).isEmpty();
+}
+
+bool ArchiveCache::hasCandidate(qint64 originalSize)
+{
+    QSqlQuery &query = m_registry.prepared("SELECT 1 FROM cached_archives WHERE original_size = ? LIMIT 1");
+    query.addBindValue(originalSize);
+    bool found = query.exec() && query.next();
+    query.finish();
+    return found;
+}
+
+bool ArchiveCache::find(const QByteArray &originalSha256, CachedArchive *cached)
+{
+    QSqlQuery &query = m_registry.prepared("SELECT original_size, app_name, path, format, sha256, size "
+                                           "FROM cached_archives WHERE original_sha256 = ?");
+    query.addBindValue(QString::fromLatin1(originalSha256));
+
+    bool found = query.exec() && query.next();
+    if (found) {
+        cached->originalSha256 = originalSha256;
+        cached->originalSize = query.value(0).toLongLong();
+        cached->appName = query.value(1).toString();
+        cached->path = query.value(2).toString();
+        cached->format = query.value(3).toString();
+        cached->sha256 = query.value(4).toString().toLatin1();
+        cached->size = query.value(5).toLongLong();
+    }
+    query.finish();
+
+    if (!found) {
+        return false;
+    }
+
+    if (QFileInfo(cached->path).size() != cached->size) {
+        remove(originalSha256);
+        return false;
+    }
+
+    // Eviction goes by last use, so a rollback target stays while it is wanted
+    QSqlQuery &touch = m_registry.prepared("UPDATE cached_archives SET last_used = ? WHERE original_sha256 = ?");
+    touch.addBindValue(QDateTime::currentDateTime().toString(Qt::ISODate));
+    touch.addBindValue(QString::fromLatin1(originalSha256));
+    touch.exec();
+
+    return true;
+}
+
+CachedArchive ArchiveCache::encode(const QString &archivePath, const QByteArray &originalSha256)
+{
+    CachedArchive cached;
+    cached.originalSha256 = originalSha256;
+    cached.originalSize = QFileInfo(archivePath).size();
+
+    QStringList decoder = decoderFor(archivePath);
+    QString dir = cacheDir();
+    if (decoder.isEmpty() || originalSha256.isEmpty() || !QDir().mkpath(dir)) {
+        return cached;
+    }
+
+    qint64 tarBytes = DiskPreflight::measureArchive(archivePath).bytes;
+    FilesystemSpace space = DiskPreflight::spaceFor(dir);
+    QString zstd = QStandardPaths::findExecutable("zstd");
+
+    bool plain = !space.valid || space.availableBytes > PLAIN_TAR_HEADROOM * tarBytes;
+    if (!plain && zstd.isEmpty()) {
+        return cached;
+    }
+
+    cached.format = plain ? "tar" : "tar.zst";
+    QString finalPath = dir + "/" + QString::fromLatin1(originalSha256) + "." + cached.format;
+    QString partPath = finalPath + ".part";
+
+    // Runs after the install finished; whatever the user does next comes first
+    IoPolicy policy = IoPolicy::background();
+    ThrottledProcess decompress(policy);
+    ThrottledProcess compress(policy);
+
+    decompress.setStandardInputFile(archivePath);
+    if (plain) {
+        decompress.setStandardOutputFile(partPath);
+    } else {
+        decompress.setStandardOutputProcess(&compress);
+        compress.setStandardOutputFile(partPath);
+        compress.start(zstd, QStringList() << "-q" << "-3" << "-T0" << "-c");
+    }
+    decompress.start(decoder.takeFirst(), decoder);
+
+    // zstd would otherwise wait forever for input that never comes
+    if (!decompress.waitForStarted()) {
+        compress.kill();
+        compress.waitForFinished();
+        QFile::remove(partPath);
+        return cached;
+    }
+
+    bool ok = finishedCleanly(decompress);
+    if (!plain) {
+        ok = finishedCleanly(compress) && ok;
+    }
+
+    if (ok) {
+        cached.sha256 = InstallManifest::hashFile(partPath);
+        cached.size = QFileInfo(partPath).size();
+        QFile::remove(finalPath);
+        ok = !cached.sha256.isEmpty() && QFile::rename(partPath, finalPath);
+    }
+
+    if (!ok) {
+        QFile::remove(partPath);
+        return cached;
+    }
+
+    cached.path = finalPath;
+    return cached;
+}
+
+bool ArchiveCache::add(const CachedArchive &cached)
+{
+    if (!m_registry.beginTransaction()) {
+        return false;
+    }
+
+    QString now = QDateTime::currentDateTime().toString(Qt::ISODate);
+    QSqlQuery &insert = m_registry.prepared("INSERT OR REPLACE INTO cached_archives "
+                                            "(original_sha256, original_size, app_name, path, format, sha256, size, "
+                                            "created_at, last_used) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    insert.addBindValue(QString::fromLatin1(cached.originalSha256));
+    insert.addBindValue(cached.originalSize);
+    insert.addBindValue(cached.appName);
+    insert.addBindValue(cached.path);
+    insert.addBindValue(cached.format);
+    insert.addBindValue(QString::fromLatin1(cached.sha256));
+    insert.addBindValue(cached.size);
+    insert.addBindValue(now);
+    insert.addBindValue(now);
+
+    if (!insert.exec()) {
+        m_registry.rollback();
+        return false;
+    }
+
+    QSqlQuery &versions = m_registry.prepared("SELECT original_sha256 FROM cached_archives "
+                                              "WHERE app_name = ? ORDER BY last_used DESC, created_at DESC");
+    versions.addBindValue(cached.appName);
+
+    QList<QByteArray> evicted;
+    if (versions.exec()) {
+        for (int kept = 0; versions.next(); ++kept) {
+            if (kept >= VERSIONS_PER_APP) {
+                evicted << versions.value(0).toString().toLatin1();
+            }
+        }
+    }
+    versions.finish();
+
+    foreach (const QByteArray &sha256, evicted) {
+        remove(sha256);
+    }
+
+    return m_registry.commit();
+}
+
+bool ArchiveCache::remove(const QByteArray &originalSha256)
+{
+    QSqlQuery &query = m_registry.prepared("SELECT path FROM cached_archives WHERE original_sha256 = ?");
+    query.addBindValue(QString::fromLatin1(originalSha256));
+    if (query.exec() && query.next()) {
+        QFile::remove(query.value(0).toString());
+    }
+    query.finish();
+
+    QSqlQuery &deleteRow = m_registry.prepared("DELETE FROM cached_archives WHERE original_sha256 = ?");
+    deleteRow.addBindValue(QString::fromLatin1(originalSha256));
+    return deleteRow.exec();
+}
+
+bool ArchiveCache::removeForApp(const QString &appName)
+{
+    QSqlQuery &query = m_registry.prepared("SELECT original_sha256 FROM cached_archives WHERE app_name = ?");
+    query.addBindValue(appName);
+
+    QList<QByteArray> hashes;
+    if (query.exec()) {
+        while (query.next()) {
+            hashes << query.value(0).toString().toLatin1();
+        }
+    }
+    query.finish();
+
+    bool ok = true;
+    foreach (const QByteArray &sha256, hashes) {
+        ok = remove(sha256) && ok;
+    }
+    return ok;
+}
+
+int ArchiveCache::sweep()
+{
+    QSet<QString> referenced;
+    QSqlQuery &query = m_registry.prepared("SELECT path FROM cached_archives");
+    if (query.exec()) {
+        while (query.next()) {
+            referenced << query.value(0).toString();
+        }
+    }
+    query.finish();
+
+    int removed = 0;
+    QDateTime cutoff = QDateTime::currentDateTime().addSecs(-STALE_PART_SECONDS);
+    QDir dir(cacheDir());
+
+    foreach (const QFileInfo &info, dir.entryInfoList(QDir::Files | QDir::Hidden)) {
+        QString path = info.absoluteFilePath();
+        bool stalePart = path.endsWith(".part") && info.lastModified() < cutoff;
+        bool orphan = !path.endsWith(".part") && !referenced.contains(path);
+
+        if ((stalePart || orphan) && QFile::remove(path)) {
+            removed++;
+        }
+    }
+
+    return removed;
+}
@@ -0,0 +1,56 @@
+#ifndef ARCHIVECACHE_H
+#define ARCHIVECACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+class AppRegistry;
+
+struct CachedArchive
+{
+    QByteArray originalSha256;  // Of the vendor archive, what users and sidecars check
+    qint64 originalSize = 0;
+    QString appName;
+    QString path;               // The re-encoding
+    QString format;             // "tar" or "tar.zst"
+    QByteArray sha256;          // Of the re-encoding, checked as it is extracted
+    qint64 size = 0;
+};
+
+// Keeps a fast-to-extract copy of each installed vendor archive, so that
+// reinstalling or going back to a version does not pay for gzip, bzip2 or
+// xz again. The copy is a plain tar, which extracts in-kernel, or zstd when
+// the cache filesystem is short on space.
+class ArchiveCache
+{
+public:
+    explicit ArchiveCache(AppRegistry &registry);
+
+    static QString cacheDir();
+    static bool canEncode(const QString &archivePath);
+
+    // Cheap test before hashing an archive to look it up
+    bool hasCandidate(qint64 originalSize);
+    bool find(const QByteArray &originalSha256, CachedArchive *cached);
+
+    // Decompresses archivePath into the cache at idle priority. Blocks and
+    // touches no database, so it can run on a worker thread; the result
+    // is recorded with add(). Returns an entry with an empty path on failure.
+    static CachedArchive encode(const QString &archivePath, const QByteArray &originalSha256);
+
+    // Records an encoding and drops the oldest ones of the same app
+    bool add(const CachedArchive &cached);
+    bool remove(const QByteArray &originalSha256);
+    bool removeForApp(const QString &appName);
+
+    // Deletes unfinished encodings and files no row refers to
+    int sweep();
+
+    // Versions kept per app: the installed one and the one before it
+    static const int VERSIONS_PER_APP = 2;
+
+private:
+    AppRegistry &m_registry;
+};
+
+#endif // ARCHIVECACHE_H
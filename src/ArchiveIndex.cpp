@@ -0,0 +1,352 @@
+#include "ArchiveIndex.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <zlib.h>
+
+namespace {
+
+const quint32 INDEX_MAGIC = 0x56534958; // "VSIX"
+const int WINDOW_SIZE = 32768;
+const qint64 INPUT_CHUNK = 64 * 1024;
+
+// Identifies the archive an index was built from
+qint64 archiveMtime(const QString &archivePath)
+{
+    return QFileInfo(archivePath).lastModified().toMSecsSinceEpoch();
+}
+
+} // namespace
+
+ArchiveIndexBuilder::ArchiveIndexBuilder(qint64 span)
+    : m_stream(new z_stream())
+    , m_window(WINDOW_SIZE, '\0')
+    , m_span(span)
+    , m_lastCheckpoint(0)
+    , m_failed(false)
+    , m_finished(false)
+{
+    // 47: a gzip or zlib header with the largest window
+    m_failed = inflateInit2(m_stream, 47) != Z_OK;
+    m_stream->avail_out = 0;
+}
+
+ArchiveIndexBuilder::~ArchiveIndexBuilder()
+{
+    inflateEnd(m_stream);
+    delete m_stream;
+}
+
+void ArchiveIndexBuilder::addData(const char *data, qint64 length)
+{
+    if (m_failed || length <= 0) {
+        return;
+    }
+
+    // Concatenated gzip members are valid but rare; such archives go unindexed
+    if (m_finished) {
+        m_failed = true;
+        return;
+    }
+
+    m_stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    m_stream->avail_in = uInt(length);
+
+    do {
+        if (m_stream->avail_out == 0) {
+            m_stream->next_out = reinterpret_cast<Bytef *>(m_window.data());
+            m_stream->avail_out = WINDOW_SIZE;
+        }
+
+        // Z_BLOCK returns at every deflate block boundary, the only places
+        // inflation can restart from
+        Bytef *start = m_stream->next_out;
+        int status = inflate(m_stream, Z_BLOCK);
+
+        qint64 produced = m_stream->next_out - start;
+        if (produced > 0 && !m_scanner.feed(start, produced, nullptr)) {
+            m_failed = true;
+            return;
+        }
+
+        if (status == Z_STREAM_END) {
+            m_finished = true;
+            return;
+        }
+        if (status != Z_OK && status != Z_BUF_ERROR) {
+            m_failed = true;
+            return;
+        }
+
+        // Bit 7: at a block boundary; bit 6: after the last block
+        bool boundary = (m_stream->data_type & 128) && !(m_stream->data_type & 64);
+        qint64 totalOut = qint64(m_stream->total_out);
+        if (boundary && (totalOut == 0 || totalOut - m_lastCheckpoint > m_span)) {
+            addCheckpoint(m_stream->data_type & 7);
+        }
+    } while (m_stream->avail_in != 0);
+}
+
+void ArchiveIndexBuilder::addCheckpoint(int bits)
+{
+    GzipCheckpoint checkpoint;
+    checkpoint.compressedOffset = qint64(m_stream->total_in);
+    checkpoint.bits = bits;
+    checkpoint.uncompressedOffset = qint64(m_stream->total_out);
+
+    // Unwrap the circular buffer so the dictionary ends at the checkpoint
+    if (checkpoint.uncompressedOffset > 0) {
+        int left = int(m_stream->avail_out);
+        QByteArray window = m_window.right(left) + m_window.left(WINDOW_SIZE - left);
+        checkpoint.window = qCompress(window);
+    }
+
+    m_checkpoints.append(checkpoint);
+    m_lastCheckpoint = checkpoint.uncompressedOffset;
+}
+
+bool ArchiveIndexBuilder::save(const QString &archivePath)
+{
+    if (m_failed || !m_finished || m_checkpoints.isEmpty()) {
+        return false;
+    }
+
+    QSaveFile file(ArchiveIndex::indexPathFor(archivePath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << INDEX_MAGIC << qint32(ArchiveIndex::FORMAT_VERSION)
+        << QFileInfo(archivePath).size() << archiveMtime(archivePath);
+
+    out << qint32(m_scanner.entries().size());
+    foreach (const TarEntry &entry, m_scanner.entries()) {
+        out << entry.path << entry.linkTarget << qint32(entry.type) << quint32(entry.mode)
+            << entry.size << entry.dataOffset << entry.mtime;
+    }
+
+    out << qint32(m_checkpoints.size());
+    foreach (const GzipCheckpoint &checkpoint, m_checkpoints) {
+        out << checkpoint.compressedOffset << qint32(checkpoint.bits)
+            << checkpoint.uncompressedOffset << checkpoint.window;
+    }
+
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+bool ArchiveIndex::canIndex(const QString &archivePath)
+{
+    return archivePath.endsWith(".tar.gz") || archivePath.endsWith(".tgz");
+}
+
+QString ArchiveIndex::indexPathFor(const QString &archivePath)
+{
+    return archivePath + ".vscidx";
+}
+
+bool ArchiveIndex::build(const QString &archivePath)
+{
+    QFile file(archivePath);
+    if (!canIndex(archivePath) || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    ArchiveIndexBuilder builder;
+    const qint64 chunkSize = 1024 * 1024;
+    while (!file.atEnd()) {
+        QByteArray chunk = file.read(chunkSize);
+        if (chunk.isEmpty()) {
+            return false;
+        }
+        builder.addData(chunk.constData(), chunk.size());
+    }
+
+    return builder.save(archivePath);
+}
+
+bool ArchiveIndex::load(const QString &archivePath)
+{
+    m_archivePath = archivePath;
+    m_entries.clear();
+    m_checkpoints.clear();
+    m_plainTar = archivePath.endsWith(".tar");
+
+    if (m_plainTar) {
+        QFile file(archivePath);
+        if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+            return false;
+        }
+        const uchar *data = file.map(0, file.size());
+        if (!data) {
+            return false;
+        }
+        bool ok = TarArchive::scan(data, file.size(), &m_entries, nullptr);
+        file.unmap(const_cast<uchar *>(data));
+        return ok;
+    }
+
+    QFile file(indexPathFor(archivePath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint32 version = 0;
+    qint64 size = 0;
+    qint64 mtime = 0;
+    in >> magic >> version >> size >> mtime;
+
+    if (magic != INDEX_MAGIC || version != FORMAT_VERSION
+        || size != QFileInfo(archivePath).size() || mtime != archiveMtime(archivePath)) {
+        return false;
+    }
+
+    qint32 entryCount = 0;
+    in >> entryCount;
+    for (qint32 i = 0; i < entryCount && in.status() == QDataStream::Ok; ++i) {
+        TarEntry entry;
+        qint32 type = 0;
+        quint32 mode = 0;
+        in >> entry.path >> entry.linkTarget >> type >> mode >> entry.size >> entry.dataOffset >> entry.mtime;
+        entry.type = TarEntry::Type(type);
+        entry.mode = mode;
+        m_entries.append(entry);
+    }
+
+    qint32 checkpointCount = 0;
+    in >> checkpointCount;
+    for (qint32 i = 0; i < checkpointCount && in.status() == QDataStream::Ok; ++i) {
+        GzipCheckpoint checkpoint;
+        qint32 bits = 0;
+        in >> checkpoint.compressedOffset >> bits >> checkpoint.uncompressedOffset >> checkpoint.window;
+        checkpoint.bits = bits;
+        m_checkpoints.append(checkpoint);
+    }
+
+    return in.status() == QDataStream::Ok && !m_checkpoints.isEmpty();
+}
+
+int ArchiveIndex::find(const QString &suffix) const
+{
+    int best = -1;
+    int bestDepth = 0;
+
+    for (int i = 0; i < m_entries.size(); ++i) {
+        const TarEntry &entry = m_entries.at(i);
+        if (entry.type != TarEntry::File) {
+            continue;
+        }
+        if (entry.path != suffix && !entry.path.endsWith("/" + suffix)) {
+            continue;
+        }
+
+        int depth = entry.path.count('/');
+        if (best < 0 || depth < bestDepth) {
+            best = i;
+            bestDepth = depth;
+        }
+    }
+
+    return best;
+}
+
+bool ArchiveIndex::read(int entry, QByteArray *data, qint64 maxSize) const
+{
+    if (entry < 0 || entry >= m_entries.size() || m_entries.at(entry).type != TarEntry::File
+        || m_entries.at(entry).size > maxSize) {
+        return false;
+    }
+
+    return readRange(m_entries.at(entry).dataOffset, m_entries.at(entry).size, data);
+}
+
+bool ArchiveIndex::readRange(qint64 offset, qint64 length, QByteArray *data) const
+{
+    QFile file(m_archivePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    if (m_plainTar) {
+        if (!file.seek(offset)) {
+            return false;
+        }
+        *data = file.read(length);
+        return data->size() == length;
+    }
+
+    // Last checkpoint at or before the offset
+    auto after = std::upper_bound(m_checkpoints.constBegin(), m_checkpoints.constEnd(), offset,
+                                  [](qint64 value, const GzipCheckpoint &checkpoint) {
+                                      return value < checkpoint.uncompressedOffset;
+                                  });
+    if (after == m_checkpoints.constBegin()) {
+        return false;
+    }
+    const GzipCheckpoint &checkpoint = *(after - 1);
+
+    // A block may start mid-byte; its leading bits are primed from the byte before
+    if (!file.seek(checkpoint.compressedOffset - (checkpoint.bits ? 1 : 0))) {
+        return false;
+    }
+
+    z_stream stream = {};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return false;
+    }
+
+    bool ok = true;
+    if (checkpoint.bits) {
+        char byte = 0;
+        ok = file.getChar(&byte) && inflatePrime(&stream, checkpoint.bits, uchar(byte) >> (8 - checkpoint.bits)) == Z_OK;
+    }
+    if (ok && !checkpoint.window.isEmpty()) {
+        QByteArray window = qUncompress(checkpoint.window);
+        ok = window.size() == WINDOW_SIZE
+             && inflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(window.constData()), WINDOW_SIZE) == Z_OK;
+    }
+
+    QByteArray input;
+    QByteArray output(int(INPUT_CHUNK), Qt::Uninitialized);
+    qint64 skip = offset - checkpoint.uncompressedOffset;
+    data->clear();
+    data->reserve(int(length));
+
+    while (ok && data->size() < length) {
+        if (stream.avail_in == 0) {
+            input = file.read(INPUT_CHUNK);
+            if (input.isEmpty()) {
+                ok = false;
+                break;
+            }
+            stream.next_in = reinterpret_cast<Bytef *>(input.data());
+            stream.avail_in = uInt(input.size());
+        }
+
+        stream.next_out = reinterpret_cast<Bytef *>(output.data());
+        stream.avail_out = uInt(output.size());
+        int status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) {
+            ok = false;
+            break;
+        }
+
+        // Output before the offset is only there to get the inflater to it
+        qint64 produced = output.size() - stream.avail_out;
+        qint64 skipped = qMin(skip, produced);
+        skip -= skipped;
+        data->append(output.constData() + skipped, int(qMin(produced - skipped, length - data->size())));
+
+        if (status == Z_STREAM_END) {
+            break;
+        }
+    }
+
+    inflateEnd(&stream);
+    return ok && data->size() == length;
+}
@@ -0,0 +1,83 @@
+#ifndef ARCHIVEINDEX_H
+#define ARCHIVEINDEX_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "TarArchive.h"
+
+struct z_stream_s;
+
+// Point in a gzip stream where inflation can restart: the deflate block
+// boundary at compressedOffset (bits of the previous byte still to come),
+// and the 32 KiB of output that precede it as dictionary.
+struct GzipCheckpoint
+{
+    qint64 compressedOffset = 0;
+    int bits = 0;
+    qint64 uncompressedOffset = 0;
+    QByteArray window;
+};
+
+// Builds the index of a .tar.gz from its bytes as they are first read, so
+// indexing costs no extra pass over the file: checkpoints every span bytes
+// of output, zran style, and the tar entries with their offsets.
+class ArchiveIndexBuilder
+{
+public:
+    explicit ArchiveIndexBuilder(qint64 span = 4 * 1024 * 1024);
+    ~ArchiveIndexBuilder();
+
+    void addData(const char *data, qint64 length);
+    // Writes the index next to archivePath, once the whole archive was fed
+    bool save(const QString &archivePath);
+
+private:
+    Q_DISABLE_COPY(ArchiveIndexBuilder)
+
+    void addCheckpoint(int bits);
+
+    z_stream_s *m_stream;
+    QByteArray m_window;     // Last 32 KiB of output, written circularly
+    qint64 m_span;
+    qint64 m_lastCheckpoint;
+    QVector<GzipCheckpoint> m_checkpoints;
+    TarStreamScanner m_scanner;
+    bool m_failed;
+    bool m_finished;
+};
+
+// Random access to single files of a compressed archive, through the index
+// written by ArchiveIndexBuilder. Reading one file inflates at most one
+// span instead of the whole archive. Plain .tar archives need no index.
+class ArchiveIndex
+{
+public:
+    static bool canIndex(const QString &archivePath);
+    static QString indexPathFor(const QString &archivePath);
+
+    // Indexes an archive that was not indexed when it was read
+    static bool build(const QString &archivePath);
+
+    // Fails when there is no index or the archive changed since it was built
+    bool load(const QString &archivePath);
+
+    const QVector<TarEntry> &entries() const { return m_entries; }
+
+    // Shallowest regular file whose path ends with suffix, or -1
+    int find(const QString &suffix) const;
+
+    bool read(int entry, QByteArray *data, qint64 maxSize = 16 * 1024 * 1024) const;
+
+    static const int FORMAT_VERSION = 1;
+
+private:
+    bool readRange(qint64 offset, qint64 length, QByteArray *data) const;
+
+    QString m_archivePath;
+    bool m_plainTar = false;
+    QVector<TarEntry> m_entries;
+    QVector<GzipCheckpoint> m_checkpoints;
+};
+
+#endif // ARCHIVEINDEX_H
@@ -0,0 +1,49 @@
+#include "Checksum.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QStringList>
+
+QByteArray Checksum::parseSha256(const QByteArray &text, const QString &fileName)
+{
+    static const QRegularExpression digestRe("(?:^|[^0-9a-fA-F])([0-9a-fA-F]{64})(?:$|[^0-9a-fA-F])");
+
+    QByteArray fallback;
+    QStringList lines = QString::fromUtf8(text).split('\n', QString::SkipEmptyParts);
+
+    foreach (const QString &line, lines) {
+        QRegularExpressionMatch match = digestRe.match(line);
+        if (!match.hasMatch()) {
+            continue;
+        }
+
+        QByteArray digest = match.captured(1).toLower().toLatin1();
+
+        if (fileName.isEmpty() || line.contains(fileName)) {
+            return digest;
+        }
+
+        // Single-entry sidecars often name the file differently than we saved it
+        if (fallback.isEmpty()) {
+            fallback = digest;
+        }
+    }
+
+    return lines.size() == 1 ? fallback : QByteArray();
+}
+
+QString Checksum::sidecarPath(const QString &filePath)
+{
+    return filePath + ".sha256";
+}
+
+QByteArray Checksum::readSidecar(const QString &filePath)
+{
+    QFile sidecar(sidecarPath(filePath));
+    if (!sidecar.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    // Sidecars are a line or two, anything larger is not one
+    return parseSha256(sidecar.read(64 * 1024), QFileInfo(filePath).fileName());
+}
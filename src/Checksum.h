@@ -0,0 +1,24 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <QString>
+#include <QByteArray>
+
+class Checksum
+{
+public:
+    // Extracts a SHA-256 digest (lowercase hex) from user input or from the
+    // contents of a vendor sidecar. Accepts a bare digest, "sha256:<hex>",
+    // coreutils "<hex>  name" lines and BSD "SHA256 (name) = <hex>" lines.
+    // When fileName is given and the text lists several files, only the
+    // matching line is used. Returns an empty array if nothing matches.
+    static QByteArray parseSha256(const QByteArray &text, const QString &fileName = QString());
+
+    // Path of the "<file>.sha256" sidecar that vendors publish next to archives
+    static QString sidecarPath(const QString &filePath);
+
+    // Reads and parses the sidecar next to filePath, if any
+    static QByteArray readSidecar(const QString &filePath);
+};
+
+#endif // CHECKSUM_H
@@ -0,0 +1,294 @@
+#include "DedupStore.h"
+#include "AppRegistry.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QVariant>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/fs.h>
+
+namespace {
+
+bool reflink(const QString &sourcePath, const QString &destPath, uint mode)
+{
+#ifdef FICLONE
+    int source = ::open(QFile::encodeName(sourcePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (source < 0) {
+        return false;
+    }
+
+    int dest = ::open(QFile::encodeName(destPath).constData(),
+                      O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode & 07777);
+    if (dest < 0) {
+        ::close(source);
+        return false;
+    }
+
+    bool ok = ::ioctl(dest, FICLONE, source) == 0;
+    ::close(dest);
+    ::close(source);
+
+    if (!ok) {
+        ::unlink(QFile::encodeName(destPath).constData());
+    }
+    return ok;
+#else
+    Q_UNUSED(sourcePath);
+    Q_UNUSED(destPath);
+    Q_UNUSED(mode);
+    return false;
+#endif
+}
+
+uint fileMode(const QString &path)
+{
+    struct stat st;
+    if (::lstat(QFile::encodeName(path).constData(), &st) != 0) {
+        return 0;
+    }
+    return st.st_mode;
+}
+
+} // namespace
+
+DedupStore::DedupStore(AppRegistry &registry)
+    : m_registry(registry)
+    , m_hardlinksAllowed(false)
+{
+}
+
+void DedupStore::setHardlinksAllowed(bool allowed)
+{
+    m_hardlinksAllowed = allowed;
+}
+
+QString DedupStore::storeRootFor(const QString &installPath)
+{
+    return QDir::cleanPath(installPath) + "/.vscip-store";
+}
+
+qint64 DedupStore::deduplicate(const QString &appName, const QVector<ManifestEntry> &manifest,
+                               const QString &storeRoot)
+{
+    qint64 saved = 0;
+
+    if (!m_registry.beginTransaction()) {
+        return 0;
+    }
+
+    foreach (const ManifestEntry &entry, manifest) {
+        if (entry.kind != ManifestEntry::File || entry.size < MIN_FILE_SIZE || entry.hash.isEmpty()) {
+            continue;
+        }
+
+        // Mode is part of the key: hardlinked files share their permissions
+        QString hash = QString::fromLatin1(entry.hash);
+        QString blobPath = QString("%1/%2/%3-%4")
+            .arg(storeRoot, hash.left(2), hash)
+            .arg(entry.mode & 07777, 4, 8, QChar('0'));
+
+        QSqlQuery &find = m_registry.prepared("SELECT size FROM dedup_blobs WHERE blob_path = ?");
+        find.addBindValue(blobPath);
+        bool known = find.exec() && find.next();
+        find.finish();
+
+        struct stat st;
+        bool onDisk = ::lstat(QFile::encodeName(blobPath).constData(), &st) == 0
+                      && S_ISREG(st.st_mode) && st.st_size == entry.size;
+
+        // A hardlinked blob shares its inode with the apps using it, so an app
+        // writing to its copy changes the blob and only the hash tells.
+        // Reflinked blobs have an inode of their own and are never written.
+        bool intact = known && onDisk
+                      && (st.st_nlink == 1 || InstallManifest::hashFile(blobPath) == entry.hash);
+
+        if (intact) {
+            if (linkFromBlob(blobPath, entry.path) == Failed) {
+                continue;
+            }
+
+            QSqlQuery &addRef = m_registry.prepared("UPDATE dedup_blobs SET refcount = refcount + 1 WHERE blob_path = ?");
+            addRef.addBindValue(blobPath);
+            if (!addRef.exec()) {
+                m_registry.rollback();
+                return 0;
+            }
+            saved += entry.size;
+        } else {
+            // A blob removed or changed behind our back cannot be trusted, start it over
+            if (onDisk) {
+                ::unlink(QFile::encodeName(blobPath).constData());
+            }
+
+            if (!createBlob(entry.path, blobPath)) {
+                continue;
+            }
+
+            // Other apps may still hold references to a blob started over;
+            // the count goes on from their links rather than from one
+            QSqlQuery &addBlob = m_registry.prepared("INSERT OR REPLACE INTO dedup_blobs "
+                                                     "(blob_path, hash, mode, size, refcount) "
+                                                     "VALUES (?, ?, ?, ?, 1 + (SELECT COUNT(*) FROM dedup_links "
+                                                     "WHERE blob_path = ? AND path <> ?))");
+            addBlob.addBindValue(blobPath);
+            addBlob.addBindValue(hash);
+            addBlob.addBindValue(entry.mode & 07777);
+            addBlob.addBindValue(entry.size);
+            addBlob.addBindValue(blobPath);
+            addBlob.addBindValue(entry.path);
+            if (!addBlob.exec()) {
+                m_registry.rollback();
+                return 0;
+            }
+        }
+
+        QSqlQuery &addLink = m_registry.prepared("INSERT OR REPLACE INTO dedup_links (path, app_name, blob_path) "
+                                                 "VALUES (?, ?, ?)");
+        addLink.addBindValue(entry.path);
+        addLink.addBindValue(appName);
+        addLink.addBindValue(blobPath);
+        if (!addLink.exec()) {
+            m_registry.rollback();
+            return 0;
+        }
+    }
+
+    return m_registry.commit() ? saved : 0;
+}
+
+bool DedupStore::release(const QString &appName)
+{
+    if (!m_registry.beginTransaction()) {
+        return false;
+    }
+
+    QSqlQuery &links = m_registry.prepared("SELECT blob_path FROM dedup_links WHERE app_name = ?");
+    links.addBindValue(appName);
+
+    QStringList blobs;
+    if (links.exec()) {
+        while (links.next()) {
+            blobs << links.value(0).toString();
+        }
+    }
+    links.finish();
+
+    foreach (const QString &blobPath, blobs) {
+        QSqlQuery &dropRef = m_registry.prepared("UPDATE dedup_blobs SET refcount = refcount - 1 WHERE blob_path = ?");
+        dropRef.addBindValue(blobPath);
+        if (!dropRef.exec()) {
+            m_registry.rollback();
+            return false;
+        }
+    }
+
+    QSqlQuery &dropLinks = m_registry.prepared("DELETE FROM dedup_links WHERE app_name = ?");
+    dropLinks.addBindValue(appName);
+    if (!dropLinks.exec()) {
+        m_registry.rollback();
+        return false;
+    }
+
+    QSqlQuery &orphans = m_registry.prepared("SELECT blob_path FROM dedup_blobs WHERE refcount <= 0");
+    QStringList unused;
+    if (orphans.exec()) {
+        while (orphans.next()) {
+            unused << orphans.value(0).toString();
+        }
+    }
+    orphans.finish();
+
+    QSqlQuery &dropBlobs = m_registry.prepared("DELETE FROM dedup_blobs WHERE refcount <= 0");
+    if (!dropBlobs.exec()) {
+        m_registry.rollback();
+        return false;
+    }
+
+    if (!m_registry.commit()) {
+        return false;
+    }
+
+    // Only unlink once the registry no longer points at the blobs
+    foreach (const QString &blobPath, unused) {
+        ::unlink(QFile::encodeName(blobPath).constData());
+        QDir().rmdir(QFileInfo(blobPath).absolutePath());
+    }
+
+    return true;
+}
+
+DedupReport DedupStore::report()
+{
+    DedupReport report;
+
+    QSqlQuery &totals = m_registry.prepared("SELECT COUNT(*), SUM(size), SUM(size * (refcount - 1)) FROM dedup_blobs");
+    if (totals.exec() && totals.next()) {
+        report.blobs = totals.value(0).toInt();
+        report.storedBytes = totals.value(1).toLongLong();
+        report.savedBytes = totals.value(2).toLongLong();
+    }
+    totals.finish();
+
+    QSqlQuery &perApp = m_registry.prepared("SELECT app_name, COUNT(*) FROM dedup_links "
+                                            "GROUP BY app_name ORDER BY app_name");
+    if (perApp.exec()) {
+        while (perApp.next()) {
+            int count = perApp.value(1).toInt();
+            report.links += count;
+            report.perApp << QString("%1: %2 archivos compartidos")
+                .arg(perApp.value(0).toString())
+                .arg(count);
+        }
+    }
+    perApp.finish();
+
+    return report;
+}
+
+DedupStore::LinkMethod DedupStore::linkFromBlob(const QString &blobPath, const QString &targetPath)
+{
+    // Build the replacement next to the target, then swap it in atomically
+    QString tempPath = targetPath + ".vscip-dedup";
+    QByteArray temp = QFile::encodeName(tempPath);
+    ::unlink(temp.constData());
+
+    LinkMethod method = Failed;
+    if (reflink(blobPath, tempPath, fileMode(blobPath))) {
+        method = Reflink;
+    } else if (m_hardlinksAllowed && ::link(QFile::encodeName(blobPath).constData(), temp.constData()) == 0) {
+        method = Hardlink;
+    } else {
+        return Failed;
+    }
+
+    if (::rename(temp.constData(), QFile::encodeName(targetPath).constData()) != 0) {
+        ::unlink(temp.constData());
+        return Failed;
+    }
+
+    return method;
+}
+
+bool DedupStore::createBlob(const QString &sourcePath, const QString &blobPath)
+{
+    if (!QDir().mkpath(QFileInfo(blobPath).absolutePath())) {
+        return false;
+    }
+
+    // A reflinked blob is an independent inode, so the app's own copy stays private
+    if (reflink(sourcePath, blobPath, fileMode(sourcePath))) {
+        return true;
+    }
+
+    if (m_hardlinksAllowed
+        && ::link(QFile::encodeName(sourcePath).constData(), QFile::encodeName(blobPath).constData()) == 0) {
+        return true;
+    }
+
+    // The file stays private; leave no empty fan-out directory behind
+    QDir().rmdir(QFileInfo(blobPath).absolutePath());
+    return false;
+}
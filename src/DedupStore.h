@@ -0,0 +1,62 @@
+#ifndef DEDUPSTORE_H
+#define DEDUPSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "InstallManifest.h"
+
+class AppRegistry;
+
+struct DedupReport
+{
+    int blobs = 0;
+    int links = 0;
+    qint64 storedBytes = 0;  // One copy of each blob
+    qint64 savedBytes = 0;   // Bytes that would exist without deduplication
+    QStringList perApp;      // "<app>: <n> archivos compartidos"
+};
+
+// Content-addressed store that shares identical files across installed apps.
+// Each store lives at <installPath>/.vscip-store so blobs are always on the
+// same filesystem as the apps that use them. Files are reflinked, which is
+// true copy-on-write, on filesystems that support it (btrfs, XFS). Elsewhere
+// files are only shared as hard links when asked to: a hard link is one
+// inode for every app, so a write by any of them reaches all of them. The
+// installer itself never writes into an installed tree in place, and a
+// hardlinked blob's contents are checked against its hash before each new
+// link.
+class DedupStore
+{
+public:
+    explicit DedupStore(AppRegistry &registry);
+
+    // Falls back to hard links where reflinks are not supported. Off by default.
+    void setHardlinksAllowed(bool allowed);
+
+    static QString storeRootFor(const QString &installPath);
+
+    // Replaces duplicates in manifest with links to store blobs and records
+    // the references. Returns the number of bytes saved.
+    qint64 deduplicate(const QString &appName, const QVector<ManifestEntry> &manifest,
+                       const QString &storeRoot);
+
+    // Drops every reference held by appName and deletes blobs nobody uses
+    bool release(const QString &appName);
+
+    DedupReport report();
+
+    // Files smaller than this cost more in metadata than they save
+    static const qint64 MIN_FILE_SIZE = 16 * 1024;
+
+private:
+    enum LinkMethod { Reflink, Hardlink, Failed };
+
+    LinkMethod linkFromBlob(const QString &blobPath, const QString &targetPath);
+    bool createBlob(const QString &sourcePath, const QString &blobPath);
+
+    AppRegistry &m_registry;
+    bool m_hardlinksAllowed;
+};
+
+#endif // DEDUPSTORE_H
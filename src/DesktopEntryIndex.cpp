@@ -0,0 +1,383 @@
+#include "DesktopEntryIndex.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTextStream>
+
+namespace {
+
+const quint32 CACHE_MAGIC = 0x56444549; // "VDEI"
+const quint32 CACHE_VERSION = 1;
+
+} // namespace
+
+DesktopEntryIndex::DesktopEntryIndex(QObject *parent)
+    : QObject(parent)
+    , m_loaded(false)
+    , m_dirty(false)
+{
+    m_rescanTimer.setSingleShot(true);
+    m_rescanTimer.setInterval(RESCAN_DELAY_MS);
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(SAVE_DELAY_MS);
+
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &DesktopEntryIndex::onDirectoryChanged);
+    connect(&m_rescanTimer, &QTimer::timeout, this, &DesktopEntryIndex::rescanChangedDirectories);
+    connect(&m_saveTimer, &QTimer::timeout, this, &DesktopEntryIndex::save);
+}
+
+DesktopEntryIndex::~DesktopEntryIndex()
+{
+    save();
+}
+
+QVector<DesktopEntryInfo> DesktopEntryIndex::entriesForExec(const QString &exec)
+{
+    ensureLoaded();
+    return lookup(m_byExec, resolveExec(exec));
+}
+
+QVector<DesktopEntryInfo> DesktopEntryIndex::entriesNamed(const QString &name)
+{
+    ensureLoaded();
+    return lookup(m_byName, name.toLower());
+}
+
+QVector<DesktopEntryInfo> DesktopEntryIndex::entriesForWmClass(const QString &wmClass)
+{
+    ensureLoaded();
+    return lookup(m_byWmClass, wmClass);
+}
+
+bool DesktopEntryIndex::contains(const QString &path)
+{
+    ensureLoaded();
+    return m_byPath.contains(path);
+}
+
+DesktopEntryInfo DesktopEntryIndex::entry(const QString &path)
+{
+    ensureLoaded();
+    return m_byPath.value(path);
+}
+
+void DesktopEntryIndex::refreshFile(const QString &path)
+{
+    ensureLoaded();
+
+    DesktopEntryInfo info;
+    if (parse(path, &info)) {
+        insert(info);
+    } else {
+        remove(path);
+    }
+    m_dirty = true;
+    m_saveTimer.start();
+}
+
+QString DesktopEntryIndex::resolveExec(const QString &execValue)
+{
+    // The program is the first word; double quotes group words with spaces
+    QString value = execValue.trimmed();
+    QString program;
+    if (value.startsWith('"')) {
+        for (int i = 1; i < value.size(); ++i) {
+            QChar c = value.at(i);
+            if (c == '\\' && i + 1 < value.size()) {
+                program += value.at(++i);
+            } else if (c == '"') {
+                break;
+            } else {
+                program += c;
+            }
+        }
+    } else {
+        program = value.section(' ', 0, 0);
+    }
+
+    if (program.isEmpty()) {
+        return QString();
+    }
+
+    if (!QDir::isAbsolutePath(program)) {
+        QString found = QStandardPaths::findExecutable(program);
+        if (found.isEmpty()) {
+            return program;
+        }
+        program = found;
+    }
+
+    // /usr/local/bin links and the install tree name the same program
+    QString canonical = QFileInfo(program).canonicalFilePath();
+    return canonical.isEmpty() ? program : canonical;
+}
+
+QStringList DesktopEntryIndex::applicationDirs()
+{
+    // XDG_DATA_HOME first, then every XDG_DATA_DIRS entry
+    return QStandardPaths::standardLocations(QStandardPaths::ApplicationsLocation);
+}
+
+QString DesktopEntryIndex::cachePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/desktop-entries.idx";
+}
+
+void DesktopEntryIndex::onDirectoryChanged(const QString &dir)
+{
+    // Writers touch a directory several times per file; handle the burst once
+    m_changedDirs.insert(dir);
+    m_rescanTimer.start();
+}
+
+void DesktopEntryIndex::rescanChangedDirectories()
+{
+    QSet<QString> dirs = m_changedDirs;
+    m_changedDirs.clear();
+
+    foreach (const QString &dir, dirs) {
+        scanDirectory(dir);
+    }
+
+    if (m_dirty) {
+        m_saveTimer.start();
+    }
+}
+
+void DesktopEntryIndex::save()
+{
+    if (!m_dirty) {
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(cachePath()).path());
+    QSaveFile file(cachePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << CACHE_MAGIC << CACHE_VERSION << quint32(m_byPath.size());
+    foreach (const DesktopEntryInfo &info, m_byPath) {
+        out << info.path << info.mtime << info.name << info.exec << info.startupWMClass;
+    }
+
+    if (out.status() == QDataStream::Ok && file.commit()) {
+        m_dirty = false;
+    }
+}
+
+void DesktopEntryIndex::ensureLoaded()
+{
+    if (m_loaded) {
+        return;
+    }
+    m_loaded = true;
+
+    // A missing or stale cache only costs a full parse
+    m_dirty = !loadCache();
+
+    foreach (const QString &dir, applicationDirs()) {
+        scanDirectory(dir);
+    }
+
+    // Entries whose directory is gone were not visited by any scan
+    QStringList dirs = applicationDirs();
+    foreach (const QString &path, m_byPath.keys()) {
+        bool underKnownDir = false;
+        foreach (const QString &dir, dirs) {
+            if (path.startsWith(dir + "/")) {
+                underKnownDir = true;
+                break;
+            }
+        }
+        if (!underKnownDir || !QFileInfo::exists(path)) {
+            remove(path);
+            m_dirty = true;
+        }
+    }
+
+    if (m_dirty) {
+        save();
+    }
+}
+
+bool DesktopEntryIndex::loadCache()
+{
+    QFile file(cachePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != CACHE_MAGIC || version != CACHE_VERSION) {
+        return false;
+    }
+
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        DesktopEntryInfo info;
+        in >> info.path >> info.mtime >> info.name >> info.exec >> info.startupWMClass;
+        if (in.status() == QDataStream::Ok) {
+            insert(info);
+        }
+    }
+
+    return in.status() == QDataStream::Ok;
+}
+
+void DesktopEntryIndex::scanDirectory(const QString &dir)
+{
+    if (!QFileInfo(dir).isDir()) {
+        return;
+    }
+
+    // Menus also read subdirectories, e.g. applications/kde4
+    QStringList dirs;
+    dirs << dir;
+    QDirIterator subdirs(dir, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (subdirs.hasNext()) {
+        dirs << subdirs.next();
+    }
+
+    QStringList watched = m_watcher.directories();
+    foreach (const QString &path, dirs) {
+        if (!watched.contains(path)) {
+            m_watcher.addPath(path);
+        }
+    }
+
+    QSet<QString> present;
+    QDirIterator files(dir, QStringList() << "*.desktop", QDir::Files, QDirIterator::Subdirectories);
+    while (files.hasNext()) {
+        QString path = files.next();
+        present.insert(path);
+
+        // Only files whose mtime moved are read again
+        qint64 mtime = files.fileInfo().lastModified().toMSecsSinceEpoch();
+        auto known = m_byPath.constFind(path);
+        if (known != m_byPath.constEnd() && known->mtime == mtime) {
+            continue;
+        }
+
+        DesktopEntryInfo info;
+        if (parse(path, &info)) {
+            insert(info);
+        } else {
+            remove(path);
+        }
+        m_dirty = true;
+    }
+
+    QString prefix = dir + "/";
+    foreach (const QString &path, m_byPath.keys()) {
+        if (path.startsWith(prefix) && !present.contains(path)) {
+            remove(path);
+            m_dirty = true;
+        }
+    }
+}
+
+bool DesktopEntryIndex::parse(const QString &path, DesktopEntryInfo *info)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    info->path = path;
+    info->mtime = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+    bool inMainGroup = false;
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (line.startsWith('[')) {
+            // Actions and other groups follow the main one
+            if (inMainGroup) {
+                break;
+            }
+            inMainGroup = (line == "[Desktop Entry]");
+            continue;
+        }
+        if (!inMainGroup) {
+            continue;
+        }
+
+        int equals = line.indexOf('=');
+        if (equals <= 0) {
+            continue;
+        }
+        QString key = line.left(equals).trimmed();
+        QString value = line.mid(equals + 1).trimmed();
+
+        if (key == "Name") {
+            info->name = value;
+        } else if (key == "Exec") {
+            info->exec = resolveExec(value);
+        } else if (key == "StartupWMClass") {
+            info->startupWMClass = value;
+        }
+    }
+
+    return true;
+}
+
+void DesktopEntryIndex::insert(const DesktopEntryInfo &info)
+{
+    remove(info.path);
+
+    m_byPath.insert(info.path, info);
+    if (!info.exec.isEmpty()) {
+        m_byExec[info.exec].append(info.path);
+    }
+    if (!info.name.isEmpty()) {
+        m_byName[info.name.toLower()].append(info.path);
+    }
+    if (!info.startupWMClass.isEmpty()) {
+        m_byWmClass[info.startupWMClass].append(info.path);
+    }
+}
+
+void DesktopEntryIndex::remove(const QString &path)
+{
+    auto it = m_byPath.find(path);
+    if (it == m_byPath.end()) {
+        return;
+    }
+
+    auto unlink = [&path](QHash<QString, QStringList> &byKey, const QString &key) {
+        auto bucket = byKey.find(key);
+        if (bucket != byKey.end()) {
+            bucket->removeAll(path);
+            if (bucket->isEmpty()) {
+                byKey.erase(bucket);
+            }
+        }
+    };
+    unlink(m_byExec, it->exec);
+    unlink(m_byName, it->name.toLower());
+    unlink(m_byWmClass, it->startupWMClass);
+
+    m_byPath.erase(it);
+}
+
+QVector<DesktopEntryInfo> DesktopEntryIndex::lookup(const QHash<QString, QStringList> &byKey, const QString &key) const
+{
+    QVector<DesktopEntryInfo> entries;
+    foreach (const QString &path, byKey.value(key)) {
+        entries.append(m_byPath.value(path));
+    }
+    return entries;
+}
@@ -0,0 +1,84 @@
+#ifndef DESKTOPENTRYINDEX_H
+#define DESKTOPENTRYINDEX_H
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+// What the index keeps of one .desktop file
+struct DesktopEntryInfo
+{
+    QString path;
+    qint64 mtime = 0;       // ms since the epoch; the file is reparsed when it changes
+    QString name;
+    QString exec;           // Resolved executable of Exec, canonical when it exists
+    QString startupWMClass;
+};
+
+// Every .desktop file under the XDG applications directories, with O(1)
+// lookups by executable, name and StartupWMClass. The index is persisted
+// between runs, so loading it only stats the files and reparses the ones
+// that changed; while the process runs, QFileSystemWatcher keeps it current.
+class DesktopEntryIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DesktopEntryIndex(QObject *parent = nullptr);
+    // Writes out changes still waiting for the save timer
+    ~DesktopEntryIndex();
+
+    // Entries launching exec, compared after resolving symlinks and PATH
+    QVector<DesktopEntryInfo> entriesForExec(const QString &exec);
+    // Case-insensitive
+    QVector<DesktopEntryInfo> entriesNamed(const QString &name);
+    QVector<DesktopEntryInfo> entriesForWmClass(const QString &wmClass);
+    bool contains(const QString &path);
+    DesktopEntryInfo entry(const QString &path);
+
+    // Reparses one file right away, e.g. after writing it, instead of
+    // waiting for the watcher
+    void refreshFile(const QString &path);
+
+    // Executable named by an Exec value, canonical when it exists
+    static QString resolveExec(const QString &execValue);
+
+    static QStringList applicationDirs();
+    static QString cachePath();
+
+private slots:
+    void onDirectoryChanged(const QString &dir);
+    void rescanChangedDirectories();
+    void save();
+
+private:
+    // Loads the persisted index and brings it up to date, on first use
+    void ensureLoaded();
+    bool loadCache();
+    void scanDirectory(const QString &dir);
+    static bool parse(const QString &path, DesktopEntryInfo *info);
+    void insert(const DesktopEntryInfo &info);
+    void remove(const QString &path);
+    QVector<DesktopEntryInfo> lookup(const QHash<QString, QStringList> &byKey, const QString &key) const;
+
+    bool m_loaded;
+    bool m_dirty;
+    QHash<QString, DesktopEntryInfo> m_byPath;
+    QHash<QString, QStringList> m_byExec;
+    QHash<QString, QStringList> m_byName;
+    QHash<QString, QStringList> m_byWmClass;
+    QFileSystemWatcher m_watcher;
+    QSet<QString> m_changedDirs;
+    QTimer m_rescanTimer;
+    QTimer m_saveTimer;
+
+    static const int RESCAN_DELAY_MS = 200;
+    static const int SAVE_DELAY_MS = 2000;
+};
+
+#endif // DESKTOPENTRYINDEX_H
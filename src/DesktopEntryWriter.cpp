@@ -0,0 +1,85 @@
+#include "DesktopEntryWriter.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+DesktopEntryWriter::DesktopEntryWriter()
+{
+}
+
+DesktopEntryWriter::~DesktopEntryWriter()
+{
+    flush();
+}
+
+DesktopEntryWriter::Result DesktopEntryWriter::write(const QString &path, const QString &content)
+{
+    QByteArray data = content.toUtf8();
+
+    // Rewriting an identical entry would still wake every menu watcher
+    QFile existing(path);
+    if (existing.size() == data.size() && existing.open(QIODevice::ReadOnly) && existing.readAll() == data) {
+        return Unchanged;
+    }
+    existing.close();
+
+    QString dir = QFileInfo(path).absolutePath();
+    QDir().mkpath(dir);
+
+    // Menus rescan as soon as the directory changes; they must never read half an entry
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return Failed;
+    }
+    file.write(data);
+    if (!file.commit()) {
+        return Failed;
+    }
+
+    m_dirtyDirs.insert(dir);
+    return Written;
+}
+
+void DesktopEntryWriter::flush()
+{
+    if (m_dirtyDirs.isEmpty()) {
+        return;
+    }
+
+    QString updateDatabase = QStandardPaths::findExecutable("update-desktop-database");
+    if (!updateDatabase.isEmpty()) {
+        foreach (const QString &dir, m_dirtyDirs) {
+            QProcess::startDetached(updateDatabase, QStringList() << "-q" << dir);
+        }
+    }
+
+    QString desktopMenu = QStandardPaths::findExecutable("xdg-desktop-menu");
+    if (!desktopMenu.isEmpty()) {
+        bool system = m_dirtyDirs.contains(applicationsDir(true));
+        QProcess::startDetached(desktopMenu, QStringList() << "forceupdate" << "--mode" << (system ? "system" : "user"));
+    }
+
+    m_dirtyDirs.clear();
+}
+
+QString DesktopEntryWriter::applicationsDir(bool system)
+{
+    if (system) {
+        return "/usr/share/applications";
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::ApplicationsLocation);
+}
+
+QString DesktopEntryWriter::quoteExec(const QString &program)
+{
+    if (!program.contains(' ')) {
+        return program;
+    }
+
+    QString quoted = program;
+    quoted.replace("\\", "\\\\").replace("\"", "\\\"").replace("`", "\\`").replace("$", "\\$");
+    return "\"" + quoted + "\"";
+}
@@ -0,0 +1,40 @@
+#ifndef DESKTOPENTRYWRITER_H
+#define DESKTOPENTRYWRITER_H
+
+#include <QSet>
+#include <QString>
+
+// Writes .desktop files for one batch of launchers. Each file is replaced
+// atomically and only when its content changes; the menu databases are
+// refreshed once for the whole batch by flush() instead of once per entry.
+class DesktopEntryWriter
+{
+public:
+    enum Result {
+        Written,
+        Unchanged,
+        Failed
+    };
+
+    DesktopEntryWriter();
+    // Flushes whatever is still pending
+    ~DesktopEntryWriter();
+
+    Result write(const QString &path, const QString &content);
+
+    // Runs update-desktop-database on every directory written to, then
+    // xdg-desktop-menu forceupdate, without waiting for either
+    void flush();
+
+    // /usr/share/applications for system installs, otherwise the user's
+    static QString applicationsDir(bool system);
+
+    // Program path as an Exec value: quoted when it holds spaces, which
+    // would otherwise split it into arguments
+    static QString quoteExec(const QString &program);
+
+private:
+    QSet<QString> m_dirtyDirs;
+};
+
+#endif // DESKTOPENTRYWRITER_H
@@ -0,0 +1,255 @@
+#include "DiskPreflight.h"
+#include "TarArchive.h"
+#include "ZipArchive.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QProcess>
+#include <QStringList>
+#include <sys/statvfs.h>
+#include <sys/stat.h>
+
+namespace {
+
+// Typical tar:compressed ratios for Electron editor payloads
+double compressionRatio(const QString &fileName)
+{
+    if (fileName.endsWith(".tar.xz") || fileName.endsWith(".txz")) {
+        return 5.0;
+    } else if (fileName.endsWith(".tar.bz2") || fileName.endsWith(".tbz2")) {
+        return 4.0;
+    } else if (fileName.endsWith(".tar.zst") || fileName.endsWith(".tzst")) {
+        return 4.0;
+    } else if (fileName.endsWith(".tar.gz") || fileName.endsWith(".tgz")) {
+        return 3.0;
+    } else if (fileName.endsWith(".zip")) {
+        return 3.0;
+    }
+    return 1.0;
+}
+
+// Average tar bytes per entry; errs low so that inodes are overestimated
+const qint64 BYTES_PER_ENTRY = 32 * 1024;
+
+ArchiveFootprint footprintFromTarSize(qint64 tarBytes)
+{
+    ArchiveFootprint footprint;
+    footprint.inodes = tarBytes / BYTES_PER_ENTRY + 1;
+    // Half a 4 KiB block of slack per entry, headers and padding already
+    // make the tar stream slightly larger than the payload
+    footprint.bytes = tarBytes + footprint.inodes * 2048;
+    footprint.exact = false;
+    return footprint;
+}
+
+// gzip stores the uncompressed size modulo 2^32 in its last four bytes
+qint64 gzipUncompressedSize(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < 18) {
+        return -1;
+    }
+
+    file.seek(file.size() - 4);
+    QByteArray trailer = file.read(4);
+    if (trailer.size() != 4) {
+        return -1;
+    }
+
+    const uchar *bytes = reinterpret_cast<const uchar *>(trailer.constData());
+    qint64 size = qint64(bytes[0]) | (qint64(bytes[1]) << 8) | (qint64(bytes[2]) << 16) | (qint64(bytes[3]) << 24);
+
+    // Archives over 4 GiB wrap around; gzip never shrinks a tar below its compressed size
+    while (size < file.size()) {
+        size += Q_INT64_C(1) << 32;
+    }
+    return size;
+}
+
+// xz keeps an index with exact sizes at the end of each stream
+qint64 xzUncompressedSize(const QString &path)
+{
+    QProcess process;
+    process.start("xz", QStringList() << "--robot" << "--list" << path);
+    if (!process.waitForFinished(10000) || process.exitCode() != 0) {
+        return -1;
+    }
+
+    foreach (const QByteArray &line, process.readAllStandardOutput().split('\n')) {
+        if (line.startsWith("totals\t")) {
+            QList<QByteArray> columns = line.split('\t');
+            if (columns.size() > 4) {
+                bool ok = false;
+                qint64 size = columns.at(4).toLongLong(&ok);
+                return ok ? size : -1;
+            }
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+ArchiveFootprint DiskPreflight::measureArchive(const QString &archivePath)
+{
+    QFileInfo info(archivePath);
+
+    if (archivePath.endsWith(".tar")) {
+        QFile file(archivePath);
+        if (file.open(QIODevice::ReadOnly) && file.size() > 0) {
+            const uchar *data = file.map(0, file.size());
+            if (data) {
+                QVector<TarEntry> entries;
+                bool ok = TarArchive::scan(data, file.size(), &entries, nullptr);
+                file.unmap(const_cast<uchar *>(data));
+
+                if (ok) {
+                    ArchiveFootprint footprint;
+                    footprint.bytes = TarArchive::diskFootprint(entries);
+                    foreach (const TarEntry &entry, entries) {
+                        if (entry.type != TarEntry::Hardlink && entry.type != TarEntry::Other) {
+                            footprint.inodes++;
+                        }
+                    }
+                    footprint.exact = true;
+                    return footprint;
+                }
+            }
+        }
+    }
+
+    // The zip central directory lists every entry with its size
+    if (archivePath.endsWith(".zip", Qt::CaseInsensitive)) {
+        QFile file(archivePath);
+        if (file.open(QIODevice::ReadOnly) && file.size() > 0) {
+            const uchar *data = file.map(0, file.size());
+            if (data) {
+                QVector<ZipEntry> entries;
+                bool ok = ZipArchive::scan(data, file.size(), &entries, nullptr);
+                file.unmap(const_cast<uchar *>(data));
+
+                if (ok) {
+                    ArchiveFootprint footprint;
+                    footprint.bytes = ZipArchive::diskFootprint(entries);
+                    footprint.inodes = entries.size();
+                    footprint.exact = true;
+                    return footprint;
+                }
+            }
+        }
+    }
+
+    qint64 tarBytes = -1;
+    if (archivePath.endsWith(".tar.gz") || archivePath.endsWith(".tgz")) {
+        tarBytes = gzipUncompressedSize(archivePath);
+    } else if (archivePath.endsWith(".tar.xz") || archivePath.endsWith(".txz")) {
+        tarBytes = xzUncompressedSize(archivePath);
+    }
+
+    if (tarBytes > 0) {
+        return footprintFromTarSize(tarBytes);
+    }
+
+    return estimateFromCompressedSize(info.size(), info.fileName());
+}
+
+ArchiveFootprint DiskPreflight::estimateFromCompressedSize(qint64 compressedBytes, const QString &fileName)
+{
+    return footprintFromTarSize(qint64(compressedBytes * compressionRatio(fileName)));
+}
+
+FilesystemSpace DiskPreflight::spaceFor(const QString &path)
+{
+    FilesystemSpace space;
+
+    // The target directory usually does not exist yet
+    QString existing = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+    while (!QFileInfo(existing).isDir() && existing != "/") {
+        existing = QFileInfo(existing).absolutePath();
+    }
+
+    struct statvfs fs;
+    struct stat st;
+    QByteArray encoded = QFile::encodeName(existing);
+    if (::statvfs(encoded.constData(), &fs) != 0 || ::stat(encoded.constData(), &st) != 0) {
+        return space;
+    }
+
+    space.path = existing;
+    space.device = st.st_dev;
+    space.availableBytes = qint64(fs.f_bavail) * qint64(fs.f_frsize);
+    // btrfs and some network filesystems report no inode limit at all
+    space.availableInodes = fs.f_files == 0 ? -1 : qint64(fs.f_favail);
+    space.valid = true;
+    return space;
+}
+
+bool DiskPreflight::check(const ArchiveFootprint &footprint, const QString &stagingDir,
+                          const QString &targetDir, qint64 extraStagingBytes, QString *error)
+{
+    FilesystemSpace staging = spaceFor(stagingDir);
+    FilesystemSpace target = spaceFor(targetDir);
+
+    // Without statvfs there is nothing to compare against, let the install try
+    if (!staging.valid || !target.valid) {
+        return true;
+    }
+
+    // Estimates get a safety margin, exact header counts do not need one
+    qint64 bytes = footprint.exact ? footprint.bytes : footprint.bytes + footprint.bytes / 10;
+    qint64 inodes = footprint.exact ? footprint.inodes : footprint.inodes + footprint.inodes / 10;
+
+    struct Requirement {
+        FilesystemSpace space;
+        qint64 bytes;
+        qint64 inodes;
+    };
+
+    QVector<Requirement> requirements;
+    if (staging.device == target.device) {
+        requirements.append({ staging, bytes + extraStagingBytes, inodes });
+    } else {
+        requirements.append({ staging, bytes + extraStagingBytes, inodes });
+        requirements.append({ target, bytes, inodes });
+    }
+
+    foreach (const Requirement &req, requirements) {
+        if (req.bytes > req.space.availableBytes) {
+            if (error) {
+                *error = QString("Espacio insuficiente en %1: se necesitan %2%3, hay %4 disponibles")
+                    .arg(req.space.path)
+                    .arg(formatBytes(req.bytes))
+                    .arg(footprint.exact ? "" : " (estimado)")
+                    .arg(formatBytes(req.space.availableBytes));
+            }
+            return false;
+        }
+
+        if (req.space.availableInodes >= 0 && req.inodes > req.space.availableInodes) {
+            if (error) {
+                *error = QString("Inodos insuficientes en %1: se necesitan %2%3, hay %4 disponibles")
+                    .arg(req.space.path)
+                    .arg(req.inodes)
+                    .arg(footprint.exact ? "" : " (estimado)")
+                    .arg(req.space.availableInodes);
+            }
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QString DiskPreflight::formatBytes(qint64 bytes)
+{
+    const char *units[] = { "B", "KB", "MB", "GB", "TB" };
+    double value = bytes;
+    int unit = 0;
+
+    while (value >= 1024.0 && unit < 4) {
+        value /= 1024.0;
+        unit++;
+    }
+
+    return QString("%1 %2").arg(value, 0, 'f', unit == 0 ? 0 : 1).arg(units[unit]);
+}
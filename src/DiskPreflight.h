@@ -0,0 +1,48 @@
+#ifndef DISKPREFLIGHT_H
+#define DISKPREFLIGHT_H
+
+#include <QString>
+
+struct ArchiveFootprint
+{
+    qint64 bytes = 0;   // Space the extracted tree needs on disk
+    qint64 inodes = 0;
+    bool exact = false; // False when derived from a compression ratio
+};
+
+struct FilesystemSpace
+{
+    QString path;            // Existing directory statvfs() was run on
+    quint64 device = 0;
+    qint64 availableBytes = 0;
+    qint64 availableInodes = -1; // -1 when the filesystem has no inode limit
+    bool valid = false;
+};
+
+// Works out, before anything is written, whether an archive fits on the
+// staging and target filesystems.
+class DiskPreflight
+{
+public:
+    // Plain .tar and .zip archives are measured exactly from their headers. For
+    // compressed archives the uncompressed size comes from the gzip ISIZE
+    // trailer or the xz index, and inodes are estimated from it.
+    static ArchiveFootprint measureArchive(const QString &archivePath);
+
+    // Estimate for a stream whose only known property is its compressed size
+    static ArchiveFootprint estimateFromCompressedSize(qint64 compressedBytes, const QString &fileName);
+
+    // statvfs() on path, or on its nearest existing ancestor
+    static FilesystemSpace spaceFor(const QString &path);
+
+    // Checks staging and target. When both are on the same filesystem the
+    // tree is renamed into place, so the space is only needed once.
+    // extraStagingBytes covers files that stay in staging during extraction
+    // (e.g. the downloaded archive). Returns false with a readable message.
+    static bool check(const ArchiveFootprint &footprint, const QString &stagingDir,
+                      const QString &targetDir, qint64 extraStagingBytes, QString *error);
+
+    static QString formatBytes(qint64 bytes);
+};
+
+#endif // DISKPREFLIGHT_H
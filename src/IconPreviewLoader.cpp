@@ -0,0 +1,124 @@
+#include "IconPreviewLoader.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QImageReader>
+#include <QtConcurrent>
+
+namespace {
+
+// Plenty for the previews of one session
+const int CACHE_KIB = 4 * 1024;
+
+} // namespace
+
+IconPreviewLoader::IconPreviewLoader(const QSize &size, QObject *parent)
+    : QObject(parent)
+    , m_size(size)
+    , m_generation(0)
+    , m_cache(CACHE_KIB)
+{
+    m_debounce.setSingleShot(true);
+    m_debounce.setInterval(DEBOUNCE_MS);
+    connect(&m_debounce, &QTimer::timeout, this, &IconPreviewLoader::startLoad);
+}
+
+void IconPreviewLoader::request(const QString &path)
+{
+    // Results of loads already running are stale from now on
+    m_generation++;
+    m_pendingPath = path;
+
+    if (path.isEmpty()) {
+        m_debounce.stop();
+        emit previewMissing(path);
+        return;
+    }
+
+    m_debounce.start();
+}
+
+void IconPreviewLoader::startLoad()
+{
+    int generation = m_generation;
+    QString path = m_pendingPath;
+    QSize size = m_size;
+
+    // The worker only decodes what is not cached; QCache itself stays on this thread
+    QSet<QString> cachedKeys = QSet<QString>::fromList(m_cache.keys());
+
+    QFutureWatcher<IconPreview> *watcher = new QFutureWatcher<IconPreview>(this);
+    connect(watcher, &QFutureWatcher<IconPreview>::finished, this, [this, watcher, generation]() {
+        finishLoad(watcher->result(), generation);
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(&IconPreviewLoader::load, path, size, cachedKeys));
+}
+
+void IconPreviewLoader::finishLoad(const IconPreview &preview, int generation)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    if (preview.key.isEmpty()) {
+        emit previewMissing(preview.path);
+        return;
+    }
+
+    if (preview.cached) {
+        if (QPixmap *pixmap = m_cache.object(preview.key)) {
+            emit previewReady(preview.path, *pixmap);
+        } else {
+            // Evicted while the worker was looking; decode it after all
+            startLoad();
+        }
+        return;
+    }
+
+    if (preview.image.isNull()) {
+        emit previewInvalid(preview.path);
+        return;
+    }
+
+    // Pixmaps may only be created on the GUI thread
+    QPixmap *pixmap = new QPixmap(QPixmap::fromImage(preview.image));
+    int cost = qMax(1, preview.image.bytesPerLine() * preview.image.height() / 1024);
+    emit previewReady(preview.path, *pixmap);
+    m_cache.insert(preview.key, pixmap, cost);
+}
+
+IconPreview IconPreviewLoader::load(const QString &path, const QSize &size, const QSet<QString> &cachedKeys)
+{
+    IconPreview preview;
+    preview.path = path;
+
+    QFileInfo info(path);
+    if (!info.isFile()) {
+        return preview;
+    }
+
+    preview.key = path + "|" + QString::number(info.lastModified().toMSecsSinceEpoch());
+    if (cachedKeys.contains(preview.key)) {
+        preview.cached = true;
+        return preview;
+    }
+
+    // JPEG and SVG decode directly at the requested size; other formats are
+    // scaled once here, still off the GUI thread
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+    QSize original = reader.size();
+    if (original.isValid() && (original.width() > size.width() || original.height() > size.height()
+                               || reader.format() == "svg" || reader.format() == "svgz")) {
+        reader.setScaledSize(original.scaled(size, Qt::KeepAspectRatio));
+    }
+
+    QImage image = reader.read();
+    if (!image.isNull() && (image.width() > size.width() || image.height() > size.height())) {
+        image = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    preview.image = image;
+
+    return preview;
+}
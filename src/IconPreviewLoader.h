@@ -0,0 +1,61 @@
+#ifndef ICONPREVIEWLOADER_H
+#define ICONPREVIEWLOADER_H
+
+#include <QCache>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QSize>
+#include <QString>
+#include <QTimer>
+
+// Outcome of loading one icon on a worker thread
+struct IconPreview
+{
+    QString path;
+    QString key;          // Path and mtime; empty if the file does not exist
+    bool cached = false;  // key was already cached, nothing was decoded
+    QImage image;         // Null if the file could not be decoded
+};
+
+// Loads icon previews off the GUI thread. Requests are debounced so that
+// typing a path decodes only what the user stopped at, images are decoded
+// straight at preview size where the format allows it, and results are
+// kept in an LRU cache keyed by path and mtime, so an edited file is
+// picked up while an unchanged one is never decoded twice.
+class IconPreviewLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit IconPreviewLoader(const QSize &size, QObject *parent = nullptr);
+
+    // Replaces any pending request; an empty path clears the preview at once
+    void request(const QString &path);
+
+    // Blocking; safe on any thread
+    static IconPreview load(const QString &path, const QSize &size, const QSet<QString> &cachedKeys);
+
+    static const int DEBOUNCE_MS = 150;
+
+signals:
+    void previewReady(const QString &path, const QPixmap &pixmap);
+    void previewMissing(const QString &path);
+    void previewInvalid(const QString &path);
+
+private slots:
+    void startLoad();
+
+private:
+    void finishLoad(const IconPreview &preview, int generation);
+
+    QSize m_size;
+    QTimer m_debounce;
+    QString m_pendingPath;
+    int m_generation;
+    // Cost in KiB; a 64 px preview is 16 KiB
+    QCache<QString, QPixmap> m_cache;
+};
+
+#endif // ICONPREVIEWLOADER_H
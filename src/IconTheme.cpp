@@ -0,0 +1,210 @@
+#include "IconTheme.h"
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QProcess>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace {
+
+// Where Electron editors keep their application icon, most specific first;
+// the install root is where the installer used to look for icon.png
+const char *const ICON_DIRS[] = {
+    "resources/app/resources/linux",
+    "resources/app/resources",
+    "resources",
+    ""
+};
+
+// Smaller PNGs in those directories are tray and file-type icons
+const int MIN_SOURCE_SIZE = 64;
+
+struct IconRender
+{
+    int size;           // 0 for the scalable copy of an SVG
+    QString path;
+    bool ok = false;
+};
+
+bool isSvg(const QString &path)
+{
+    QString suffix = QFileInfo(path).suffix().toLower();
+    return suffix == "svg" || suffix == "svgz";
+}
+
+// Writes data unless the file already holds exactly that
+bool writeIfChanged(const QString &path, const QByteArray &data)
+{
+    QFile existing(path);
+    if (existing.size() == data.size() && existing.open(QIODevice::ReadOnly) && existing.readAll() == data) {
+        return true;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(data);
+    return file.commit();
+}
+
+void render(IconRender &item, const QString &sourceIcon, const QImage &raster)
+{
+    if (item.size == 0) {
+        QFile source(sourceIcon);
+        item.ok = source.open(QIODevice::ReadOnly) && writeIfChanged(item.path, source.readAll());
+        return;
+    }
+
+    QImage image;
+    if (raster.isNull()) {
+        // Each worker rasterises the SVG itself, straight at its size
+        QImageReader reader(sourceIcon);
+        reader.setScaledSize(QSize(item.size, item.size));
+        image = reader.read();
+    } else {
+        image = raster.scaled(item.size, item.size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    if (image.isNull()) {
+        return;
+    }
+
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    item.ok = image.save(&buffer, "PNG") && writeIfChanged(item.path, png);
+}
+
+} // namespace
+
+QString IconTheme::findSourceIcon(const QString &installDir, const QString &appName)
+{
+    QDir root(installDir);
+
+    for (const char *dirName : ICON_DIRS) {
+        QDir dir(root.filePath(QString::fromLatin1(dirName)));
+        QFileInfoList candidates = dir.entryInfoList(QStringList() << "*.svg" << "*.png", QDir::Files);
+
+        QString best;
+        int bestScore = -1;
+        foreach (const QFileInfo &info, candidates) {
+            int score;
+            if (isSvg(info.filePath())) {
+                score = 1 << 20;
+            } else {
+                QSize size = QImageReader(info.filePath()).size();
+                if (size.width() != size.height() || size.width() < MIN_SOURCE_SIZE) {
+                    continue;
+                }
+                score = size.width();
+            }
+
+            // Between equals, the file named after the app is the app icon
+            if (info.completeBaseName().compare(appName, Qt::CaseInsensitive) == 0) {
+                score++;
+            }
+
+            if (score > bestScore) {
+                bestScore = score;
+                best = info.filePath();
+            }
+        }
+
+        if (!best.isEmpty()) {
+            return best;
+        }
+    }
+
+    return QString();
+}
+
+QString IconTheme::themeRoot(bool system)
+{
+    if (system) {
+        return "/usr/share/icons/hicolor";
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/icons/hicolor";
+}
+
+QStringList IconTheme::install(const QString &sourceIcon, const QString &iconName, const QString &themeRoot)
+{
+    // Decoded once and shared read-only by the workers; SVGs are rasterised per size instead
+    QImage raster;
+    int maxSize = standardSizes().last();
+    if (!isSvg(sourceIcon)) {
+        QImageReader reader(sourceIcon);
+        reader.setAutoTransform(true);
+        raster = reader.read();
+        if (raster.isNull()) {
+            return QStringList();
+        }
+        maxSize = qMax(raster.width(), raster.height());
+    }
+
+    QVector<IconRender> renders;
+    foreach (int size, standardSizes()) {
+        // Upscaled raster icons look worse than the shell scaling a smaller one
+        if (size > maxSize) {
+            continue;
+        }
+        IconRender item;
+        item.size = size;
+        item.path = QString("%1/%2x%2/apps/%3.png").arg(themeRoot).arg(size).arg(iconName);
+        renders.append(item);
+    }
+    if (raster.isNull()) {
+        IconRender item;
+        item.size = 0;
+        item.path = themeRoot + "/scalable/apps/" + iconName + "." + QFileInfo(sourceIcon).suffix().toLower();
+        renders.append(item);
+    }
+
+    foreach (const IconRender &item, renders) {
+        QDir().mkpath(QFileInfo(item.path).path());
+    }
+
+    QtConcurrent::blockingMap(renders, [&sourceIcon, &raster](IconRender &item) {
+        render(item, sourceIcon, raster);
+    });
+
+    QStringList written;
+    foreach (const IconRender &item, renders) {
+        if (item.ok) {
+            written << item.path;
+        }
+    }
+    return written;
+}
+
+void IconTheme::refreshCache(const QString &themeRoot)
+{
+    // GTK compares the theme directory's mtime with its cache, and writing
+    // into NxN/apps does not change it
+    ::utimensat(AT_FDCWD, QFile::encodeName(themeRoot).constData(), nullptr, 0);
+
+    // A user theme without a cache is scanned directly; creating one would
+    // leave a cache that other tools do not know to update
+    QString cacheFile = themeRoot + "/icon-theme.cache";
+    bool system = themeRoot.startsWith("/usr/");
+    if (!system && !QFile::exists(cacheFile)) {
+        return;
+    }
+
+    QString tool = QStandardPaths::findExecutable("gtk-update-icon-cache");
+    if (!tool.isEmpty()) {
+        QProcess::execute(tool, QStringList() << "-f" << "-t" << "-q" << themeRoot);
+    }
+}
+
+const QVector<int> &IconTheme::standardSizes()
+{
+    static const QVector<int> sizes = { 16, 22, 24, 32, 48, 64, 128, 256, 512 };
+    return sizes;
+}
@@ -0,0 +1,34 @@
+#ifndef ICONTHEME_H
+#define ICONTHEME_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Installs application icons into the hicolor theme. Menus and docks look
+// icons up by name at a fixed size, so pre-rendering every standard size
+// spares them from scaling a 1024 px PNG on each paint.
+class IconTheme
+{
+public:
+    // Best icon shipped inside an installed tree: an SVG if there is one,
+    // otherwise the largest PNG among the usual Electron locations. Empty
+    // when the tree ships none.
+    static QString findSourceIcon(const QString &installDir, const QString &appName);
+
+    // hicolor under /usr/share/icons for system installs, otherwise under
+    // the user's data directory
+    static QString themeRoot(bool system);
+
+    // Renders iconName at every standard size no larger than the source, in
+    // parallel, plus the SVG itself under scalable/. Unchanged files are
+    // left alone. Returns the paths written or already up to date.
+    static QStringList install(const QString &sourceIcon, const QString &iconName, const QString &themeRoot);
+
+    // Lets running shells notice the new icons; call once per batch
+    static void refreshCache(const QString &themeRoot);
+
+    static const QVector<int> &standardSizes();
+};
+
+#endif // ICONTHEME_H
@@ -0,0 +1,309 @@
+#include "InstallJournal.h"
+#include "AppRegistry.h"
+#include "Checksum.h"
+#include "ArchiveIndex.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QVariant>
+#include <algorithm>
+#include <errno.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+namespace {
+
+const char *const SELECT_COLUMNS =
+    "SELECT id, source, install_path, phase, pid, archive_path, archive_sha256, archive_stamp, "
+    "staging_dir, exec_path, tree_digest, final_dir, backup_dir, updated_at FROM install_journal";
+
+bool processAlive(qint64 pid)
+{
+    // EPERM still means the process exists, it just belongs to someone else
+    return pid > 0 && (::kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM);
+}
+
+void removePath(const QString &path)
+{
+    if (QFileInfo(path).isDir()) {
+        QDir(path).removeRecursively();
+    } else {
+        QFile::remove(path);
+    }
+}
+
+} // namespace
+
+InstallJournal::InstallJournal(AppRegistry &registry)
+    : m_registry(registry)
+{
+}
+
+bool InstallJournal::begin(const QString &source, const QString &installPath, JournalEntry *entry)
+{
+    QSqlQuery &find = m_registry.prepared(QString(SELECT_COLUMNS) + " WHERE source = ? AND install_path = ?");
+    find.addBindValue(source);
+    find.addBindValue(installPath);
+
+    bool found = find.exec() && find.next();
+    JournalEntry existing = found ? readEntry(find) : JournalEntry();
+    find.finish();
+
+    qint64 pid = QCoreApplication::applicationPid();
+
+    if (found) {
+        if (existing.pid != pid && isOwnedByLiveProcess(existing)) {
+            return false;
+        }
+
+        existing.pid = pid;
+        *entry = existing;
+        return record(existing);
+    }
+
+    QString now = QDateTime::currentDateTime().toString(Qt::ISODate);
+    QSqlQuery &insert = m_registry.prepared("INSERT INTO install_journal "
+                                            "(source, install_path, phase, pid, started_at, updated_at) "
+                                            "VALUES (?, ?, ?, ?, ?, ?)");
+    insert.addBindValue(source);
+    insert.addBindValue(installPath);
+    insert.addBindValue(phaseToString(JournalEntry::Started));
+    insert.addBindValue(pid);
+    insert.addBindValue(now);
+    insert.addBindValue(now);
+
+    if (!insert.exec()) {
+        return false;
+    }
+
+    *entry = JournalEntry();
+    entry->id = insert.lastInsertId().toLongLong();
+    entry->source = source;
+    entry->installPath = installPath;
+    entry->pid = pid;
+    entry->updatedAt = now;
+    return true;
+}
+
+bool InstallJournal::record(const JournalEntry &entry)
+{
+    QSqlQuery &update = m_registry.prepared("UPDATE install_journal SET phase = ?, pid = ?, archive_path = ?, "
+                                            "archive_sha256 = ?, archive_stamp = ?, staging_dir = ?, exec_path = ?, "
+                                            "tree_digest = ?, final_dir = ?, backup_dir = ?, updated_at = ? "
+                                            "WHERE id = ?");
+    update.addBindValue(phaseToString(entry.phase));
+    update.addBindValue(entry.pid);
+    update.addBindValue(entry.archivePath);
+    update.addBindValue(QString::fromLatin1(entry.archiveSha256));
+    update.addBindValue(entry.archiveStamp);
+    update.addBindValue(entry.stagingDir);
+    update.addBindValue(entry.execPath);
+    update.addBindValue(QString::fromLatin1(entry.treeDigest));
+    update.addBindValue(entry.finalDir);
+    update.addBindValue(entry.backupDir);
+    update.addBindValue(QDateTime::currentDateTime().toString(Qt::ISODate));
+    update.addBindValue(entry.id);
+
+    return update.exec();
+}
+
+bool InstallJournal::finish(const JournalEntry &entry)
+{
+    QSqlQuery &remove = m_registry.prepared("DELETE FROM install_journal WHERE id = ?");
+    remove.addBindValue(entry.id);
+    return remove.exec();
+}
+
+int InstallJournal::sweep(const QString &tempRoot, const QString &downloadRoot)
+{
+    int reclaimed = 0;
+    QSet<QString> inUse;
+    QDateTime cutoff = QDateTime::currentDateTime().addDays(-MAX_AGE_DAYS);
+    QString downloadPrefix = QDir::cleanPath(downloadRoot) + "/";
+
+    foreach (JournalEntry entry, entries()) {
+        if (isOwnedByLiveProcess(entry)) {
+            inUse << entry.stagingDir << entry.archivePath << Checksum::sidecarPath(entry.archivePath)
+                  << ArchiveIndex::indexPathFor(entry.archivePath);
+            continue;
+        }
+
+        // Killed between moving the old tree aside and finishing the new one:
+        // the registry still describes the old tree, so that is what goes back
+        if (entry.phase == JournalEntry::Replacing) {
+            if (!entry.backupDir.isEmpty() && QFileInfo(entry.backupDir).isDir()) {
+                QDir(entry.finalDir).removeRecursively();
+                QDir().rename(entry.backupDir, entry.finalDir);
+                reclaimed++;
+            }
+            entry.phase = JournalEntry::Extracted;
+            record(entry);
+        }
+
+        // The new tree was complete, only deleting the old one was cut short
+        if (entry.phase == JournalEntry::Replaced && !entry.backupDir.isEmpty()
+            && QFileInfo(entry.backupDir).isDir()) {
+            QDir(entry.backupDir).removeRecursively();
+            reclaimed++;
+        }
+
+        bool downloaded = entry.archivePath.startsWith(downloadPrefix);
+        bool expired = QDateTime::fromString(entry.updatedAt, Qt::ISODate) < cutoff;
+        bool resumable = !expired
+                         && ((entry.phase == JournalEntry::Extracted && QFileInfo(entry.stagingDir).isDir())
+                             || (entry.phase == JournalEntry::Downloaded && QFileInfo(entry.archivePath).isFile()));
+
+        if (resumable) {
+            inUse << entry.stagingDir << entry.archivePath << Checksum::sidecarPath(entry.archivePath)
+                  << ArchiveIndex::indexPathFor(entry.archivePath);
+            continue;
+        }
+
+        if (!entry.stagingDir.isEmpty() && QFileInfo::exists(entry.stagingDir)) {
+            QDir(entry.stagingDir).removeRecursively();
+            reclaimed++;
+        }
+        // Never delete an archive the user pointed us at, only our own downloads
+        if (downloaded && QFileInfo::exists(entry.archivePath)) {
+            QFile::remove(entry.archivePath);
+            reclaimed++;
+        }
+        finish(entry);
+    }
+
+    // Staging dirs of runs that died before the journal knew about them
+    QDir temp(tempRoot);
+    foreach (const QString &name, temp.entryList(QStringList() << "vsc_installer_temp_*", QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QString path = temp.absoluteFilePath(name);
+        qint64 pid = name.section('_', -1).toLongLong();
+        if (!inUse.contains(path) && !processAlive(pid)) {
+            QDir(path).removeRecursively();
+            reclaimed++;
+        }
+    }
+
+    QDir downloads(downloadRoot);
+    foreach (const QString &name, downloads.entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden)) {
+        QString path = downloads.absoluteFilePath(name);
+        if (!inUse.contains(path)) {
+            removePath(path);
+            reclaimed++;
+        }
+    }
+
+    return reclaimed;
+}
+
+QByteArray InstallJournal::treeDigest(const QString &root)
+{
+    QStringList lines;
+
+    QDirIterator it(root, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QString path = it.next();
+
+        struct stat st;
+        if (::lstat(QFile::encodeName(path).constData(), &st) != 0) {
+            continue;
+        }
+
+        lines << QString("%1 %2 %3")
+            .arg(path.mid(root.size()))
+            .arg(S_ISREG(st.st_mode) ? qint64(st.st_size) : 0)
+            .arg(st.st_mode, 0, 8);
+    }
+
+    // Directory order is not stable across runs
+    std::sort(lines.begin(), lines.end());
+
+    return QCryptographicHash::hash(lines.join('\n').toUtf8(), QCryptographicHash::Sha256).toHex();
+}
+
+QString InstallJournal::archiveStamp(const QString &path)
+{
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0) {
+        return QString();
+    }
+
+    return QString("%1:%2.%3").arg(qint64(st.st_size)).arg(qint64(st.st_mtim.tv_sec)).arg(qint64(st.st_mtim.tv_nsec));
+}
+
+QString InstallJournal::phaseToString(JournalEntry::Phase phase)
+{
+    switch (phase) {
+    case JournalEntry::Downloaded:
+        return "downloaded";
+    case JournalEntry::Extracted:
+        return "extracted";
+    case JournalEntry::Replacing:
+        return "replacing";
+    case JournalEntry::Replaced:
+        return "replaced";
+    case JournalEntry::Started:
+    default:
+        return "started";
+    }
+}
+
+JournalEntry::Phase InstallJournal::phaseFromString(const QString &phase)
+{
+    if (phase == "downloaded") {
+        return JournalEntry::Downloaded;
+    } else if (phase == "extracted") {
+        return JournalEntry::Extracted;
+    } else if (phase == "replacing") {
+        return JournalEntry::Replacing;
+    } else if (phase == "replaced") {
+        return JournalEntry::Replaced;
+    }
+
+    return JournalEntry::Started;
+}
+
+bool InstallJournal::isOwnedByLiveProcess(const JournalEntry &entry) const
+{
+    // Our own entries are only live while an install is running, never at a sweep
+    return entry.pid != QCoreApplication::applicationPid() && processAlive(entry.pid);
+}
+
+QList<JournalEntry> InstallJournal::entries()
+{
+    QList<JournalEntry> result;
+
+    QSqlQuery &query = m_registry.prepared(SELECT_COLUMNS);
+    if (query.exec()) {
+        while (query.next()) {
+            result.append(readEntry(query));
+        }
+    }
+    query.finish();
+
+    return result;
+}
+
+JournalEntry InstallJournal::readEntry(const QSqlQuery &query)
+{
+    JournalEntry entry;
+    entry.id = query.value(0).toLongLong();
+    entry.source = query.value(1).toString();
+    entry.installPath = query.value(2).toString();
+    entry.phase = phaseFromString(query.value(3).toString());
+    entry.pid = query.value(4).toLongLong();
+    entry.archivePath = query.value(5).toString();
+    entry.archiveSha256 = query.value(6).toString().toLatin1();
+    entry.archiveStamp = query.value(7).toString();
+    entry.stagingDir = query.value(8).toString();
+    entry.execPath = query.value(9).toString();
+    entry.treeDigest = query.value(10).toString().toLatin1();
+    entry.finalDir = query.value(11).toString();
+    entry.backupDir = query.value(12).toString();
+    entry.updatedAt = query.value(13).toString();
+    return entry;
+}
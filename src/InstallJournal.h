@@ -0,0 +1,79 @@
+#ifndef INSTALLJOURNAL_H
+#define INSTALLJOURNAL_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+
+class AppRegistry;
+class QSqlQuery;
+
+// Progress of one install, written after each phase completes
+struct JournalEntry
+{
+    enum Phase {
+        Started,
+        Downloaded,  // archivePath holds the verified download
+        Extracted,   // stagingDir holds the verified, extracted tree
+        Replacing,   // finalDir is being swapped, the old tree is at backupDir
+        Replaced     // finalDir holds the new tree
+    };
+
+    qint64 id = -1;
+    QString source;       // URL or archive path, as given by the user
+    QString installPath;
+    Phase phase = Started;
+    qint64 pid = 0;       // Process that wrote the entry last
+
+    QString archivePath;
+    QByteArray archiveSha256;
+    QString archiveStamp;  // Size and mtime, to notice a replaced local archive
+
+    QString stagingDir;
+    QString execPath;
+    QByteArray treeDigest;  // Paths, sizes and modes of the extracted tree
+
+    QString finalDir;
+    QString backupDir;
+
+    QString updatedAt;
+};
+
+// Persistent journal of installs in progress, so that a crashed or killed
+// install can be resumed from its last completed phase and its leftovers
+// found and reclaimed.
+class InstallJournal
+{
+public:
+    explicit InstallJournal(AppRegistry &registry);
+
+    // Entry left for source/installPath by an earlier run, or a new one.
+    // Fails if another live process owns it.
+    bool begin(const QString &source, const QString &installPath, JournalEntry *entry);
+    bool record(const JournalEntry &entry);
+    bool finish(const JournalEntry &entry);
+
+    // Rolls back replacements interrupted half way, then removes staging
+    // dirs and downloads that no resumable entry refers to. Returns the
+    // number of paths reclaimed.
+    int sweep(const QString &tempRoot, const QString &downloadRoot);
+
+    // Cheap fingerprint of a tree, from lstat() only
+    static QByteArray treeDigest(const QString &root);
+    static QString archiveStamp(const QString &path);
+
+    static QString phaseToString(JournalEntry::Phase phase);
+    static JournalEntry::Phase phaseFromString(const QString &phase);
+
+    // Entries untouched for this long are abandoned along with their files
+    static const int MAX_AGE_DAYS = 7;
+
+private:
+    bool isOwnedByLiveProcess(const JournalEntry &entry) const;
+    QList<JournalEntry> entries();
+    static JournalEntry readEntry(const QSqlQuery &query);
+
+    AppRegistry &m_registry;
+};
+
+#endif // INSTALLJOURNAL_H
@@ -0,0 +1,227 @@
+#include "InstallManifest.h"
+#include <QDirIterator>
+#include <QFile>
+#include <QCryptographicHash>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+static bool lstatPath(const QString &path, struct stat *st)
+{
+    return ::lstat(QFile::encodeName(path).constData(), st) == 0;
+}
+
+static qint64 toNanoseconds(const struct timespec &ts)
+{
+    return qint64(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+static void fillFromStat(ManifestEntry *entry, const struct stat &st)
+{
+    entry->mode = st.st_mode;
+    entry->size = S_ISREG(st.st_mode) ? qint64(st.st_size) : 0;
+    entry->mtime = toNanoseconds(st.st_mtim);
+    entry->ctime = toNanoseconds(st.st_ctim);
+}
+
+QVector<ManifestEntry> InstallManifest::scanTree(const QString &rootPath, const ExtractedFiles &extracted)
+{
+    QVector<ManifestEntry> entries;
+    const int prefixLength = rootPath.size() + 1;
+
+    QDirIterator it(rootPath,
+                    QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QString path = it.next();
+
+        struct stat st;
+        if (!lstatPath(path, &st)) {
+            continue;
+        }
+
+        ManifestEntry entry;
+        entry.path = path;
+        fillFromStat(&entry, st);
+
+        if (S_ISLNK(st.st_mode)) {
+            entry.kind = ManifestEntry::Symlink;
+        } else if (S_ISDIR(st.st_mode)) {
+            entry.kind = ManifestEntry::Directory;
+        } else {
+            entry.kind = ManifestEntry::File;
+
+            auto known = extracted.constFind(path.mid(prefixLength));
+            if (known != extracted.constEnd() && known->size == entry.size && known->mtime == entry.mtime) {
+                entry.hash = known->hash;
+            }
+        }
+
+        entries.append(entry);
+    }
+
+    // The root directory itself is part of the install
+    ManifestEntry root = externalEntry(rootPath, ManifestEntry::Directory);
+    entries.append(root);
+
+    // Hashing dominates the cost of a scan, spread it over the thread pool
+    QtConcurrent::blockingMap(entries, [](ManifestEntry &entry) {
+        if (entry.kind == ManifestEntry::File && entry.hash.isEmpty()) {
+            entry.hash = hashFile(entry.path);
+        }
+    });
+
+    return entries;
+}
+
+ExtractedFiles InstallManifest::rebase(const ExtractedFiles &extracted, const QString &subdir)
+{
+    if (subdir.isEmpty() || subdir == ".") {
+        return extracted;
+    }
+
+    const QString prefix = subdir + "/";
+    ExtractedFiles rebased;
+    for (auto it = extracted.constBegin(); it != extracted.constEnd(); ++it) {
+        if (it.key().startsWith(prefix)) {
+            rebased.insert(it.key().mid(prefix.size()), it.value());
+        }
+    }
+    return rebased;
+}
+
+ManifestEntry InstallManifest::externalEntry(const QString &path, ManifestEntry::Kind kind)
+{
+    ManifestEntry entry;
+    entry.path = path;
+    entry.kind = kind;
+
+    if (statEntry(path, &entry) && S_ISREG(entry.mode)) {
+        entry.hash = hashFile(path);
+    }
+
+    return entry;
+}
+
+bool InstallManifest::statEntry(const QString &path, ManifestEntry *entry)
+{
+    struct stat st;
+    if (!lstatPath(path, &st)) {
+        return false;
+    }
+
+    fillFromStat(entry, st);
+    return true;
+}
+
+int InstallManifest::removeEntries(const QVector<ManifestEntry> &entries)
+{
+    QVector<ManifestEntry> leaves;
+    QStringList directories;
+
+    foreach (const ManifestEntry &entry, entries) {
+        if (entry.kind == ManifestEntry::Directory) {
+            directories << entry.path;
+        } else {
+            leaves.append(entry);
+        }
+    }
+
+    std::atomic<int> failures(0);
+
+    QtConcurrent::blockingMap(leaves, [&failures](const ManifestEntry &entry) {
+        QByteArray path = QFile::encodeName(entry.path);
+
+        // Never follow a /usr/local/bin link that has since been replaced by a real file
+        if (entry.kind == ManifestEntry::BinLink) {
+            struct stat st;
+            if (::lstat(path.constData(), &st) != 0 || !S_ISLNK(st.st_mode)) {
+                return;
+            }
+        }
+
+        if (::unlink(path.constData()) != 0 && errno != ENOENT) {
+            failures++;
+        }
+    });
+
+    // Children have longer paths than their parents
+    std::sort(directories.begin(), directories.end(), [](const QString &a, const QString &b) {
+        return a.size() > b.size();
+    });
+
+    foreach (const QString &dir, directories) {
+        if (::rmdir(QFile::encodeName(dir).constData()) != 0 && errno != ENOENT) {
+            failures++;
+        }
+    }
+
+    return failures.load();
+}
+
+QByteArray InstallManifest::hashFile(const QString &path)
+{
+    // O_NOATIME so that hashing does not look like use to the warmup profile;
+    // the kernel refuses it on files we do not own
+    QByteArray encoded = QFile::encodeName(path);
+    int fd = ::open(encoded.constData(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+    if (fd < 0) {
+        fd = ::open(encoded.constData(), O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        return QByteArray();
+    }
+
+    QFile file;
+    if (!file.open(fd, QIODevice::ReadOnly, QFileDevice::AutoCloseHandle)) {
+        ::close(fd);
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!hash.addData(&file)) {
+        return QByteArray();
+    }
+
+    return hash.result().toHex();
+}
+
+QString InstallManifest::kindToString(ManifestEntry::Kind kind)
+{
+    switch (kind) {
+    case ManifestEntry::Directory:
+        return "dir";
+    case ManifestEntry::Symlink:
+        return "symlink";
+    case ManifestEntry::BinLink:
+        return "bin-link";
+    case ManifestEntry::DesktopEntry:
+        return "desktop";
+    case ManifestEntry::ThemeIcon:
+        return "icon";
+    case ManifestEntry::File:
+    default:
+        return "file";
+    }
+}
+
+ManifestEntry::Kind InstallManifest::kindFromString(const QString &kind)
+{
+    if (kind == "dir") {
+        return ManifestEntry::Directory;
+    } else if (kind == "symlink") {
+        return ManifestEntry::Symlink;
+    } else if (kind == "bin-link") {
+        return ManifestEntry::BinLink;
+    } else if (kind == "desktop") {
+        return ManifestEntry::DesktopEntry;
+    } else if (kind == "icon") {
+        return ManifestEntry::ThemeIcon;
+    }
+
+    return ManifestEntry::File;
+}
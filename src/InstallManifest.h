@@ -0,0 +1,73 @@
+#ifndef INSTALLMANIFEST_H
+#define INSTALLMANIFEST_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+struct ManifestEntry
+{
+    enum Kind {
+        File,
+        Directory,
+        Symlink,
+        BinLink,      // Symlink written to /usr/local/bin
+        DesktopEntry, // .desktop file written outside the install tree
+        ThemeIcon     // Icon rendered into the hicolor theme
+    };
+
+    QString path;     // Absolute path
+    qint64 size = 0;
+    uint mode = 0;    // st_mode as returned by lstat()
+    QByteArray hash;  // Hex SHA-256, only for regular files
+    Kind kind = File;
+
+    // lstat() times (ns) when hash was last known good; lets verification
+    // skip files that have not been touched since
+    qint64 mtime = 0;
+    qint64 ctime = 0;
+};
+
+// A regular file as extraction wrote it, hashed from the archive on the way
+struct ExtractedFile
+{
+    QByteArray hash;  // Hex SHA-256
+    qint64 size = 0;
+    qint64 mtime = 0; // ns, as set on the file
+};
+
+// Files written by an in-process extraction, by path relative to its root
+typedef QHash<QString, ExtractedFile> ExtractedFiles;
+
+class InstallManifest
+{
+public:
+    // Walks an installed tree (without following symlinks) and hashes every
+    // regular file in parallel. Files listed in extracted, by path relative
+    // to rootPath, keep their hash instead of being read again as long as
+    // their size and mtime still match.
+    static QVector<ManifestEntry> scanTree(const QString &rootPath,
+                                           const ExtractedFiles &extracted = ExtractedFiles());
+
+    // Keeps the files below subdir, relative to it instead, for when only
+    // that part of an extracted tree is installed
+    static ExtractedFiles rebase(const ExtractedFiles &extracted, const QString &subdir);
+
+    // Describes a single file written outside the install tree
+    static ManifestEntry externalEntry(const QString &path, ManifestEntry::Kind kind);
+
+    // Unlinks files in parallel, then removes directories deepest first.
+    // Returns the number of entries that could not be removed.
+    static int removeEntries(const QVector<ManifestEntry> &entries);
+
+    static QByteArray hashFile(const QString &path);
+
+    // Fills mode, size and times from lstat(); returns false if path is gone
+    static bool statEntry(const QString &path, ManifestEntry *entry);
+
+    static QString kindToString(ManifestEntry::Kind kind);
+    static ManifestEntry::Kind kindFromString(const QString &kind);
+};
+
+#endif // INSTALLMANIFEST_H
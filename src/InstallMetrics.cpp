@@ -0,0 +1,246 @@
+#include "InstallMetrics.h"
+#include "AppRegistry.h"
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSet>
+#include <QVariant>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+QString label(const QString &value)
+{
+    QString escaped = value;
+    escaped.replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n");
+    return "\"" + escaped + "\"";
+}
+
+QString number(double value)
+{
+    return QString::number(value, 'g', 10);
+}
+
+} // namespace
+
+double InstallMetric::extractBytesPerSecond() const
+{
+    qint64 extractNs = phaseNs.value("extract");
+    return extractNs > 0 ? installedBytes / (extractNs / 1e9) : 0;
+}
+
+InstallMetrics::InstallMetrics(AppRegistry &registry)
+    : m_registry(registry)
+{
+}
+
+bool InstallMetrics::record(const InstallMetric &metric)
+{
+    QJsonObject phases;
+    for (auto it = metric.phaseNs.constBegin(); it != metric.phaseNs.constEnd(); ++it) {
+        phases[it.key()] = double(it.value());
+    }
+
+    if (!m_registry.beginTransaction()) {
+        return false;
+    }
+
+    QSqlQuery &insert = m_registry.prepared("INSERT INTO install_metrics "
+                                            "(app_name, version, kind, source, cache_hit, resumed, success, "
+                                            "archive_bytes, download_bytes, installed_bytes, installed_files, "
+                                            "extract_bytes_per_second, phases, recorded_at) "
+                                            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    insert.addBindValue(metric.appName);
+    insert.addBindValue(metric.version);
+    insert.addBindValue(metric.kind);
+    insert.addBindValue(metric.source);
+    insert.addBindValue(metric.cacheHit ? 1 : 0);
+    insert.addBindValue(metric.resumed ? 1 : 0);
+    insert.addBindValue(metric.success ? 1 : 0);
+    insert.addBindValue(metric.archiveBytes);
+    insert.addBindValue(metric.downloadBytes);
+    insert.addBindValue(metric.installedBytes);
+    insert.addBindValue(metric.installedFiles);
+    insert.addBindValue(metric.extractBytesPerSecond());
+    insert.addBindValue(QString::fromUtf8(QJsonDocument(phases).toJson(QJsonDocument::Compact)));
+    insert.addBindValue(QDateTime::currentDateTime().toString(Qt::ISODate));
+
+    if (!insert.exec()) {
+        m_registry.rollback();
+        return false;
+    }
+
+    QSqlQuery &prune = m_registry.prepared("DELETE FROM install_metrics WHERE app_name = ? AND id NOT IN "
+                                           "(SELECT id FROM install_metrics WHERE app_name = ? "
+                                           "ORDER BY id DESC LIMIT ?)");
+    prune.addBindValue(metric.appName);
+    prune.addBindValue(metric.appName);
+    prune.addBindValue(HISTORY_PER_APP);
+    if (!prune.exec()) {
+        m_registry.rollback();
+        return false;
+    }
+
+    return m_registry.commit();
+}
+
+QVector<InstallMetric> InstallMetrics::history(const QStringList &appNames)
+{
+    QSet<QString> wanted = appNames.toSet();
+    QVector<InstallMetric> metrics;
+
+    QSqlQuery &query = m_registry.prepared("SELECT app_name, version, kind, source, cache_hit, resumed, success, "
+                                           "archive_bytes, download_bytes, installed_bytes, installed_files, "
+                                           "phases, recorded_at FROM install_metrics ORDER BY id DESC");
+    if (query.exec()) {
+        while (query.next()) {
+            InstallMetric metric;
+            metric.appName = query.value(0).toString();
+            if (!wanted.isEmpty() && !wanted.contains(metric.appName)) {
+                continue;
+            }
+            metric.version = query.value(1).toString();
+            metric.kind = query.value(2).toString();
+            metric.source = query.value(3).toString();
+            metric.cacheHit = query.value(4).toBool();
+            metric.resumed = query.value(5).toBool();
+            metric.success = query.value(6).toBool();
+            metric.archiveBytes = query.value(7).toLongLong();
+            metric.downloadBytes = query.value(8).toLongLong();
+            metric.installedBytes = query.value(9).toLongLong();
+            metric.installedFiles = query.value(10).toInt();
+            metric.recordedAt = query.value(12).toString();
+
+            QJsonObject phases = QJsonDocument::fromJson(query.value(11).toString().toUtf8()).object();
+            for (auto it = phases.constBegin(); it != phases.constEnd(); ++it) {
+                metric.phaseNs[it.key()] = qint64(it.value().toDouble());
+            }
+            metrics.append(metric);
+        }
+    }
+    query.finish();
+
+    return metrics;
+}
+
+QVector<PhaseStats> InstallMetrics::phaseStats(const QStringList &appNames)
+{
+    // Failed installs stop half way; their phases would skew the picture
+    QMap<QString, QMap<QString, QVector<double>>> durations;
+    foreach (const InstallMetric &metric, history(appNames)) {
+        if (!metric.success) {
+            continue;
+        }
+        for (auto it = metric.phaseNs.constBegin(); it != metric.phaseNs.constEnd(); ++it) {
+            durations[metric.appName][it.key()].append(it.value() / 1e9);
+        }
+    }
+
+    QVector<PhaseStats> stats;
+    for (auto app = durations.constBegin(); app != durations.constEnd(); ++app) {
+        for (auto phase = app.value().constBegin(); phase != app.value().constEnd(); ++phase) {
+            QVector<double> sorted = phase.value();
+            std::sort(sorted.begin(), sorted.end());
+
+            PhaseStats entry;
+            entry.appName = app.key();
+            entry.phase = phase.key();
+            entry.count = sorted.size();
+            entry.p50 = percentile(sorted, 0.50);
+            entry.p90 = percentile(sorted, 0.90);
+            entry.p99 = percentile(sorted, 0.99);
+            entry.sum = std::accumulate(sorted.constBegin(), sorted.constEnd(), 0.0);
+            stats.append(entry);
+        }
+    }
+
+    return stats;
+}
+
+QString InstallMetrics::prometheusText(const QStringList &appNames)
+{
+    QString text;
+
+    text += "# HELP vscip_install_phase_seconds Duration of each install phase.\n";
+    text += "# TYPE vscip_install_phase_seconds summary\n";
+    foreach (const PhaseStats &stats, phaseStats(appNames)) {
+        QString labels = "app=" + label(stats.appName) + ",phase=" + label(stats.phase);
+        text += "vscip_install_phase_seconds{" + labels + ",quantile=\"0.5\"} " + number(stats.p50) + "\n";
+        text += "vscip_install_phase_seconds{" + labels + ",quantile=\"0.9\"} " + number(stats.p90) + "\n";
+        text += "vscip_install_phase_seconds{" + labels + ",quantile=\"0.99\"} " + number(stats.p99) + "\n";
+        text += "vscip_install_phase_seconds_sum{" + labels + "} " + number(stats.sum) + "\n";
+        text += "vscip_install_phase_seconds_count{" + labels + "} " + QString::number(stats.count) + "\n";
+    }
+
+    QSet<QString> apps;
+    QMap<QString, int> succeeded;
+    QMap<QString, int> failed;
+    QMap<QString, int> cacheHits;
+    QMap<QString, double> lastThroughput;
+    QMap<QString, qint64> lastTimestamp;
+    foreach (const InstallMetric &metric, history(appNames)) {
+        apps.insert(metric.appName);
+        (metric.success ? succeeded : failed)[metric.appName]++;
+        if (metric.cacheHit) {
+            cacheHits[metric.appName]++;
+        }
+        // History is newest first
+        if (metric.success && !lastTimestamp.contains(metric.appName)) {
+            lastThroughput[metric.appName] = metric.extractBytesPerSecond();
+            lastTimestamp[metric.appName] = QDateTime::fromString(metric.recordedAt, Qt::ISODate).toSecsSinceEpoch();
+        }
+    }
+
+    QStringList appList = apps.values();
+    appList.sort();
+
+    text += "# HELP vscip_installs_total Installs recorded in the retained history, by result.\n";
+    text += "# TYPE vscip_installs_total gauge\n";
+    foreach (const QString &app, appList) {
+        text += "vscip_installs_total{app=" + label(app) + ",result=\"success\"} " + QString::number(succeeded.value(app)) + "\n";
+        text += "vscip_installs_total{app=" + label(app) + ",result=\"failure\"} " + QString::number(failed.value(app)) + "\n";
+    }
+
+    text += "# HELP vscip_install_cache_hits Installs in the retained history served from the archive cache.\n";
+    text += "# TYPE vscip_install_cache_hits gauge\n";
+    foreach (const QString &app, appList) {
+        text += "vscip_install_cache_hits{app=" + label(app) + "} " + QString::number(cacheHits.value(app)) + "\n";
+    }
+
+    text += "# HELP vscip_install_extract_bytes_per_second Extraction throughput of the last successful install.\n";
+    text += "# TYPE vscip_install_extract_bytes_per_second gauge\n";
+    foreach (const QString &app, lastThroughput.keys()) {
+        text += "vscip_install_extract_bytes_per_second{app=" + label(app) + "} " + number(lastThroughput.value(app)) + "\n";
+    }
+
+    text += "# HELP vscip_install_last_success_timestamp_seconds Time of the last successful install.\n";
+    text += "# TYPE vscip_install_last_success_timestamp_seconds gauge\n";
+    foreach (const QString &app, lastTimestamp.keys()) {
+        text += "vscip_install_last_success_timestamp_seconds{app=" + label(app) + "} " + QString::number(lastTimestamp.value(app)) + "\n";
+    }
+
+    return text;
+}
+
+bool InstallMetrics::writePrometheus(const QString &path, const QStringList &appNames)
+{
+    // The collector may read at any moment; it must never see half a file
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(prometheusText(appNames).toUtf8());
+    return file.commit();
+}
+
+double InstallMetrics::percentile(const QVector<double> &sorted, double fraction)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    int rank = int(std::ceil(fraction * sorted.size()));
+    return sorted.at(qBound(0, rank - 1, sorted.size() - 1));
+}
@@ -0,0 +1,70 @@
+#ifndef INSTALLMETRICS_H
+#define INSTALLMETRICS_H
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class AppRegistry;
+
+// What one install or update cost
+struct InstallMetric
+{
+    QString appName;
+    QString version;
+    QString kind = "install";      // "install", "update" or "staged"
+    QString source = "local";      // "local" or "url"
+    bool cacheHit = false;         // Extracted from the archive cache
+    bool resumed = false;          // Reused the extraction of an interrupted run
+    bool success = false;
+    qint64 archiveBytes = 0;
+    qint64 downloadBytes = 0;
+    qint64 installedBytes = 0;
+    int installedFiles = 0;
+    QMap<QString, qint64> phaseNs; // Span name to nanoseconds, see Trace
+    QString recordedAt;
+
+    // Installed bytes per second of extraction, 0 when nothing was extracted
+    double extractBytesPerSecond() const;
+};
+
+// Distribution of one phase's duration over an app's history
+struct PhaseStats
+{
+    QString appName;
+    QString phase;
+    int count = 0;
+    double p50 = 0;   // Seconds
+    double p90 = 0;
+    double p99 = 0;
+    double sum = 0;
+};
+
+// History of install performance, kept next to the registry so slow
+// installs can be told apart from a slowly degrading fleet.
+class InstallMetrics
+{
+public:
+    explicit InstallMetrics(AppRegistry &registry);
+
+    bool record(const InstallMetric &metric);
+    // Newest first; every app when appNames is empty
+    QVector<InstallMetric> history(const QStringList &appNames = QStringList());
+    QVector<PhaseStats> phaseStats(const QStringList &appNames = QStringList());
+
+    // Prometheus text exposition format, for node_exporter's textfile collector
+    QString prometheusText(const QStringList &appNames = QStringList());
+    bool writePrometheus(const QString &path, const QStringList &appNames = QStringList());
+
+    // Nearest-rank percentile of ascending values
+    static double percentile(const QVector<double> &sorted, double fraction);
+
+    // Installs remembered per app
+    static const int HISTORY_PER_APP = 200;
+
+private:
+    AppRegistry &m_registry;
+};
+
+#endif // INSTALLMETRICS_H
@@ -0,0 +1,142 @@
+#include "InstallVerifier.h"
+#include <QtConcurrent>
+#include <sys/stat.h>
+
+namespace {
+
+struct WorkItem
+{
+    int app;
+    ManifestEntry expected;
+    ManifestEntry current;
+    bool exists = false;
+    bool hashed = false;
+    bool hasIssue = false;
+    VerifyIssue::Problem problem = VerifyIssue::Missing;
+};
+
+bool sameType(const ManifestEntry &expected, uint mode)
+{
+    switch (expected.kind) {
+    case ManifestEntry::Directory:
+        return S_ISDIR(mode);
+    case ManifestEntry::Symlink:
+    case ManifestEntry::BinLink:
+        return S_ISLNK(mode);
+    case ManifestEntry::File:
+    case ManifestEntry::DesktopEntry:
+    case ManifestEntry::ThemeIcon:
+    default:
+        return S_ISREG(mode);
+    }
+}
+
+void checkItem(WorkItem &item, bool full)
+{
+    const ManifestEntry &expected = item.expected;
+
+    item.current.path = expected.path;
+    item.current.kind = expected.kind;
+    item.current.hash = expected.hash;
+    item.exists = InstallManifest::statEntry(expected.path, &item.current);
+
+    if (!item.exists) {
+        item.hasIssue = true;
+        item.problem = VerifyIssue::Missing;
+        return;
+    }
+
+    if (!sameType(expected, item.current.mode)) {
+        item.hasIssue = true;
+        item.problem = VerifyIssue::TypeChanged;
+        return;
+    }
+
+    // Manifests written before modes were tracked have mode 0
+    if (expected.mode != 0 && (expected.mode & 07777) != (item.current.mode & 07777)) {
+        item.hasIssue = true;
+        item.problem = VerifyIssue::ModeChanged;
+        return;
+    }
+
+    if (!S_ISREG(item.current.mode) || expected.hash.isEmpty()) {
+        return;
+    }
+
+    // ctime cannot be set from userspace, so an unchanged ctime means the
+    // content has not been rewritten since it was last hashed
+    if (!full
+        && item.current.size == expected.size
+        && item.current.mtime == expected.mtime
+        && item.current.ctime == expected.ctime) {
+        return;
+    }
+
+    item.hashed = true;
+    if (item.current.size != expected.size
+        || InstallManifest::hashFile(expected.path) != expected.hash) {
+        item.hasIssue = true;
+        item.problem = VerifyIssue::Modified;
+    }
+}
+
+} // namespace
+
+QVector<VerifyResult> InstallVerifier::verify(const QMap<QString, QVector<ManifestEntry>> &manifests,
+                                              bool full)
+{
+    QVector<VerifyResult> results;
+    QVector<WorkItem> work;
+
+    for (auto it = manifests.constBegin(); it != manifests.constEnd(); ++it) {
+        VerifyResult result;
+        result.appName = it.key();
+        results.append(result);
+
+        foreach (const ManifestEntry &entry, it.value()) {
+            WorkItem item;
+            item.app = results.size() - 1;
+            item.expected = entry;
+            work.append(item);
+        }
+    }
+
+    QtConcurrent::blockingMap(work, [full](WorkItem &item) {
+        checkItem(item, full);
+    });
+
+    foreach (const WorkItem &item, work) {
+        VerifyResult &result = results[item.app];
+        result.checked++;
+
+        if (item.hashed) {
+            result.hashed++;
+        }
+
+        if (item.hasIssue) {
+            VerifyIssue issue;
+            issue.path = item.expected.path;
+            issue.problem = item.problem;
+            result.issues.append(issue);
+        } else if (item.hashed) {
+            result.refreshed.append(item.current);
+        }
+    }
+
+    return results;
+}
+
+QString InstallVerifier::problemToString(VerifyIssue::Problem problem)
+{
+    switch (problem) {
+    case VerifyIssue::Missing:
+        return "falta";
+    case VerifyIssue::Modified:
+        return "modificado";
+    case VerifyIssue::TypeChanged:
+        return "tipo cambiado";
+    case VerifyIssue::ModeChanged:
+        return "permisos cambiados";
+    }
+    return QString();
+}
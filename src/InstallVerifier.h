@@ -0,0 +1,47 @@
+#ifndef INSTALLVERIFIER_H
+#define INSTALLVERIFIER_H
+
+#include <QString>
+#include <QMap>
+#include <QVector>
+#include "InstallManifest.h"
+
+struct VerifyIssue
+{
+    enum Problem {
+        Missing,
+        Modified,     // Content hash differs from the manifest
+        TypeChanged,  // e.g. a file replaced by a symlink
+        ModeChanged
+    };
+
+    QString path;
+    Problem problem;
+};
+
+struct VerifyResult
+{
+    QString appName;
+    int checked = 0;
+    int hashed = 0;   // Files whose content had to be re-read
+    QVector<VerifyIssue> issues;
+    // Entries re-hashed and found intact, with their current times
+    QVector<ManifestEntry> refreshed;
+
+    bool isClean() const { return issues.isEmpty(); }
+};
+
+class InstallVerifier
+{
+public:
+    // Checks every manifest against the filesystem. All apps are verified as
+    // a single work list so the thread pool stays busy across small and large
+    // installs. Unless full is set, files whose size, mtime and ctime match the
+    // last verified state are trusted without reading them.
+    static QVector<VerifyResult> verify(const QMap<QString, QVector<ManifestEntry>> &manifests,
+                                        bool full = false);
+
+    static QString problemToString(VerifyIssue::Problem problem);
+};
+
+#endif // INSTALLVERIFIER_H
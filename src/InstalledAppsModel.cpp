@@ -0,0 +1,244 @@
+#include "InstalledAppsModel.h"
+#include "Installer.h"
+#include "DiskPreflight.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QSet>
+#include <QtConcurrent>
+#include <sys/stat.h>
+
+namespace {
+
+struct UsageJob
+{
+    int row;
+    QString installPath;
+    qint64 cachedBytes;
+    qint64 cachedStamp;
+};
+
+qint64 mtimeNs(const struct stat &st)
+{
+    return qint64(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+DiskUsageResult measure(const UsageJob &job)
+{
+    DiskUsageResult result;
+    result.row = job.row;
+    result.stamp = InstalledAppsModel::treeStamp(job.installPath);
+
+    if (result.stamp != 0 && result.stamp == job.cachedStamp && job.cachedBytes >= 0) {
+        result.bytes = job.cachedBytes;
+        result.fromCache = true;
+        return result;
+    }
+
+    result.bytes = InstalledAppsModel::measureDiskUsage(job.installPath);
+    return result;
+}
+
+} // namespace
+
+InstalledAppsModel::InstalledAppsModel(Installer *installer, QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_installer(installer)
+{
+    connect(&m_usageWatcher, &QFutureWatcher<DiskUsageResult>::resultReadyAt,
+            this, &InstalledAppsModel::onUsageReady);
+
+    reload();
+}
+
+InstalledAppsModel::~InstalledAppsModel()
+{
+    stopMeasuring();
+}
+
+int InstalledAppsModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_apps.size();
+}
+
+int InstalledAppsModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant InstalledAppsModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_apps.size()) {
+        return QVariant();
+    }
+
+    const InstalledAppStatus &app = m_apps.at(index.row());
+
+    if (role == Qt::TextAlignmentRole && index.column() == SizeColumn) {
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+    }
+
+    if (role == SortRole && index.column() == SizeColumn) {
+        return app.diskUsage;
+    }
+
+    if (role == Qt::ToolTipRole && index.column() == SizeColumn && !m_measured.at(index.row())) {
+        return "Comprobando si la instalación cambió...";
+    }
+
+    if (role != Qt::DisplayRole && role != SortRole) {
+        return QVariant();
+    }
+
+    switch (index.column()) {
+    case NameColumn:
+        return app.record.appName;
+    case VersionColumn:
+        return app.record.version.isEmpty() ? "Desconocida" : app.record.version;
+    case PathColumn:
+        return app.record.installPath;
+    case SizeColumn:
+        if (app.diskUsage < 0) {
+            return "Calculando...";
+        }
+        return DiskPreflight::formatBytes(app.diskUsage);
+    case VerifiedColumn:
+        if (app.lastVerified.isEmpty()) {
+            return "Nunca";
+        }
+        return QDateTime::fromString(app.lastVerified, Qt::ISODate).toString("yyyy-MM-dd HH:mm");
+    case UpdateColumn:
+        if (!app.stagedVersion.isEmpty()) {
+            return "Preparada: " + app.stagedVersion;
+        } else if (app.record.updateAvailable) {
+            return "Disponible";
+        } else if (app.record.sourceUrl.isEmpty()) {
+            return "Instalación local";
+        }
+        return "Al día";
+    default:
+        return QVariant();
+    }
+}
+
+QVariant InstalledAppsModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section) {
+    case NameColumn:
+        return "Aplicación";
+    case VersionColumn:
+        return "Versión";
+    case PathColumn:
+        return "Ruta";
+    case SizeColumn:
+        return "Tamaño en disco";
+    case VerifiedColumn:
+        return "Última verificación";
+    case UpdateColumn:
+        return "Actualización";
+    default:
+        return QVariant();
+    }
+}
+
+void InstalledAppsModel::reload()
+{
+    stopMeasuring();
+
+    beginResetModel();
+    m_apps = m_installer->installedAppStatus();
+    m_measured = QVector<bool>(m_apps.size(), false);
+    endResetModel();
+
+    QVector<UsageJob> jobs;
+    for (int row = 0; row < m_apps.size(); ++row) {
+        const InstalledAppStatus &app = m_apps.at(row);
+        jobs.append(UsageJob{ row, app.record.installPath, app.diskUsage, app.diskUsageStamp });
+    }
+
+    // One task per app; unchanged trees only cost a few stat() calls
+    m_usageWatcher.setFuture(QtConcurrent::mapped(jobs, measure));
+}
+
+qint64 InstalledAppsModel::measureDiskUsage(const QString &dir)
+{
+    struct stat st;
+    if (::lstat(QFile::encodeName(dir).constData(), &st) != 0) {
+        return 0;
+    }
+    qint64 bytes = qint64(st.st_blocks) * 512;
+
+    // Files shared through the dedup store are hard links; count their blocks once
+    QSet<QPair<quint64, quint64>> seen;
+    QDirIterator it(dir, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (::lstat(QFile::encodeName(it.next()).constData(), &st) != 0) {
+            continue;
+        }
+        if (st.st_nlink > 1 && !S_ISDIR(st.st_mode)) {
+            QPair<quint64, quint64> inode(quint64(st.st_dev), quint64(st.st_ino));
+            if (seen.contains(inode)) {
+                continue;
+            }
+            seen.insert(inode);
+        }
+        bytes += qint64(st.st_blocks) * 512;
+    }
+
+    return bytes;
+}
+
+qint64 InstalledAppsModel::treeStamp(const QString &dir)
+{
+    struct stat st;
+    if (::lstat(QFile::encodeName(dir).constData(), &st) != 0) {
+        return 0;
+    }
+    qint64 stamp = mtimeNs(st);
+
+    // Adding, removing or renaming an entry anywhere moves its directory's
+    // mtime, so directories are all that needs a stat()
+    QDirIterator it(dir, QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System | QDir::NoSymLinks,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (::lstat(QFile::encodeName(it.next()).constData(), &st) == 0) {
+            stamp = qMax(stamp, mtimeNs(st));
+        }
+    }
+
+    return stamp;
+}
+
+void InstalledAppsModel::onUsageReady(int index)
+{
+    DiskUsageResult result = m_usageWatcher.resultAt(index);
+    if (result.row < 0 || result.row >= m_apps.size()) {
+        return;
+    }
+
+    InstalledAppStatus &app = m_apps[result.row];
+    m_measured[result.row] = true;
+
+    // The registry is only touched from this thread
+    if (!result.fromCache) {
+        app.diskUsage = result.bytes;
+        app.diskUsageStamp = result.stamp;
+        m_installer->recordDiskUsage(app.record.appName, result.bytes, result.stamp);
+    }
+
+    QModelIndex size = this->index(result.row, SizeColumn);
+    emit dataChanged(size, size);
+}
+
+void InstalledAppsModel::stopMeasuring()
+{
+    // Results still queued refer to rows about to go away
+    m_usageWatcher.cancel();
+    m_usageWatcher.waitForFinished();
+}
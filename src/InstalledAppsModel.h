@@ -0,0 +1,72 @@
+#ifndef INSTALLEDAPPSMODEL_H
+#define INSTALLEDAPPSMODEL_H
+
+#include <QAbstractTableModel>
+#include <QFutureWatcher>
+#include <QVector>
+#include "AppRegistry.h"
+
+class Installer;
+
+// Disk usage of one app as measured on a worker thread
+struct DiskUsageResult
+{
+    int row = -1;
+    qint64 bytes = -1;
+    qint64 stamp = 0;
+    bool fromCache = false;  // The tree was unchanged; nothing was walked
+};
+
+// Installed apps with their version, location, size, verification and
+// update state. Rows come straight from the registry, sizes included as
+// last measured, so the view is complete at once; sizes are then checked
+// against the trees on the thread pool and only walked again for trees
+// that changed since.
+class InstalledAppsModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        NameColumn,
+        VersionColumn,
+        PathColumn,
+        SizeColumn,
+        VerifiedColumn,
+        UpdateColumn,
+        ColumnCount
+    };
+
+    // Sort key of each cell: bytes for sizes, the displayed text otherwise
+    static const int SortRole = Qt::UserRole;
+
+    explicit InstalledAppsModel(Installer *installer, QObject *parent = nullptr);
+    ~InstalledAppsModel();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // Rereads the registry and starts measuring again
+    void reload();
+
+    // Bytes allocated to a tree, hard links counted once. Blocks.
+    static qint64 measureDiskUsage(const QString &dir);
+    // Newest mtime of the directories of a tree: it moves when the tree is
+    // replaced or a file anywhere in it is added, removed or renamed
+    static qint64 treeStamp(const QString &dir);
+
+private slots:
+    void onUsageReady(int index);
+
+private:
+    void stopMeasuring();
+
+    Installer *m_installer;
+    QVector<InstalledAppStatus> m_apps;
+    QVector<bool> m_measured;
+    QFutureWatcher<DiskUsageResult> m_usageWatcher;
+};
+
+#endif // INSTALLEDAPPSMODEL_H
@@ -7,27 +7,66 @@
 #include <QNetworkReply>
 #include <QEventLoop>
 #include <QProcess>
-#include <QSqlQuery>
-#include <QSqlError>
 #include <QDateTime>
 #include <QRegularExpression>
 #include <QFileInfo>
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include "Checksum.h"
+#include "InstallVerifier.h"
+#include "DiskPreflight.h"
+#include "StagingArea.h"
+#include "PageCacheWarmup.h"
+#include "ZipArchive.h"
+#include "TarArchive.h"
+#include "ArchiveIndex.h"
+#include "ArchiveCache.h"
+#include "Trace.h"
+#include "IconTheme.h"
+#include "AppDiscovery.h"
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <QHash>
+#include <QScopedPointer>
+#include <algorithm>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 Installer::Installer(QObject *parent)
     : QObject(parent)
     , m_progressBar(nullptr)
     , m_logTextEdit(nullptr)
+    , m_dedupStore(m_registry)
+    , m_deduplicate(false)
+    , m_journal(m_registry)
+    , m_archiveCache(m_registry)
+    , m_metrics(m_registry)
+    , m_recordingMetric(false)
+    , m_warmup(false)
+    , m_updateChecker(new UpdateChecker(nullptr, this))
+    , m_prefetchEnabled(false)
+    , m_prefetchScheduled(false)
+    , m_activity(Idle)
+    , m_activityDepth(0)
+    , m_dependenciesChecked(false)
 {
+    connect(m_updateChecker, &UpdateChecker::finished, this, &Installer::onUpdateCheckFinished);
+
     initializeDatabase();
 }
 
 Installer::~Installer()
 {
-    if (m_db.isOpen()) {
-        m_db.close();
-    }
+    m_registry.close();
 }
 
 void Installer::setProgressBar(QProgressBar *bar)
@@ -40,10 +79,59 @@ void Installer::setLogTextEdit(QTextEdit *textEdit)
     m_logTextEdit = textEdit;
 }
 
+void Installer::setExpectedSha256(const QString &checksum)
+{
+    m_expectedSha256 = Checksum::parseSha256(checksum.trimmed().toUtf8());
+}
+
+void Installer::setDeduplicationEnabled(bool enabled, bool allowHardlinks)
+{
+    m_deduplicate = enabled;
+    m_dedupStore.setHardlinksAllowed(allowHardlinks);
+}
+
+void Installer::setIoPolicy(const IoPolicy &policy)
+{
+    m_ioPolicy = policy;
+}
+
+void Installer::setWarmupEnabled(bool enabled)
+{
+    m_warmup = enabled;
+}
+
+IoPolicy Installer::activeIoPolicy() const
+{
+    // Background work is always idle, on top of whatever cap the user set
+    IoPolicy policy = m_ioPolicy;
+    if (m_activity == Staging) {
+        policy.idlePriority = true;
+        policy.dropCache = true;
+    }
+    return policy;
+}
+
 bool Installer::installFromLocalFile(const QString &filePath, const QString &installPath,
                                      bool createDesktop, bool createSymlink)
 {
+    if (!beginActivity(Installing)) {
+        return false;
+    }
+    bool recording = beginMetric("local");
+    bool ok = installLocalFile(filePath, installPath, createDesktop, createSymlink);
+    if (recording) {
+        finishMetric(ok);
+    }
+    endActivity();
+    return ok;
+}
+
+bool Installer::installLocalFile(const QString &filePath, const QString &installPath,
+                                 bool createDesktop, bool createSymlink)
+{
+    TRACE_SCOPE("install");
     log("Iniciando instalación desde archivo local: " + filePath);
+    m_pendingArtifacts.clear();
     
     // Check dependencies first
     if (!checkDependencies()) {
@@ -67,46 +155,43 @@ bool Installer::installFromLocalFile(const QString &filePath, const QString &ins
         return false;
     }
 
-    // Extract to a temporary directory first
-    QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
-    QString tempDir = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/vsc_installer_temp_" + timestamp + "_" + QString::number(QCoreApplication::applicationPid());
-    
-    log("Creando directorio temporal: " + tempDir);
-    
-    // Ensure the directory exists and is writable
-    if (!QDir().mkpath(tempDir)) {
-        log("ERROR: No se pudo crear el directorio temporal: " + tempDir);
-        emit installationCompleted(false, "No se pudo crear directorio temporal");
+    // A run that died after extracting left a verified tree behind; reuse it
+    JournalEntry journal;
+    if (!m_journal.begin(filePath, installPath, &journal)) {
+        log("ERROR: Otra instancia está instalando este archivo en " + installPath);
+        emit installationCompleted(false, "Hay otra instalación del mismo archivo en curso");
         return false;
     }
     
-    // Verify directory is writable
-    QFileInfo tempDirInfo(tempDir);
-    if (!tempDirInfo.exists() || !tempDirInfo.isWritable()) {
-        log("ERROR: El directorio temporal no es escribible: " + tempDir);
-        QDir(tempDir).removeRecursively();
-        emit installationCompleted(false, "Directorio temporal no es escribible");
-        return false;
-    }
-    
-    log("Extrayendo temporalmente a: " + tempDir);
-    updateProgress(20);
-
-    if (!extractTarball(filePath, tempDir)) {
-        log("ERROR: Falló la extracción del tarball");
-        emit installationCompleted(false, "Falló la extracción del tarball");
-        QDir(tempDir).removeRecursively();
-        return false;
+    QString tempDir;
+    ExtractedFiles extracted;
+    m_metric.archiveBytes = QFileInfo(filePath).size();
+    if (canResumeExtraction(journal, filePath)) {
+        m_metric.resumed = true;
+        tempDir = journal.stagingDir;
+        log("Reanudando instalación interrumpida, se reutiliza la extracción en: " + tempDir);
+        updateProgress(40);
+    } else {
+        // Whatever an earlier run left behind can no longer be trusted
+        if (!journal.stagingDir.isEmpty()) {
+            QDir(journal.stagingDir).removeRecursively();
+        }
+        if (!extractToStaging(filePath, installPath, &journal, &tempDir, &extracted)) {
+            // Its staging dir is already gone; nothing is left to resume
+            m_journal.finish(journal);
+            return false;
+        }
     }
 
-    updateProgress(40);
-
     // Find the actual application directory and executable
+    TraceScope discover("discover");
     QString execPath = findExecutableInDirectory(tempDir);
+    discover.end();
     if (execPath.isEmpty()) {
         log("ERROR: No se encontró ejecutable en el directorio extraído");
         emit installationCompleted(false, "No se encontró ejecutable");
         QDir(tempDir).removeRecursively();
+        m_journal.finish(journal);
         return false;
     }
 
@@ -118,6 +203,7 @@ bool Installer::installFromLocalFile(const QString &filePath, const QString &ins
     log("Ejecutable encontrado: " + execPath);
     log("Directorio real de la aplicación: " + realAppDir);
     log("Nombre de la aplicación: " + appName);
+    m_metric.appName = appName;
 
     // Final installation directory
     QString finalInstallDir = installPath + "/" + appName;
@@ -126,10 +212,32 @@ bool Installer::installFromLocalFile(const QString &filePath, const QString &ins
     log("Moviendo aplicación a: " + finalInstallDir);
     QDir().mkpath(installPath);
     
-    // Remove existing installation if it exists
+    // Last chance to learn what the current version reads at startup
+    if (m_registry.findApp(appName, nullptr)) {
+        m_metric.kind = "update";
+        learnWarmupProfile(appName);
+    }
+    
+    // Keep the existing installation aside until the new one is in place
+    QString backupDir;
     if (QDir(finalInstallDir).exists()) {
-        log("Eliminando instalación previa en: " + finalInstallDir);
-        QDir(finalInstallDir).removeRecursively();
+        backupDir = finalInstallDir + ".old-" + QString::number(QCoreApplication::applicationPid());
+    }
+    
+    // Journaled before anything moves, so a crash while the old tree is aside can put it back
+    TraceScope commit("commit");
+    journal.phase = JournalEntry::Replacing;
+    journal.finalDir = finalInstallDir;
+    journal.backupDir = backupDir;
+    m_journal.record(journal);
+    
+    if (!backupDir.isEmpty()) {
+        log("Apartando instalación previa en: " + backupDir);
+        if (!QDir().rename(finalInstallDir, backupDir)) {
+            log("Eliminando instalación previa en: " + finalInstallDir);
+            QDir(finalInstallDir).removeRecursively();
+            backupDir.clear();
+        }
     }
     
     // Rename/move the actual application directory
@@ -140,10 +248,16 @@ bool Installer::installFromLocalFile(const QString &filePath, const QString &ins
         log("Rename falló, intentando copia recursiva...");
         
         // If rename fails, use recursive copy (works across filesystems)
-        if (!copyDirectoryRecursively(realAppDir, finalInstallDir)) {
+        WriteRateLimiter limiter(activeIoPolicy().writeBytesPerSecond);
+        if (!copyDirectoryRecursively(realAppDir, finalInstallDir, &limiter)) {
             log("ERROR: No se pudo copiar la aplicación al destino final");
+            QDir(finalInstallDir).removeRecursively();
+            if (!backupDir.isEmpty() && QDir().rename(backupDir, finalInstallDir)) {
+                log("Instalación previa restaurada");
+            }
             emit installationCompleted(false, "No se pudo copiar la aplicación al destino final");
             QDir(tempDir).removeRecursively();
+            m_journal.finish(journal);
             return false;
         }
         
@@ -153,6 +267,16 @@ bool Installer::installFromLocalFile(const QString &filePath, const QString &ins
     } else {
         log("Aplicación movida exitosamente con rename");
     }
+    
+    // From here on the new tree is complete and is what a crash must keep
+    journal.phase = JournalEntry::Replaced;
+    journal.execPath = finalInstallDir + "/" + execInfo.fileName();
+    m_journal.record(journal);
+    
+    if (!backupDir.isEmpty()) {
+        QDir(backupDir).removeRecursively();
+    }
+    commit.end();
 
     // Update executable path to final location
     QString finalExecPath = finalInstallDir + "/" + execInfo.fileName();
@@ -164,6 +288,7 @@ bool Installer::installFromLocalFile(const QString &filePath, const QString &ins
         QString symlinkName = "/usr/local/bin/" + appName;
         if (this->createSymlink(finalExecPath, symlinkName)) {
             log("Enlace simbólico creado: " + symlinkName);
+            m_pendingArtifacts.append(InstallManifest::externalEntry(symlinkName, ManifestEntry::BinLink));
         } else {
             log("ADVERTENCIA: No se pudo crear el enlace simbólico");
         }
@@ -172,29 +297,79 @@ bool Installer::installFromLocalFile(const QString &filePath, const QString &ins
     updateProgress(80);
 
     if (createDesktop) {
-        QString iconPath = finalInstallDir + "/icon.png";
-        if (!QFile::exists(iconPath)) {
-            iconPath = "";
-        }
+        QString iconName = installThemeIcons(appName, finalInstallDir);
         
-        if (createDesktopEntry(appName, finalExecPath, iconPath)) {
+        if (createDesktopEntry(appName, finalExecPath, iconName)) {
             log("Entrada de escritorio creada correctamente");
         } else {
             log("ADVERTENCIA: No se pudo crear la entrada de escritorio");
         }
+        m_desktopEntries.flush();
     }
 
     updateProgress(90);
 
-    QString version = getVersionFromExecutable(finalExecPath);
-    if (registerApp(appName, version, finalInstallDir, "", finalExecPath)) {
+    // Reading package.json through the index is far cheaper than starting the editor
+    TraceScope versionProbe("version_probe");
+    QString version = versionFromArchive(filePath);
+    if (version.isEmpty()) {
+        version = getVersionFromExecutable(finalExecPath);
+    }
+    versionProbe.end();
+    m_metric.version = version;
+
+    log("Generando manifiesto de archivos instalados...");
+    TraceScope manifestScan("manifest");
+    QVector<ManifestEntry> manifest = InstallManifest::scanTree(
+        finalInstallDir, InstallManifest::rebase(extracted, QDir(tempDir).relativeFilePath(realAppDir)));
+    manifestScan.end();
+    manifest += m_pendingArtifacts;
+    log("Manifiesto generado: " + QString::number(manifest.size()) + " entradas");
+    
+    qint64 installedBytes = 0;
+    foreach (const ManifestEntry &entry, manifest) {
+        installedBytes += entry.size;
+    }
+    Trace::counter("installed_files", manifest.size());
+    Trace::counter("installed_bytes", installedBytes);
+    m_metric.installedFiles = manifest.size();
+    m_metric.installedBytes = installedBytes;
+    
+    // Hashing was the last read of the fresh tree; keep it from crowding out other work
+    if (activeIoPolicy().dropCache) {
+        IoThrottle::dropCache(finalInstallDir);
+    }
+
+    if (registerApp(appName, version, finalInstallDir, m_currentSource.sourceUrl, finalExecPath, manifest)) {
         log("Aplicación registrada en la base de datos");
     } else {
         log("ADVERTENCIA: No se pudo registrar la aplicación");
     }
+    
+    // References held by a previous install of this app point at files that are gone now
+    m_dedupStore.release(appName);
+    
+    // Whatever was prefetched was meant to replace the install that is gone now
+    discardStagedUpdate(appName);
+    
+    if (m_deduplicate) {
+        log("Deduplicando archivos compartidos con otras aplicaciones...");
+        qint64 saved = m_dedupStore.deduplicate(appName, manifest, DedupStore::storeRootFor(installPath));
+        log("Espacio ahorrado por deduplicación: " + DiskPreflight::formatBytes(saved));
+    }
 
     // Clean up temporary directory
     QDir(tempDir).removeRecursively();
+    m_journal.finish(journal);
+    
+    if (ArchiveCache::canEncode(filePath)) {
+        cacheArchive(filePath, journal.archiveSha256, appName);
+    }
+
+    // Pointless when the policy just evicted the tree on purpose
+    if (m_warmup && !activeIoPolicy().dropCache) {
+        warmUpApp(appName);
+    }
 
     updateProgress(100);
     log("Instalación completada exitosamente");
@@ -203,9 +378,154 @@ bool Installer::installFromLocalFile(const QString &filePath, const QString &ins
     return true;
 }
 
+bool Installer::extractToStaging(const QString &filePath, const QString &installPath,
+                                 JournalEntry *journal, QString *stagingDir, ExtractedFiles *extracted)
+{
+    // A reinstall or rollback skips the vendor's compression entirely
+    TraceScope sniff("sniff");
+    QString source = filePath;
+    CachedArchive cached;
+    if (findCachedArchive(filePath, &cached)) {
+        m_metric.cacheHit = true;
+        source = cached.path;
+        log("Usando la copia rápida en caché (" + cached.format + "): " + source);
+    }
+    
+    // Fail before writing anything if the tree cannot fit
+    QString stagingRoot = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
+    ArchiveFootprint footprint = DiskPreflight::measureArchive(source);
+    log(QString("Espacio requerido: %1 en %2 inodos%3")
+        .arg(DiskPreflight::formatBytes(footprint.bytes))
+        .arg(footprint.inodes)
+        .arg(footprint.exact ? "" : " (estimado)"));
+    
+    QString spaceError;
+    if (!DiskPreflight::check(footprint, stagingRoot, installPath, 0, &spaceError)) {
+        log("ERROR: " + spaceError);
+        emit installationCompleted(false, spaceError);
+        return false;
+    }
+    sniff.end();
+    Trace::counter("archive_bytes", QFileInfo(source).size());
+
+    // Extract to a temporary directory first
+    QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
+    QString tempDir = stagingRoot + "/vsc_installer_temp_" + timestamp + "_" + QString::number(QCoreApplication::applicationPid());
+    
+    log("Creando directorio temporal: " + tempDir);
+    
+    // Ensure the directory exists and is writable
+    if (!QDir().mkpath(tempDir)) {
+        log("ERROR: No se pudo crear el directorio temporal: " + tempDir);
+        emit installationCompleted(false, "No se pudo crear directorio temporal");
+        return false;
+    }
+    
+    // Verify directory is writable
+    QFileInfo tempDirInfo(tempDir);
+    if (!tempDirInfo.exists() || !tempDirInfo.isWritable()) {
+        log("ERROR: El directorio temporal no es escribible: " + tempDir);
+        QDir(tempDir).removeRecursively();
+        emit installationCompleted(false, "Directorio temporal no es escribible");
+        return false;
+    }
+    
+    log("Extrayendo temporalmente a: " + tempDir);
+    updateProgress(20);
+
+    // The archive is hashed while it is fed to tar, so checking it costs no extra read
+    QByteArray archiveSha256;
+    bool ok = extractTarball(source, tempDir, &archiveSha256, extracted);
+    
+    // The copy is checked like any archive; the original's hash, known from
+    // the lookup, is what checksums and the journal refer to
+    if (source != filePath) {
+        if (ok && archiveSha256 == cached.sha256) {
+            archiveSha256 = cached.originalSha256;
+        } else {
+            log("ADVERTENCIA: La copia en caché está dañada, se extrae el archivo original");
+            m_metric.cacheHit = false;
+            m_archiveCache.remove(cached.originalSha256);
+            QDir(tempDir).removeRecursively();
+            extracted->clear();
+            ok = QDir().mkpath(tempDir) && extractTarball(filePath, tempDir, &archiveSha256, extracted);
+        }
+    }
+    
+    if (!ok) {
+        log("ERROR: Falló la extracción del tarball");
+        emit installationCompleted(false, "Falló la extracción del tarball");
+        QDir(tempDir).removeRecursively();
+        return false;
+    }
+    
+    log("SHA-256 del archivo: " + QString::fromLatin1(archiveSha256));
+    
+    QByteArray expectedSha256 = expectedSha256For(filePath);
+    if (expectedSha256.isEmpty()) {
+        log("ADVERTENCIA: No hay suma SHA-256 de referencia, no se verificó la integridad");
+    } else if (archiveSha256 != expectedSha256) {
+        log("ERROR: La suma SHA-256 no coincide. Esperada: " + QString::fromLatin1(expectedSha256));
+        emit installationCompleted(false, "La verificación de integridad del archivo falló");
+        QDir(tempDir).removeRecursively();
+        return false;
+    } else {
+        log("Integridad del archivo verificada");
+    }
+
+    updateProgress(40);
+    
+    journal->phase = JournalEntry::Extracted;
+    journal->archivePath = filePath;
+    journal->archiveSha256 = archiveSha256;
+    journal->archiveStamp = InstallJournal::archiveStamp(filePath);
+    journal->stagingDir = tempDir;
+    journal->treeDigest = InstallJournal::treeDigest(tempDir);
+    m_journal.record(*journal);
+    
+    *stagingDir = tempDir;
+    return true;
+}
+
+bool Installer::canResumeExtraction(const JournalEntry &journal, const QString &filePath) const
+{
+    if (journal.phase != JournalEntry::Extracted || !QFileInfo(journal.stagingDir).isDir()) {
+        return false;
+    }
+    
+    // Same archive as last time, still matching what the user expects now
+    if (journal.archiveStamp != InstallJournal::archiveStamp(filePath)) {
+        return false;
+    }
+    
+    QByteArray expectedSha256 = expectedSha256For(filePath);
+    if (!expectedSha256.isEmpty() && expectedSha256 != journal.archiveSha256) {
+        return false;
+    }
+    
+    // Nothing was added to or removed from the tree since
+    return InstallJournal::treeDigest(journal.stagingDir) == journal.treeDigest;
+}
+
 bool Installer::installFromUrl(const QUrl &url, const QString &installPath,
                               bool createDesktop, bool createSymlink)
 {
+    if (!beginActivity(Installing)) {
+        return false;
+    }
+    bool recording = beginMetric("url");
+    bool ok = installUrl(url, installPath, createDesktop, createSymlink);
+    if (recording) {
+        finishMetric(ok);
+    }
+    endActivity();
+    return ok;
+}
+
+bool Installer::installUrl(const QUrl &url, const QString &installPath,
+                           bool createDesktop, bool createSymlink)
+{
+    TRACE_SCOPE("install_from_url");
     log("Iniciando instalación desde URL: " + url.toString());
     
     // Check if admin privileges are needed
@@ -217,28 +537,95 @@ bool Installer::installFromUrl(const QUrl &url, const QString &installPath,
         }
     }
     
-    QString tempDir = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
+    JournalEntry journal;
+    if (!m_journal.begin(url.toString(), installPath, &journal)) {
+        log("ERROR: Otra instancia está instalando esta URL en " + installPath);
+        emit installationCompleted(false, "Hay otra instalación de la misma URL en curso");
+        return false;
+    }
+    
     QString fileName = url.fileName();
     if (fileName.isEmpty()) {
         fileName = "download.tar.gz";
     }
     
-    QString downloadPath = tempDir + "/" + fileName;
+    // Downloads live in the cache, not in /tmp, so an interrupted install can reuse them
+    QString downloadRoot = downloadCacheDir();
+    QDir().mkpath(downloadRoot);
+    QString downloadPath = downloadRoot + "/" + QString::number(journal.id) + "-" + fileName;
     m_currentDownloadPath = downloadPath;
-
-    log("Descargando archivo a: " + downloadPath);
+    m_currentInstallPath = installPath;
+    m_currentSource = AppRecord();
+    m_currentSource.sourceUrl = url.toString();
+    
+    QString sidecarPath = Checksum::sidecarPath(downloadPath);
+    
+    QByteArray downloadSha256;
+    if (journal.phase >= JournalEntry::Downloaded && journal.archivePath == downloadPath
+        && QFileInfo(downloadPath).isFile()
+        && InstallManifest::hashFile(downloadPath) == journal.archiveSha256) {
+        log("Reanudando: la descarga ya estaba completa en " + downloadPath);
+        downloadSha256 = journal.archiveSha256;
+        updateProgress(30);
+    } else {
+        log("Descargando archivo a: " + downloadPath);
+        
+        if (!downloadFile(url, downloadPath, &downloadSha256)) {
+            log("ERROR: Falló la descarga del archivo");
+            emit installationCompleted(false, "Falló la descarga del archivo");
+            QFile::remove(downloadPath);
+            m_journal.finish(journal);
+            return false;
+        }
+        m_metric.downloadBytes = QFileInfo(downloadPath).size();
+        
+        // Without a user supplied checksum, use the vendor sidecar if one is published
+        QFile::remove(sidecarPath);
+        if (m_expectedSha256.isEmpty()) {
+            QByteArray remoteSha256 = fetchRemoteSha256(url);
+            if (!remoteSha256.isEmpty()) {
+                QFile sidecar(sidecarPath);
+                if (sidecar.open(QIODevice::WriteOnly)) {
+                    sidecar.write(remoteSha256 + "  " + QFile::encodeName(fileName) + "\n");
+                    sidecar.close();
+                }
+            }
+        }
+    }
     
-    if (!downloadFile(url, downloadPath)) {
-        log("ERROR: Falló la descarga del archivo");
-        emit installationCompleted(false, "Falló la descarga del archivo");
+    // Reject a corrupt download before spending time on extraction
+    QByteArray expectedSha256 = expectedSha256For(downloadPath);
+    if (!expectedSha256.isEmpty() && downloadSha256 != expectedSha256) {
+        log("ERROR: La suma SHA-256 de la descarga no coincide");
+        log("  Esperada: " + QString::fromLatin1(expectedSha256));
+        log("  Obtenida: " + QString::fromLatin1(downloadSha256));
+        emit installationCompleted(false, "La verificación de integridad de la descarga falló");
+        QFile::remove(downloadPath);
+        QFile::remove(sidecarPath);
+        m_journal.finish(journal);
         return false;
     }
+    
+    journal.phase = JournalEntry::Downloaded;
+    journal.archivePath = downloadPath;
+    journal.archiveSha256 = downloadSha256;
+    m_journal.record(journal);
 
     log("Descarga completada, iniciando instalación");
     
     bool result = installFromLocalFile(downloadPath, installPath, createDesktop, createSymlink);
     
-    QFile::remove(downloadPath);
+    // A failed install keeps the verified download for the next attempt
+    if (result) {
+        // Re-encoding still reads it; the download goes once the copy is cached
+        if (!m_cachingArchives.contains(downloadPath)) {
+            QFile::remove(downloadPath);
+            QFile::remove(sidecarPath);
+            QFile::remove(ArchiveIndex::indexPathFor(downloadPath));
+        }
+        m_journal.finish(journal);
+    }
+    m_currentSource = AppRecord();
     
     return result;
 }
@@ -248,17 +635,23 @@ bool Installer::updateExistingApp(const QString &appName, const QString &newSour
 {
     log("Iniciando actualización de aplicación: " + appName);
     
-    QSqlQuery query(m_db);
-    query.prepare("SELECT install_path FROM installed_apps WHERE app_name = ?");
-    query.addBindValue(appName);
-    
-    if (!query.exec() || !query.next()) {
+    AppRecord record;
+    if (!m_registry.findApp(appName, &record)) {
         log("ERROR: Aplicación no encontrada en los registros");
         emit installationCompleted(false, "Aplicación no encontrada");
         return false;
     }
     
-    QString currentInstallPath = query.value(0).toString();
+    // A prefetched copy of the same, still current, payload turns the update into a swap
+    StagedUpdate staged;
+    if (isUrl && m_registry.findStagedUpdate(appName, &staged)
+        && (newSource == staged.record.sourceUrl || newSource == staged.record.resolvedUrl)
+        && (record.updateUrl.isEmpty() || record.updateUrl == staged.record.resolvedUrl)) {
+        return applyStagedUpdate(appName);
+    }
+    
+    // Apps are installed into <installPath>/<appName>, reinstall into the same parent
+    QString currentInstallPath = QFileInfo(record.installPath).absolutePath();
     
     bool result;
     if (isUrl) {
@@ -276,32 +669,49 @@ bool Installer::updateExistingApp(const QString &appName, const QString &newSour
 
 QStringList Installer::getInstalledApps() const
 {
-    QStringList apps;
-    QSqlQuery query("SELECT app_name FROM installed_apps", m_db);
-    
-    while (query.next()) {
-        apps << query.value(0).toString();
-    }
-    
-    return apps;
+    return m_registry.appNames();
+}
+
+QVector<InstalledAppStatus> Installer::installedAppStatus()
+{
+    return m_registry.installedAppStatus();
+}
+
+bool Installer::recordDiskUsage(const QString &appName, qint64 bytes, qint64 stamp)
+{
+    return m_registry.recordDiskUsage(appName, bytes, stamp);
 }
 
 bool Installer::removeApp(const QString &appName)
 {
     log("Eliminando aplicación: " + appName);
     
-    QSqlQuery query(m_db);
-    query.prepare("SELECT install_path, exec_path FROM installed_apps WHERE app_name = ?");
-    query.addBindValue(appName);
-    
-    if (!query.exec() || !query.next()) {
+    AppRecord record;
+    if (!m_registry.findApp(appName, &record)) {
         log("ERROR: Aplicación no encontrada en los registros");
         return false;
     }
     
-    QString installPath = query.value(0).toString();
-    QString execPath = query.value(1).toString();
+    QString installPath = record.installPath;
     
+    QVector<ManifestEntry> manifest = m_registry.manifest(appName);
+    if (!manifest.isEmpty()) {
+        log("Eliminando " + QString::number(manifest.size()) + " entradas del manifiesto");
+        int failures = InstallManifest::removeEntries(manifest);
+        if (failures > 0) {
+            log(QString("ADVERTENCIA: No se pudieron eliminar %1 entradas del manifiesto").arg(failures));
+        }
+        
+        foreach (const ManifestEntry &entry, manifest) {
+            if (entry.kind == ManifestEntry::ThemeIcon) {
+                IconTheme::refreshCache(entry.path.left(entry.path.indexOf("/hicolor/") + 8));
+                break;
+            }
+        }
+    }
+    
+    // Files created after installation are not in the manifest, and older
+    // installs have no manifest at all
     QDir dir(installPath);
     if (dir.exists()) {
         if (!dir.removeRecursively()) {
@@ -309,17 +719,23 @@ bool Installer::removeApp(const QString &appName)
         }
     }
     
-    QString symlinkName = "/usr/local/bin/" + appName;
-    QFile::remove(symlinkName);
+    if (manifest.isEmpty()) {
+        QString symlinkName = "/usr/local/bin/" + appName;
+        QFile::remove(symlinkName);
+        
+        QString desktopPath = QStandardPaths::writableLocation(QStandardPaths::ApplicationsLocation) + "/" + appName + ".desktop";
+        QFile::remove(desktopPath);
+    }
     
-    QString desktopPath = QStandardPaths::writableLocation(QStandardPaths::ApplicationsLocation) + "/" + appName + ".desktop";
-    QFile::remove(desktopPath);
+    if (!m_dedupStore.release(appName)) {
+        log("ADVERTENCIA: No se pudieron liberar las referencias de deduplicación");
+    }
+    m_archiveCache.removeForApp(appName);
     
-    query.prepare("DELETE FROM installed_apps WHERE app_name = ?");
-    query.addBindValue(appName);
+    discardStagedUpdate(appName);
     
-    if (!query.exec()) {
-        log("ERROR: No se pudo eliminar el registro de la base de datos");
+    if (!m_registry.unregisterApp(appName)) {
+        log("ERROR: No se pudo eliminar el registro de la base de datos: " + m_registry.lastError());
         return false;
     }
     
@@ -327,8 +743,580 @@ bool Installer::removeApp(const QString &appName)
     return true;
 }
 
+bool Installer::verifyInstalledApps(const QStringList &appNames, bool full)
+{
+    QStringList apps = appNames.isEmpty() ? m_registry.appNames() : appNames;
+    
+    QMap<QString, QVector<ManifestEntry>> manifests;
+    foreach (const QString &appName, apps) {
+        if (!m_registry.findApp(appName, nullptr)) {
+            log("ERROR: Aplicación no encontrada en los registros: " + appName);
+            return false;
+        }
+        
+        QVector<ManifestEntry> manifest = m_registry.manifest(appName);
+        if (manifest.isEmpty()) {
+            log("ADVERTENCIA: " + appName + " no tiene manifiesto, reinstálela para poder verificarla");
+            continue;
+        }
+        manifests.insert(appName, manifest);
+    }
+    
+    log(QString("Verificando %1 aplicaciones%2...").arg(manifests.size()).arg(full ? " (completa)" : ""));
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    QVector<VerifyResult> results = InstallVerifier::verify(manifests, full);
+    
+    bool clean = true;
+    m_registry.beginTransaction();
+    
+    foreach (const VerifyResult &result, results) {
+        log(QString("%1: %2 entradas, %3 archivos releídos, %4 problemas")
+            .arg(result.appName)
+            .arg(result.checked)
+            .arg(result.hashed)
+            .arg(result.issues.size()));
+        
+        foreach (const VerifyIssue &issue, result.issues) {
+            log("  " + InstallVerifier::problemToString(issue.problem) + ": " + issue.path);
+        }
+        
+        if (!result.isClean()) {
+            clean = false;
+        }
+        
+        if (!m_registry.updateVerifiedState(result.appName, result.refreshed)) {
+            log("ADVERTENCIA: No se pudo guardar el estado de verificación: " + m_registry.lastError());
+        }
+    }
+    
+    m_registry.commit();
+    
+    log(QString("Verificación terminada en %1 ms").arg(timer.elapsed()));
+    return clean;
+}
+
+DedupReport Installer::deduplicationReport()
+{
+    return m_dedupStore.report();
+}
+
+void Installer::checkForUpdates()
+{
+    if (m_updateChecker->isRunning()) {
+        return;
+    }
+    
+    QVector<UpdateCheckTarget> targets = m_registry.updateCheckTargets();
+    log(QString("Buscando actualizaciones de %1 aplicaciones...").arg(targets.size()));
+    m_updateChecker->check(targets);
+}
+
+void Installer::onUpdateCheckFinished(const QVector<UpdateCheckResult> &results)
+{
+    QStringList updates;
+    
+    m_registry.beginTransaction();
+    foreach (const UpdateCheckResult &result, results) {
+        if (result.failed) {
+            log("ADVERTENCIA: " + result.appName + ": " + result.errorString);
+        } else if (result.updateAvailable) {
+            log("Actualización disponible para " + result.appName + ": " + result.resolvedUrl);
+            updates << result.appName;
+        } else {
+            log(result.appName + " está actualizada");
+        }
+        
+        if (!m_registry.recordUpdateCheck(result)) {
+            log("ADVERTENCIA: No se pudo guardar el resultado: " + m_registry.lastError());
+        }
+    }
+    m_registry.commit();
+    
+    emit updateCheckCompleted(updates);
+    
+    if (m_prefetchEnabled && !updates.isEmpty()) {
+        schedulePrefetch(0);
+    }
+}
+
+QStringList Installer::appsWithUpdates() const
+{
+    QStringList updates;
+    foreach (const QString &appName, m_registry.appNames()) {
+        AppRecord record;
+        if (m_registry.findApp(appName, &record) && record.updateAvailable) {
+            updates << appName;
+        }
+    }
+    return updates;
+}
+
+QString Installer::updateSourceFor(const QString &appName) const
+{
+    AppRecord record;
+    if (!m_registry.findApp(appName, &record)) {
+        return QString();
+    }
+    return record.sourceUrl;
+}
+
+void Installer::setPrefetchEnabled(bool enabled)
+{
+    m_prefetchEnabled = enabled;
+}
+
+void Installer::schedulePrefetch(int msecs)
+{
+    if (m_prefetchScheduled) {
+        return;
+    }
+    
+    m_prefetchScheduled = true;
+    QTimer::singleShot(msecs, this, &Installer::prefetchPendingUpdates);
+}
+
+void Installer::prefetchPendingUpdates()
+{
+    m_prefetchScheduled = false;
+    if (!m_prefetchEnabled) {
+        return;
+    }
+    
+    // The timer fired inside an install's or a prefetch's event loop; wait until it is over
+    if (m_activity != Idle) {
+        schedulePrefetch(60 * 1000);
+        return;
+    }
+    
+    foreach (const QString &appName, appsWithUpdates()) {
+        // Checked before each app: a download can take long enough for a build to start
+        if (!StagingArea::isSystemIdle()) {
+            log("Sistema ocupado, la preparación de actualizaciones se reintentará más tarde");
+            schedulePrefetch(5 * 60 * 1000);
+            return;
+        }
+        
+        prefetchUpdate(appName);
+    }
+}
+
+bool Installer::prefetchUpdate(const QString &appName)
+{
+    AppRecord record;
+    if (!m_registry.findApp(appName, &record) || record.sourceUrl.isEmpty()) {
+        log("ERROR: " + appName + " no tiene una URL de origen desde la que preparar la actualización");
+        return false;
+    }
+    
+    // Staged next to the install so that applying it never crosses filesystems
+    QString installPath = QFileInfo(record.installPath).absolutePath();
+    QString stagedTree = StagingArea::treePathFor(installPath, appName);
+    
+    StagedUpdate staged;
+    if (m_registry.findStagedUpdate(appName, &staged) && QFileInfo(staged.stagedPath).isDir()
+        && !record.updateUrl.isEmpty() && staged.record.resolvedUrl == record.updateUrl) {
+        log("La actualización de " + appName + " ya está preparada");
+        return true;
+    }
+    
+    if (!beginActivity(Staging)) {
+        log("Hay otra instalación o preparación en curso, la actualización de " + appName + " se preparará más tarde");
+        return false;
+    }
+    
+    discardStagedUpdate(appName);
+    StagingArea::sweep(installPath);
+    
+    if (!QDir().mkpath(StagingArea::rootFor(installPath))) {
+        log("ERROR: No se pudo crear el área de preparación en: " + StagingArea::rootFor(installPath));
+        endActivity();
+        return false;
+    }
+    
+    log("Preparando actualización de " + appName + " en segundo plano...");
+    
+    bool ok = stageUpdate(record, installPath, stagedTree);
+    endActivity();
+    
+    if (!ok) {
+        QDir(stagedTree).removeRecursively();
+        StagingArea::sweep(installPath);
+        return false;
+    }
+    
+    emit updateStaged(appName);
+    return true;
+}
+
+bool Installer::stageUpdate(const AppRecord &record, const QString &installPath, const QString &stagedTree)
+{
+    TRACE_SCOPE("stage_update");
+    QUrl url(record.sourceUrl);
+    QString fileName = url.fileName();
+    if (fileName.isEmpty()) {
+        fileName = "download.tar.gz";
+    }
+    
+    QString downloadDir = stagedTree + ".download";
+    QString extractDir = stagedTree + ".extract";
+    QString downloadPath = downloadDir + "/" + fileName;
+    
+    if (!QDir().mkpath(downloadDir) || !QDir().mkpath(extractDir)) {
+        log("ERROR: No se pudo crear el directorio de preparación");
+        return false;
+    }
+    
+    m_currentSource = AppRecord();
+    m_currentSource.sourceUrl = record.sourceUrl;
+    m_currentInstallPath = installPath;
+    
+    QByteArray downloadSha256;
+    if (!downloadFile(url, downloadPath, &downloadSha256)) {
+        log("ERROR: Falló la descarga de la actualización de " + record.appName);
+        return false;
+    }
+    
+    QByteArray expectedSha256 = fetchRemoteSha256(url);
+    if (expectedSha256.isEmpty()) {
+        log("ADVERTENCIA: No hay suma SHA-256 de referencia, no se verificó la integridad");
+    } else if (downloadSha256 != expectedSha256) {
+        log("ERROR: La suma SHA-256 de la actualización no coincide");
+        return false;
+    }
+    
+    QString spaceError;
+    if (!DiskPreflight::check(DiskPreflight::measureArchive(downloadPath), extractDir, installPath, 0, &spaceError)) {
+        log("ERROR: " + spaceError);
+        return false;
+    }
+    
+    ExtractedFiles extracted;
+    if (!extractTarball(downloadPath, extractDir, nullptr, &extracted)) {
+        log("ERROR: Falló la extracción de la actualización de " + record.appName);
+        return false;
+    }
+    QString archiveVersion = versionFromArchive(downloadPath);
+    QDir(downloadDir).removeRecursively();
+    
+    QString execPath = findExecutableInDirectory(extractDir);
+    if (execPath.isEmpty()) {
+        log("ERROR: No se encontró ejecutable en la actualización");
+        return false;
+    }
+    
+    if (getAppNameFromPath(execPath) != record.appName) {
+        log("ERROR: La URL de origen ahora contiene otra aplicación: " + getAppNameFromPath(execPath));
+        return false;
+    }
+    
+    QString execName = QFileInfo(execPath).fileName();
+    QString appSubdir = QDir(extractDir).relativeFilePath(QFileInfo(execPath).absolutePath());
+    if (!QDir().rename(QFileInfo(execPath).absolutePath(), stagedTree)) {
+        log("ERROR: No se pudo mover la actualización a: " + stagedTree);
+        return false;
+    }
+    QDir(extractDir).removeRecursively();
+    
+    StagedUpdate update;
+    update.record = m_currentSource;
+    update.record.appName = record.appName;
+    update.record.installPath = record.installPath;
+    update.record.execPath = record.installPath + "/" + execName;
+    update.record.version = archiveVersion.isEmpty() ? getVersionFromExecutable(stagedTree + "/" + execName)
+                                                     : archiveVersion;
+    update.stagedPath = stagedTree;
+    update.archiveSha256 = QString::fromLatin1(downloadSha256);
+    
+    // Hashed now, under the final paths, so applying only swaps and writes rows
+    QVector<ManifestEntry> manifest = InstallManifest::scanTree(stagedTree, InstallManifest::rebase(extracted, appSubdir));
+    for (int i = 0; i < manifest.size(); ++i) {
+        manifest[i].path = record.installPath + manifest[i].path.mid(stagedTree.size());
+    }
+    
+    if (activeIoPolicy().dropCache) {
+        IoThrottle::dropCache(stagedTree);
+    }
+    
+    if (!m_registry.recordStagedUpdate(update, manifest)) {
+        log("ERROR: " + m_registry.lastError());
+        return false;
+    }
+    
+    log(QString("Actualización de %1 preparada (versión %2), lista para aplicar")
+        .arg(record.appName, update.record.version));
+    return true;
+}
+
+void Installer::discardStagedUpdate(const QString &appName)
+{
+    StagedUpdate staged;
+    if (!m_registry.findStagedUpdate(appName, &staged)) {
+        return;
+    }
+    
+    QDir(staged.stagedPath).removeRecursively();
+    m_registry.removeStagedUpdate(appName);
+}
+
+bool Installer::hasStagedUpdate(const QString &appName) const
+{
+    StagedUpdate staged;
+    return m_registry.findStagedUpdate(appName, &staged) && QFileInfo(staged.stagedPath).isDir();
+}
+
+bool Installer::applyStagedUpdate(const QString &appName)
+{
+    if (!beginActivity(Installing)) {
+        return false;
+    }
+    bool recording = beginMetric("staged");
+    m_metric.appName = appName;
+    m_metric.kind = "staged";
+    bool ok = swapInStagedUpdate(appName);
+    if (recording) {
+        finishMetric(ok);
+    }
+    endActivity();
+    return ok;
+}
+
+bool Installer::beginActivity(Activity activity)
+{
+    // Installs nest (an update reinstalls, a URL install installs the download)
+    if (m_activity != Idle && (m_activity != Installing || activity != Installing)) {
+        if (activity == Installing) {
+            log("ERROR: Se está preparando una actualización en segundo plano");
+            emit installationCompleted(false, "Se está preparando una actualización en segundo plano, "
+                                              "vuelva a intentarlo en unos momentos");
+        }
+        return false;
+    }
+    
+    m_activity = activity;
+    ++m_activityDepth;
+    return true;
+}
+
+void Installer::endActivity()
+{
+    if (--m_activityDepth == 0) {
+        m_activity = Idle;
+    }
+}
+
+bool Installer::swapInStagedUpdate(const QString &appName)
+{
+    TRACE_SCOPE("apply_staged_update");
+    log("Aplicando actualización preparada de: " + appName);
+    
+    AppRecord current;
+    StagedUpdate staged;
+    if (!m_registry.findApp(appName, &current) || !m_registry.findStagedUpdate(appName, &staged)) {
+        log("ERROR: No hay una actualización preparada para " + appName);
+        emit installationCompleted(false, "No hay una actualización preparada");
+        return false;
+    }
+    
+    if (!QFileInfo(staged.stagedPath).isDir() || staged.record.installPath != current.installPath) {
+        log("ERROR: La actualización preparada ya no es válida y se descarta");
+        discardStagedUpdate(appName);
+        emit installationCompleted(false, "La actualización preparada ya no es válida");
+        return false;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    QVector<ManifestEntry> manifest = m_registry.stagedManifest(appName);
+    QVector<ManifestEntry> previous = m_registry.manifest(appName);
+    
+    learnWarmupProfile(appName);
+    
+    QString displaced;
+    if (!StagingArea::swapInto(staged.stagedPath, current.installPath, &displaced)) {
+        log("ERROR: No se pudo intercambiar la instalación por la actualización preparada");
+        emit installationCompleted(false, "No se pudo aplicar la actualización preparada");
+        return false;
+    }
+    
+    // Links, menu entries and icons live outside the tree and carry over.
+    // What they held before is kept until the registry has the new version.
+    QHash<QString, QString> previousLinks;
+    QHash<QString, QString> rewrittenEntries;
+    foreach (const ManifestEntry &entry, previous) {
+        if (entry.kind != ManifestEntry::BinLink && entry.kind != ManifestEntry::DesktopEntry
+            && entry.kind != ManifestEntry::ThemeIcon) {
+            continue;
+        }
+        
+        if (staged.record.execPath != current.execPath && entry.kind != ManifestEntry::ThemeIcon) {
+            if (entry.kind == ManifestEntry::BinLink) {
+                // createSymlink() removes the old link even when it then fails
+                previousLinks.insert(entry.path, QFile::symLinkTarget(entry.path));
+                createSymlink(staged.record.execPath, entry.path);
+            } else {
+                QFile desktop(entry.path);
+                if (desktop.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                    QString original = QString::fromUtf8(desktop.readAll());
+                    desktop.close();
+                    QString content = original;
+                    QString newExec = "Exec=" + DesktopEntryWriter::quoteExec(staged.record.execPath);
+                    QString oldExec = DesktopEntryWriter::quoteExec(current.execPath);
+                    content.replace("Exec=" + oldExec, newExec);
+                    // Entries written before Exec values were quoted
+                    if (oldExec != current.execPath) {
+                        content.replace("Exec=" + current.execPath, newExec);
+                    }
+                    if (m_desktopEntries.write(entry.path, content) == DesktopEntryWriter::Written) {
+                        rewrittenEntries.insert(entry.path, original);
+                    }
+                    m_desktopIndex.refreshFile(entry.path);
+                }
+            }
+        }
+        
+        manifest.append(InstallManifest::externalEntry(entry.path, entry.kind));
+    }
+    m_desktopEntries.flush();
+    
+    m_registry.beginTransaction();
+    bool registered = m_registry.registerApp(staged.record, manifest)
+                      && m_registry.removeStagedUpdate(appName);
+    if (registered) {
+        registered = m_registry.commit();
+    } else {
+        m_registry.rollback();
+    }
+    
+    if (!registered) {
+        log("ERROR: " + m_registry.lastError());
+        
+        // Put the previous install back so the registry still describes what is on disk
+        for (auto it = previousLinks.constBegin(); it != previousLinks.constEnd(); ++it) {
+            if (!it.value().isEmpty()) {
+                createSymlink(it.value(), it.key());
+            }
+        }
+        for (auto it = rewrittenEntries.constBegin(); it != rewrittenEntries.constEnd(); ++it) {
+            m_desktopEntries.write(it.key(), it.value());
+            m_desktopIndex.refreshFile(it.key());
+        }
+        m_desktopEntries.flush();
+        
+        if (displaced.isEmpty()) {
+            QDir().rename(current.installPath, staged.stagedPath);
+        } else {
+            QString reverted;
+            if (StagingArea::swapInto(displaced, current.installPath, &reverted)) {
+                QDir().rename(reverted, staged.stagedPath);
+            }
+        }
+        
+        emit installationCompleted(false, "No se pudo registrar la actualización");
+        return false;
+    }
+    
+    log(QString("Actualización aplicada en %1 ms (versión %2)").arg(timer.elapsed()).arg(staged.record.version));
+    m_metric.version = staged.record.version;
+    m_metric.installedFiles = manifest.size();
+    foreach (const ManifestEntry &entry, manifest) {
+        m_metric.installedBytes += entry.size;
+    }
+    
+    m_dedupStore.release(appName);
+    if (m_deduplicate) {
+        log("Deduplicando archivos compartidos con otras aplicaciones...");
+        qint64 saved = m_dedupStore.deduplicate(appName, manifest,
+                                                DedupStore::storeRootFor(QFileInfo(current.installPath).absolutePath()));
+        log("Espacio ahorrado por deduplicación: " + DiskPreflight::formatBytes(saved));
+    }
+    
+    // The old tree is already out of the way; deleting it can happen off the UI thread
+    if (!displaced.isEmpty()) {
+        QtConcurrent::run([displaced]() {
+            QDir(displaced).removeRecursively();
+        });
+    }
+    
+    // The staged tree was evicted while prefetching, the user is about to launch it
+    if (m_warmup) {
+        warmUpApp(appName);
+    }
+    
+    updateProgress(100);
+    emit installationCompleted(true, "Actualización aplicada exitosamente");
+    return true;
+}
+
+int Installer::learnWarmupProfile(const QString &appName)
+{
+    AppRecord record;
+    if (!m_registry.findApp(appName, &record)) {
+        return 0;
+    }
+    
+    QStringList learned = PageCacheWarmup::filesReadSinceInstall(record.installPath, m_registry.manifest(appName));
+    if (learned.isEmpty()) {
+        return 0;
+    }
+    
+    // Known launch files keep their launch order, the rest follow
+    QStringList profile;
+    foreach (const QString &path, PageCacheWarmup::defaultProfile(record.installPath, record.execPath)) {
+        if (learned.removeOne(path)) {
+            profile << path;
+        }
+    }
+    profile += learned;
+    
+    if (!m_registry.setWarmupProfile(appName, profile)) {
+        log("ADVERTENCIA: No se pudo guardar el perfil de arranque: " + m_registry.lastError());
+        return 0;
+    }
+    
+    log(QString("Perfil de arranque de %1: %2 archivos").arg(appName).arg(profile.size()));
+    return profile.size();
+}
+
+bool Installer::warmUpApp(const QString &appName, bool wait)
+{
+    AppRecord record;
+    if (!m_registry.findApp(appName, &record)) {
+        log("ERROR: Aplicación no encontrada en los registros: " + appName);
+        return false;
+    }
+    
+    QStringList profile = m_registry.warmupProfile(appName);
+    if (profile.isEmpty()) {
+        profile = PageCacheWarmup::defaultProfile(record.installPath, record.execPath);
+    }
+    
+    log(QString("Precargando %1 archivos de arranque de %2...").arg(profile.size()).arg(appName));
+    
+    QString installDir = record.installPath;
+    if (!wait) {
+        QtConcurrent::run([installDir, profile]() {
+            PageCacheWarmup::prefetch(installDir, profile);
+        });
+        return true;
+    }
+    
+    WarmupResult result = PageCacheWarmup::prefetch(installDir, profile);
+    log(QString("Precargados %1 archivos (%2)").arg(result.files).arg(DiskPreflight::formatBytes(result.bytes)));
+    return true;
+}
+
 void Installer::onDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
+    Trace::counter("download_bytes", bytesReceived);
+    
+    if (m_activity == Staging) {
+        return;
+    }
+    
     if (bytesTotal > 0) {
         int progress = static_cast<int>((bytesReceived * 50) / bytesTotal);
         updateProgress(progress);
@@ -336,8 +1324,10 @@ void Installer::onDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
     }
 }
 
-bool Installer::extractTarball(const QString &tarballPath, const QString &destPath)
+bool Installer::extractTarball(const QString &tarballPath, const QString &destPath, QByteArray *sha256,
+                               ExtractedFiles *extracted)
 {
+    TRACE_SCOPE("extract");
     log("Extrayendo tarball...");
     
     // First, verify the tarball exists and is readable
@@ -359,31 +1349,115 @@ bool Installer::extractTarball(const QString &tarballPath, const QString &destPa
     QStringList beforeContents = destDir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot);
     log("Contenido antes de extracción: " + QString::number(beforeContents.size()) + " elementos");
     
-    QProcess process;
+    // Zip has a central directory, so it is inflated here in parallel instead of through tar
+    if (tarballPath.endsWith(".zip", Qt::CaseInsensitive)) {
+        return extractZip(tarballPath, destPath, sha256, extracted) && checkExtractedContents(destPath);
+    }
+    
+    // Offsets of an uncompressed tar are known after one header pass, so its
+    // bodies are copied in the kernel, in parallel
+    if (tarballPath.endsWith(".tar")) {
+        return extractPlainTar(tarballPath, destPath, sha256, extracted) && checkExtractedContents(destPath);
+    }
+    
+    IoPolicy policy = activeIoPolicy();
+    ThrottledProcess process(policy);
     QStringList arguments;
     
-    // Build command based on file extension
+    // Build command based on file extension. The archive is streamed through
+    // stdin so it can be hashed in the same pass as extraction.
     if (tarballPath.endsWith(".tar.gz") || tarballPath.endsWith(".tgz")) {
-        arguments << "-xzf" << tarballPath << "-C" << destPath;
+        arguments << "-xzf" << "-" << "-C" << destPath;
     } else if (tarballPath.endsWith(".tar.bz2") || tarballPath.endsWith(".tbz2")) {
-        arguments << "-xjf" << tarballPath << "-C" << destPath;
+        arguments << "-xjf" << "-" << "-C" << destPath;
     } else if (tarballPath.endsWith(".tar.xz")) {
-        arguments << "-xJf" << tarballPath << "-C" << destPath;
-    } else if (tarballPath.endsWith(".tar")) {
-        arguments << "-xf" << tarballPath << "-C" << destPath;
+        arguments << "-xJf" << "-" << "-C" << destPath;
+    } else if (tarballPath.endsWith(".tar.zst") || tarballPath.endsWith(".tzst")) {
+        arguments << "-I" << "zstd" << "-xf" << "-" << "-C" << destPath;
     } else {
         log("ERROR: Formato de tarball no soportado: " + tarballPath);
         return false;
     }
     
-    log("Ejecutando: tar " + arguments.join(" "));
+    QFile input(tarballPath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        log("ERROR: No se pudo abrir el tarball: " + tarballPath);
+        return false;
+    }
+    
+    log("Ejecutando: tar " + arguments.join(" ") + " < " + tarballPath);
+    
+    // Set up process environment
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    process.setProcessEnvironment(env);
+    
+    if (policy.idlePriority) {
+        log("Extrayendo con prioridad mínima de CPU y E/S");
+    }
+    if (policy.writeBytesPerSecond > 0) {
+        log("Límite de escritura: " + DiskPreflight::formatBytes(policy.writeBytesPerSecond) + "/s");
+    }
+    
+    // Start the process
+    process.start("tar", arguments);
+    if (!process.waitForStarted()) {
+        log("ERROR: No se pudo iniciar tar");
+        return false;
+    }
+    
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    const qint64 chunkSize = 1024 * 1024;
+    
+    // The cap applies to what tar writes out. Feeding it is the only lever,
+    // so input is held back whenever tar's writes run ahead of the budget.
+    WriteRateLimiter limiter(policy.writeBytesPerSecond);
+    double expansion = 0;
+    qint64 fed = 0;
+    
+    while (!input.atEnd()) {
+        QByteArray chunk = input.read(chunkSize);
+        if (chunk.isEmpty()) {
+            break;
+        }
+        
+        if (policy.writeBytesPerSecond > 0) {
+            qint64 written = IoThrottle::bytesWritten(process.processId());
+            if (written < 0) {
+                // No /proc/<pid>/io: assume output grows with input like the whole archive does
+                if (expansion <= 0) {
+                    expansion = qMax(1.0, double(DiskPreflight::measureArchive(tarballPath).bytes) / tarballInfo.size());
+                }
+                written = qint64(fed * expansion);
+            }
+            limiter.pace(written);
+        }
+        
+        hash.addData(chunk);
+        process.write(chunk);
+        fed += chunk.size();
+        Trace::counter("archive_bytes_read", fed);
+        
+        // Keep at most a few chunks queued in memory
+        while (process.bytesToWrite() > 4 * chunkSize) {
+            if (!process.waitForBytesWritten(300000)) {
+                break;
+            }
+        }
+        
+        if (process.state() != QProcess::Running) {
+            break;
+        }
+    }
     
-    // Set up process environment
-    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-    process.setProcessEnvironment(env);
+    process.closeWriteChannel();
+    if (policy.dropCache) {
+        ::posix_fadvise(input.handle(), 0, 0, POSIX_FADV_DONTNEED);
+    }
+    input.close();
     
-    // Start the process
-    process.start("tar", arguments);
+    if (sha256) {
+        *sha256 = hash.result().toHex();
+    }
     
     // Wait for completion with timeout
     if (!process.waitForFinished(300000)) { // 5 minutes timeout
@@ -402,6 +1476,13 @@ bool Installer::extractTarball(const QString &tarballPath, const QString &destPa
         return false;
     }
     
+    return checkExtractedContents(destPath);
+}
+
+bool Installer::checkExtractedContents(const QString &destPath)
+{
+    QDir destDir(destPath);
+    
     // List contents after extraction
     QStringList afterContents = destDir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot);
     log("Contenido después de extracción: " + QString::number(afterContents.size()) + " elementos");
@@ -425,22 +1506,305 @@ bool Installer::extractTarball(const QString &tarballPath, const QString &destPa
     return true;
 }
 
+bool Installer::extractZip(const QString &zipPath, const QString &destPath, QByteArray *sha256,
+                           ExtractedFiles *extracted)
+{
+    QFile input(zipPath);
+    if (!input.open(QIODevice::ReadOnly) || input.size() == 0) {
+        log("ERROR: No se pudo abrir el zip: " + zipPath);
+        return false;
+    }
+    
+    const qint64 length = input.size();
+    const uchar *data = input.map(0, length);
+    if (!data) {
+        log("ERROR: No se pudo mapear el zip en memoria: " + zipPath);
+        return false;
+    }
+    
+    QVector<ZipEntry> entries;
+    QString error;
+    if (!ZipArchive::scan(data, length, &entries, &error)) {
+        log("ERROR: " + error);
+        return false;
+    }
+    
+    // Directories first, including those only implied by file paths, so
+    // that workers never race to create a parent
+    QDir root(destPath);
+    QVector<ZipEntry> files;
+    QVector<ZipEntry> symlinks;
+    QVector<ZipEntry> directories;
+    foreach (const ZipEntry &entry, entries) {
+        QString parent = entry.type == ZipEntry::Directory ? entry.path : QFileInfo(entry.path).path();
+        if (parent != "." && !root.mkpath(parent)) {
+            log("ERROR: No se pudo crear el directorio: " + parent);
+            return false;
+        }
+        
+        if (entry.type == ZipEntry::Directory) {
+            directories.append(entry);
+        } else if (entry.type == ZipEntry::Symlink) {
+            symlinks.append(entry);
+        } else {
+            files.append(entry);
+        }
+    }
+    
+    // Largest first, so a big file started last does not leave one worker running alone
+    std::sort(files.begin(), files.end(), [](const ZipEntry &a, const ZipEntry &b) {
+        return a.size > b.size;
+    });
+    
+    log(QString("Extrayendo %1 entradas del zip").arg(entries.size()));
+    
+    // One slot per file, each written by a single worker
+    QVector<ExtractedFile> written(files.size());
+    ExtractedFile *records = extracted ? written.data() : nullptr;
+    bool ok = extractInParallel(data, length, files.size(), [&](int index, QString *entryError) {
+        return ZipArchive::extract(data, length, files.at(index), destPath, entryError,
+                                   records ? records + index : nullptr);
+    }, [&](int index) {
+        return files.at(index).size;
+    }, sha256, &error);
+    
+    if (!ok) {
+        log("ERROR: Falló la extracción del zip: " + error);
+        return false;
+    }
+    
+    if (extracted) {
+        for (int i = 0; i < files.size(); ++i) {
+            extracted->insert(files.at(i).path, written.at(i));
+        }
+    }
+    
+    foreach (const ZipEntry &entry, symlinks) {
+        if (!ZipArchive::extract(data, length, entry, destPath, &error)) {
+            log("ERROR: Falló la extracción del zip: " + error);
+            return false;
+        }
+    }
+    
+    // Deepest first: creating files above touched the mtimes of their parents
+    for (int i = directories.size() - 1; i >= 0; --i) {
+        setDirectoryAttributes(root.filePath(directories.at(i).path), directories.at(i).mode, directories.at(i).mtime);
+    }
+    
+    if (activeIoPolicy().dropCache) {
+        ::posix_fadvise(input.handle(), 0, 0, POSIX_FADV_DONTNEED);
+    }
+    
+    return true;
+}
+
+bool Installer::extractPlainTar(const QString &tarPath, const QString &destPath, QByteArray *sha256,
+                                ExtractedFiles *extracted)
+{
+    QFile input(tarPath);
+    if (!input.open(QIODevice::ReadOnly) || input.size() == 0) {
+        log("ERROR: No se pudo abrir el tarball: " + tarPath);
+        return false;
+    }
+    
+    const qint64 length = input.size();
+    const uchar *data = input.map(0, length);
+    if (!data) {
+        log("ERROR: No se pudo mapear el tarball en memoria: " + tarPath);
+        return false;
+    }
+    
+    QVector<TarEntry> entries;
+    QString error;
+    if (!TarArchive::scan(data, length, &entries, &error)) {
+        log("ERROR: " + error);
+        return false;
+    }
+    
+    // A path archived twice is extracted from its last copy, as tar would
+    QHash<QString, int> lastIndex;
+    for (int i = 0; i < entries.size(); ++i) {
+        QString path = TarArchive::safeRelativePath(entries.at(i).path);
+        if (path.isEmpty() && QDir::cleanPath(entries.at(i).path) != ".") {
+            log("ERROR: Ruta insegura en el tarball: " + entries.at(i).path);
+            return false;
+        }
+        lastIndex.insert(path, i);
+    }
+    
+    QDir root(destPath);
+    QVector<TarEntry> files;
+    QVector<TarEntry> links;
+    QVector<TarEntry> directories;
+    for (int i = 0; i < entries.size(); ++i) {
+        const TarEntry &entry = entries.at(i);
+        QString path = TarArchive::safeRelativePath(entry.path);
+        if (path.isEmpty() || lastIndex.value(path) != i || entry.type == TarEntry::Other) {
+            continue;
+        }
+        
+        QString parent = entry.type == TarEntry::Directory ? path : QFileInfo(path).path();
+        if (parent != "." && !root.mkpath(parent)) {
+            log("ERROR: No se pudo crear el directorio: " + parent);
+            return false;
+        }
+        
+        if (entry.type == TarEntry::Directory) {
+            directories.append(entry);
+        } else if (entry.type == TarEntry::File) {
+            files.append(entry);
+        } else {
+            links.append(entry);
+        }
+    }
+    
+    // Largest first, so a big file started last does not leave one worker running alone
+    std::sort(files.begin(), files.end(), [](const TarEntry &a, const TarEntry &b) {
+        return a.size > b.size;
+    });
+    
+    log(QString("Extrayendo %1 entradas del tarball sin pasar por tar").arg(entries.size()));
+    
+    const int archiveFd = input.handle();
+    // One slot per file, each written by a single worker
+    QVector<ExtractedFile> written(files.size());
+    ExtractedFile *records = extracted ? written.data() : nullptr;
+    bool ok = extractInParallel(data, length, files.size(), [&](int index, QString *entryError) {
+        return TarArchive::extract(archiveFd, data, files.at(index), destPath, entryError,
+                                   records ? records + index : nullptr);
+    }, [&](int index) {
+        return files.at(index).size;
+    }, sha256, &error);
+    
+    if (!ok) {
+        log("ERROR: Falló la extracción del tarball: " + error);
+        return false;
+    }
+    
+    if (extracted) {
+        for (int i = 0; i < files.size(); ++i) {
+            extracted->insert(TarArchive::safeRelativePath(files.at(i).path), written.at(i));
+        }
+    }
+    
+    // Hardlinks need their targets, symlinks must not redirect the writes above
+    foreach (const TarEntry &entry, links) {
+        if (!TarArchive::extract(archiveFd, data, entry, destPath, &error)) {
+            log("ERROR: Falló la extracción del tarball: " + error);
+            return false;
+        }
+    }
+    
+    // Deepest first: creating files above touched the mtimes of their parents
+    for (int i = directories.size() - 1; i >= 0; --i) {
+        const TarEntry &entry = directories.at(i);
+        setDirectoryAttributes(root.filePath(TarArchive::safeRelativePath(entry.path)), entry.mode, entry.mtime);
+    }
+    
+    if (activeIoPolicy().dropCache) {
+        ::posix_fadvise(archiveFd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    
+    return true;
+}
+
+bool Installer::extractInParallel(const uchar *data, qint64 length, int count,
+                                  const std::function<bool(int, QString *)> &extractEntry,
+                                  const std::function<qint64(int)> &entrySize,
+                                  QByteArray *sha256, QString *error)
+{
+    IoPolicy policy = activeIoPolicy();
+    WriteRateLimiter limiter(policy.writeBytesPerSecond);
+    
+    // A throttled install uses a single worker at idle priority. The pool is
+    // private so that the lowered priority dies with its threads.
+    QThreadPool pool;
+    pool.setMaxThreadCount(policy.isThrottled() ? 1 : QThread::idealThreadCount());
+    log(QString("Extrayendo con %1 hilos").arg(pool.maxThreadCount()));
+    
+    QAtomicInt next(0);
+    QAtomicInt failed(0);
+    QMutex errorMutex;
+    
+    auto worker = [&]() {
+        TRACE_SCOPE("extract_worker");
+        if (policy.idlePriority) {
+            IoThrottle::lowerPriority(0);
+        }
+        
+        for (int i = next.fetchAndAddRelaxed(1); i < count && !failed.loadAcquire(); i = next.fetchAndAddRelaxed(1)) {
+            QString entryError;
+            if (!extractEntry(i, &entryError)) {
+                QMutexLocker locker(&errorMutex);
+                if (!failed.loadAcquire()) {
+                    *error = entryError;
+                }
+                failed.storeRelease(1);
+                return;
+            }
+            
+            if (policy.writeBytesPerSecond > 0) {
+                limiter.consume(entrySize(i));
+            }
+        }
+    };
+    
+    for (int i = 0; i < pool.maxThreadCount(); ++i) {
+        QtConcurrent::run(&pool, worker);
+    }
+    
+    // Hash on a pool thread while the workers extract, the pages are shared.
+    // The task also outlives the workers, so its future finishing means
+    // the whole extraction is done and this thread waits for one signal.
+    QFuture<QByteArray> done = QtConcurrent::run([data, length, &pool]() {
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        const qint64 chunkSize = 1024 * 1024;
+        for (qint64 offset = 0; offset < length; offset += chunkSize) {
+            hash.addData(reinterpret_cast<const char *>(data + offset), int(qMin(chunkSize, length - offset)));
+        }
+        pool.waitForDone();
+        return hash.result().toHex();
+    });
+    
+    QFutureWatcher<QByteArray> watcher;
+    QEventLoop loop;
+    connect(&watcher, &QFutureWatcher<QByteArray>::finished, &loop, &QEventLoop::quit);
+    watcher.setFuture(done);
+    if (!done.isFinished()) {
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+    }
+    
+    if (sha256) {
+        *sha256 = done.result();
+    }
+    Trace::counter("extracted_files", qMin(next.loadAcquire(), count));
+    
+    return !failed.loadAcquire();
+}
+
+void Installer::setDirectoryAttributes(const QString &path, uint mode, qint64 mtime)
+{
+    QByteArray encoded = QFile::encodeName(path);
+    struct timespec times[2];
+    times[0].tv_sec = times[1].tv_sec = time_t(mtime);
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    
+    // Owner access stays, or the tree could not be moved into place
+    ::chmod(encoded.constData(), mode | S_IRWXU);
+    ::utimensat(AT_FDCWD, encoded.constData(), times, 0);
+}
+
 bool Installer::createDesktopEntry(const QString &appName, const QString &execPath, const QString &iconPath)
 {
+    TRACE_SCOPE("desktop_entry");
     // Determine desktop path based on user privileges
-    QString desktopPath;
+    QString desktopPath = DesktopEntryWriter::applicationsDir(checkAdminPrivileges());
     if (checkAdminPrivileges()) {
-        // Running as root - use global system directory
-        desktopPath = "/usr/share/applications";
         log("Creando entrada de escritorio global en: " + desktopPath);
     } else {
-        // Running as normal user - use user directory
-        desktopPath = QStandardPaths::writableLocation(QStandardPaths::ApplicationsLocation);
         log("Creando entrada de escritorio de usuario en: " + desktopPath);
     }
     
-    QDir().mkpath(desktopPath);
-    
     QString desktopFile = desktopPath + "/" + appName + ".desktop";
     
     // Determine appropriate name and icon based on the application type
@@ -480,79 +1844,220 @@ bool Installer::createDesktopEntry(const QString &appName, const QString &execPa
         "Categories=%5\n"
         "Terminal=false\n"
         "StartupWMClass=%6\n"
-    ).arg(displayName).arg(comment).arg(execPath).arg(iconResource).arg(categories).arg(appName);
+    ).arg(displayName).arg(comment).arg(DesktopEntryWriter::quoteExec(execPath)).arg(iconResource).arg(categories).arg(appName);
+    
+    // Other launchers for the same program show up twice in menus, and a
+    // shared window class makes docks group unrelated windows
+    QString resolvedExec = DesktopEntryIndex::resolveExec(execPath);
+    foreach (const DesktopEntryInfo &other, m_desktopIndex.entriesForExec(execPath)) {
+        if (other.path != desktopFile) {
+            log("ADVERTENCIA: " + other.path + " ya abre " + execPath);
+        }
+    }
+    foreach (const DesktopEntryInfo &other, m_desktopIndex.entriesForWmClass(appName)) {
+        if (other.path != desktopFile && other.exec != resolvedExec) {
+            log("ADVERTENCIA: " + other.path + " usa la misma StartupWMClass (" + appName + ") para otro programa");
+        }
+    }
     
-    QFile file(desktopFile);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    DesktopEntryWriter::Result result = m_desktopEntries.write(desktopFile, content);
+    if (result == DesktopEntryWriter::Failed) {
         log("ERROR: No se pudo crear el archivo .desktop: " + desktopFile);
         return false;
     }
+    m_desktopIndex.refreshFile(desktopFile);
     
-    file.write(content.toUtf8());
-    file.close();
-    
-    log("Entrada de escritorio creada: " + desktopFile);
+    m_pendingArtifacts.append(InstallManifest::externalEntry(desktopFile, ManifestEntry::DesktopEntry));
+    if (result == DesktopEntryWriter::Unchanged) {
+        log("Entrada de escritorio sin cambios: " + desktopFile);
+    } else {
+        log("Entrada de escritorio creada: " + desktopFile);
+    }
     return true;
 }
 
+QString Installer::installThemeIcons(const QString &appName, const QString &installDir)
+{
+    TRACE_SCOPE("theme_icons");
+    QString sourceIcon = IconTheme::findSourceIcon(installDir, appName);
+    if (sourceIcon.isEmpty()) {
+        log("ADVERTENCIA: No se encontró un icono en la aplicación instalada");
+        return QString();
+    }
+    
+    QString themeRoot = IconTheme::themeRoot(checkAdminPrivileges());
+    log("Generando iconos a partir de " + sourceIcon + " en " + themeRoot);
+    QStringList icons = IconTheme::install(sourceIcon, appName, themeRoot);
+    if (icons.isEmpty()) {
+        log("ADVERTENCIA: No se pudieron generar los iconos de la aplicación");
+        return QString();
+    }
+    
+    foreach (const QString &icon, icons) {
+        m_pendingArtifacts.append(InstallManifest::externalEntry(icon, ManifestEntry::ThemeIcon));
+    }
+    IconTheme::refreshCache(themeRoot);
+    
+    log(QString("Iconos instalados: %1 tamaños").arg(icons.size()));
+    return appName;
+}
+
 bool Installer::createSymlink(const QString &targetPath, const QString &linkName)
 {
+    TRACE_SCOPE("symlink");
     QFile::remove(linkName);
     
     return QFile::link(targetPath, linkName);
 }
 
 bool Installer::registerApp(const QString &appName, const QString &version, const QString &installPath,
-                           const QString &sourceUrl, const QString &execPath)
+                           const QString &sourceUrl, const QString &execPath,
+                           const QVector<ManifestEntry> &manifest)
 {
-    QSqlQuery query(m_db);
-    
-    query.prepare("INSERT OR REPLACE INTO installed_apps "
-                  "(app_name, version, install_path, source_url, exec_path, install_date) "
-                  "VALUES (?, ?, ?, ?, ?, ?)");
-    
-    query.addBindValue(appName);
-    query.addBindValue(version);
-    query.addBindValue(installPath);
-    query.addBindValue(sourceUrl);
-    query.addBindValue(execPath);
-    query.addBindValue(QDateTime::currentDateTime().toString(Qt::ISODate));
+    TRACE_SCOPE("db_register");
+    AppRecord record = m_currentSource;
+    record.appName = appName;
+    record.version = version;
+    record.installPath = installPath;
+    record.sourceUrl = sourceUrl;
+    record.execPath = execPath;
+    
+    if (!m_registry.registerApp(record, manifest)) {
+        log("ERROR: " + m_registry.lastError());
+        return false;
+    }
     
-    return query.exec();
+    return true;
 }
 
-bool Installer::downloadFile(const QUrl &url, const QString &destPath)
+bool Installer::downloadFile(const QUrl &url, const QString &destPath, QByteArray *sha256)
 {
+    TRACE_SCOPE("download");
+    QFile file(destPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        log("ERROR: No se pudo crear el archivo de destino");
+        return false;
+    }
+    
     QNetworkAccessManager manager;
     QNetworkRequest request(url);
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
     QNetworkReply *reply = manager.get(request);
     
+    // Write and hash the payload as it arrives instead of buffering it whole,
+    // and index it on the way so single files can be read from it later
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QScopedPointer<ArchiveIndexBuilder> indexBuilder(ArchiveIndex::canIndex(destPath) ? new ArchiveIndexBuilder : nullptr);
+    QFile::remove(ArchiveIndex::indexPathFor(destPath));
+    bool writeFailed = false;
+    auto drain = [reply, &file, &hash, &indexBuilder, &writeFailed]() {
+        QByteArray chunk = reply->readAll();
+        hash.addData(chunk);
+        if (indexBuilder) {
+            indexBuilder->addData(chunk.constData(), chunk.size());
+        }
+        if (file.write(chunk) != chunk.size()) {
+            writeFailed = true;
+        }
+    };
+    
+    // Once the size is known, check that archive and tree will fit before
+    // downloading the rest
+    QString spaceError;
+    auto preflight = [this, reply, &destPath, &spaceError]() {
+        qint64 contentLength = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+        if (contentLength <= 0 || m_currentInstallPath.isEmpty() || !spaceError.isEmpty()) {
+            return;
+        }
+        
+        ArchiveFootprint footprint = DiskPreflight::estimateFromCompressedSize(contentLength, QFileInfo(destPath).fileName());
+        if (!DiskPreflight::check(footprint, QFileInfo(destPath).absolutePath(), m_currentInstallPath,
+                                  contentLength, &spaceError)) {
+            reply->abort();
+        }
+    };
+    
     QEventLoop loop;
+    connect(reply, &QNetworkReply::metaDataChanged, &loop, preflight);
+    connect(reply, &QNetworkReply::readyRead, &loop, drain);
     connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
     connect(reply, &QNetworkReply::downloadProgress, this, &Installer::onDownloadProgress);
     
     loop.exec();
+    drain();
+    file.close();
     
-    if (reply->error() != QNetworkReply::NoError) {
-        log("ERROR de descarga: " + reply->errorString());
+    if (!spaceError.isEmpty()) {
+        log("ERROR: " + spaceError);
         reply->deleteLater();
         return false;
     }
     
-    QFile file(destPath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        log("ERROR: No se pudo crear el archivo de destino");
+    if (reply->error() != QNetworkReply::NoError) {
+        log("ERROR de descarga: " + reply->errorString());
         reply->deleteLater();
         return false;
     }
     
-    file.write(reply->readAll());
-    file.close();
+    // Validators of what is being installed, the baseline for update checks
+    m_currentSource.etag = QString::fromUtf8(reply->rawHeader("ETag"));
+    m_currentSource.lastModified = QString::fromUtf8(reply->rawHeader("Last-Modified"));
+    m_currentSource.resolvedUrl = reply->url().toString();
+    m_currentSource.contentLength = file.size();
+    
     reply->deleteLater();
     
+    if (writeFailed) {
+        log("ERROR: No se pudo escribir el archivo descargado: " + file.errorString());
+        return false;
+    }
+    
+    if (sha256) {
+        *sha256 = hash.result().toHex();
+    }
+    
+    if (indexBuilder && indexBuilder->save(destPath)) {
+        log("Índice de acceso aleatorio guardado: " + ArchiveIndex::indexPathFor(destPath));
+    }
+    
     return true;
 }
 
+QByteArray Installer::fetchRemoteSha256(const QUrl &url)
+{
+    QUrl sidecarUrl = url;
+    sidecarUrl.setPath(url.path() + ".sha256");
+    
+    QNetworkAccessManager manager;
+    QNetworkRequest request(sidecarUrl);
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    QNetworkReply *reply = manager.get(request);
+    
+    QEventLoop loop;
+    connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    loop.exec();
+    
+    QByteArray digest;
+    if (reply->error() == QNetworkReply::NoError) {
+        digest = Checksum::parseSha256(reply->read(64 * 1024), url.fileName());
+        if (!digest.isEmpty()) {
+            log("Suma SHA-256 obtenida de: " + sidecarUrl.toString());
+        }
+    }
+    
+    reply->deleteLater();
+    return digest;
+}
+
+QByteArray Installer::expectedSha256For(const QString &filePath) const
+{
+    if (!m_expectedSha256.isEmpty()) {
+        return m_expectedSha256;
+    }
+    
+    return Checksum::readSidecar(filePath);
+}
+
 QString Installer::findExecutableInDirectory(const QString &dirPath)
 {
     return findExecutableInDirectoryRecursive(dirPath, 0);
@@ -574,36 +2079,31 @@ QString Installer::findExecutableInDirectoryRecursive(const QString &dirPath, in
     QStringList files = dir.entryList(QDir::Files | QDir::Executable);
     log("Archivos ejecutables en directorio: " + QString::number(files.size()));
     
+    // Same scoring as the launcher generator, so helpers such as chrome-sandbox
+    // never win over the editor just by sorting first
+    QString bestPath;
+    int bestScore = -1;
     foreach (const QString &file, files) {
         QString filePath = dirPath + "/" + file;
         QFileInfo fileInfo(filePath);
-        
-        // Skip some common non-application executables
-        if (file.toLower() == "sh" || file.toLower() == "bash" || 
-            file.toLower() == "chmod" || file.toLower() == "ln") {
+        if (!fileInfo.isFile() || !fileInfo.isExecutable()) {
             continue;
         }
         
         log("Archivo ejecutable encontrado: " + filePath);
         
-        // Check if it's a binary file (not a script)
-        if (fileInfo.isFile() && fileInfo.isExecutable()) {
-            // Additional check: see if it's a binary (ELF) or a script
-            QFile execFile(filePath);
-            if (execFile.open(QIODevice::ReadOnly)) {
-                QByteArray header = execFile.read(4);
-                execFile.close();
-                
-                // ELF files start with 0x7F 'ELF'
-                QByteArray elfHeader = QByteArray::fromHex("7F454C46");
-                if (header.startsWith(elfHeader) || header.startsWith("#!")) {
-                    log("Ejecutable válido encontrado: " + filePath);
-                    return filePath;
-                }
-            }
+        int score = AppDiscovery::score(filePath, AppDiscovery::classify(filePath), dirPath, 0);
+        if (score > bestScore) {
+            bestScore = score;
+            bestPath = filePath;
         }
     }
     
+    if (!bestPath.isEmpty()) {
+        log("Ejecutable válido encontrado: " + bestPath);
+        return bestPath;
+    }
+    
     // If no executables found and we haven't reached max depth, check subdirectories
     if (files.isEmpty() && depth < MAX_DEPTH) {
         QStringList subdirs = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
@@ -650,6 +2150,21 @@ QString Installer::getAppNameFromPath(const QString &execPath)
     return appName;
 }
 
+QString Installer::versionFromArchive(const QString &archivePath) const
+{
+    ArchiveIndex index;
+    if (!index.load(archivePath)) {
+        return QString();
+    }
+    
+    QByteArray packageJson;
+    if (!index.read(index.find("resources/app/package.json"), &packageJson, 1024 * 1024)) {
+        return QString();
+    }
+    
+    return QJsonDocument::fromJson(packageJson).object().value("version").toString();
+}
+
 QString Installer::getVersionFromExecutable(const QString &execPath)
 {
     QProcess process;
@@ -688,33 +2203,148 @@ QString Installer::getVersionFromExecutable(const QString &execPath)
     return "Desconocida";
 }
 
-bool Installer::initializeDatabase()
+void Installer::initializeDatabase()
 {
-    m_db = QSqlDatabase::addDatabase("QSQLITE");
     QString dbPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
     QDir().mkpath(dbPath);
-    m_db.setDatabaseName(dbPath + "/apps.db");
     
-    if (!m_db.open()) {
-        log("ERROR: No se pudo abrir la base de datos");
+    // Opening and migrating is left to whatever needs the registry first,
+    // or to openDatabase() once the window is up
+    m_registry.openOnFirstUse(dbPath + "/apps.db", [this]() {
+        reclaimInterruptedInstalls();
+    });
+}
+
+bool Installer::openDatabase()
+{
+    if (!m_registry.ensureOpen()) {
+        log("ERROR: " + m_registry.lastError());
+        return false;
+    }
+    return true;
+}
+
+int Installer::reclaimInterruptedInstalls()
+{
+    QString tempRoot = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
+    int reclaimed = m_journal.sweep(tempRoot, downloadCacheDir()) + m_archiveCache.sweep();
+    if (reclaimed > 0) {
+        log(QString("Eliminados %1 restos de instalaciones interrumpidas").arg(reclaimed));
+    }
+    return reclaimed;
+}
+
+QString Installer::downloadCacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/downloads";
+}
+
+bool Installer::findCachedArchive(const QString &filePath, CachedArchive *cached)
+{
+    // Hashing is only worth it when a cached archive has the same size
+    if (!m_archiveCache.hasCandidate(QFileInfo(filePath).size())) {
+        return false;
+    }
+    
+    return m_archiveCache.find(InstallManifest::hashFile(filePath), cached);
+}
+
+void Installer::cacheArchive(const QString &archivePath, const QByteArray &sha256, const QString &appName)
+{
+    CachedArchive existing;
+    if (sha256.isEmpty() || m_cachingArchives.contains(archivePath) || m_archiveCache.find(sha256, &existing)) {
+        return;
+    }
+    
+    log("Preparando en segundo plano una copia rápida del paquete para reinstalaciones");
+    m_cachingArchives << archivePath;
+    
+    auto *watcher = new QFutureWatcher<CachedArchive>(this);
+    connect(watcher, &QFutureWatcher<CachedArchive>::finished, this, [this, watcher, archivePath, appName]() {
+        CachedArchive cached = watcher->result();
+        watcher->deleteLater();
+        m_cachingArchives.removeAll(archivePath);
+        
+        if (cached.path.isEmpty()) {
+            log("ADVERTENCIA: No se pudo preparar la copia rápida de " + archivePath);
+        } else {
+            cached.appName = appName;
+            if (m_archiveCache.add(cached)) {
+                log(QString("Copia rápida guardada (%1, %2)").arg(cached.format, DiskPreflight::formatBytes(cached.size)));
+            }
+        }
+        
+        // Our own download was only kept for the encoder
+        if (archivePath.startsWith(downloadCacheDir() + "/")) {
+            QFile::remove(archivePath);
+            QFile::remove(Checksum::sidecarPath(archivePath));
+            QFile::remove(ArchiveIndex::indexPathFor(archivePath));
+        }
+        
+        if (m_cachingArchives.isEmpty()) {
+            emit archiveCacheIdle();
+        }
+    });
+    watcher->setFuture(QtConcurrent::run(&ArchiveCache::encode, archivePath, sha256));
+}
+
+void Installer::waitForArchiveCache()
+{
+    if (m_cachingArchives.isEmpty()) {
+        return;
+    }
+    
+    // Results are stored by the watchers' handlers, which run on this thread
+    QEventLoop loop;
+    connect(this, &Installer::archiveCacheIdle, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+bool Installer::beginMetric(const QString &source)
+{
+    // An install from a URL goes on as a local one; the outer call records both
+    if (m_recordingMetric) {
         return false;
     }
     
-    QSqlQuery query(m_db);
-    QString createTable = R"(
-        CREATE TABLE IF NOT EXISTS installed_apps (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            app_name TEXT UNIQUE NOT NULL,
-            version TEXT,
-            install_path TEXT NOT NULL,
-            source_url TEXT,
-            exec_path TEXT,
-            install_date TEXT,
-            created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
-        )
-    )";
+    m_recordingMetric = true;
+    m_metric = InstallMetric();
+    m_metric.source = source;
+    m_phaseTimings.clear();
+    Trace::collect(&m_phaseTimings);
+    return true;
+}
+
+void Installer::finishMetric(bool success)
+{
+    Trace::collect(nullptr);
+    m_recordingMetric = false;
+    
+    // A failure before the executable was found belongs to no app
+    if (m_metric.appName.isEmpty()) {
+        return;
+    }
     
-    return query.exec(createTable);
+    m_metric.success = success;
+    m_metric.phaseNs = m_phaseTimings.durations();
+    if (!m_metrics.record(m_metric)) {
+        log("ADVERTENCIA: No se pudieron guardar las métricas de la instalación");
+    }
+}
+
+QVector<PhaseStats> Installer::installStats(const QStringList &appNames)
+{
+    return m_metrics.phaseStats(appNames);
+}
+
+DesktopEntryIndex *Installer::desktopEntryIndex()
+{
+    return &m_desktopIndex;
+}
+
+bool Installer::exportInstallMetrics(const QString &path, const QStringList &appNames)
+{
+    return m_metrics.writePrometheus(path, appNames);
 }
 
 void Installer::log(const QString &message)
@@ -758,6 +2388,11 @@ bool Installer::restartWithAdminPrivileges(const QStringList &args)
 
 bool Installer::checkDependencies()
 {
+    // Nothing uninstalls tar while we run; one probe per process is enough
+    if (m_dependenciesChecked) {
+        return true;
+    }
+    
     log("Verificando dependencias del sistema...");
     
     // Check for tar command
@@ -775,10 +2410,12 @@ bool Installer::checkDependencies()
     }
     
     log("Dependencias verificadas correctamente");
+    m_dependenciesChecked = true;
     return true;
 }
 
-bool Installer::copyDirectoryRecursively(const QString &sourcePath, const QString &destPath)
+bool Installer::copyDirectoryRecursively(const QString &sourcePath, const QString &destPath,
+                                         WriteRateLimiter *limiter)
 {
     log("Iniciando copia recursiva de " + sourcePath + " a " + destPath);
     
@@ -812,7 +2449,7 @@ bool Installer::copyDirectoryRecursively(const QString &sourcePath, const QStrin
         
         if (fileInfo.isDir()) {
             // Recursively copy subdirectory
-            if (!copyDirectoryRecursively(sourceEntry, destEntry)) {
+            if (!copyDirectoryRecursively(sourceEntry, destEntry, limiter)) {
                 log("ERROR: Falló copia de subdirectorio: " + sourceEntry);
                 return false;
             }
@@ -825,7 +2462,11 @@ bool Installer::copyDirectoryRecursively(const QString &sourcePath, const QStrin
                 QFile::remove(destEntry);
             }
             
-            if (!QFile::copy(sourceEntry, destEntry)) {
+            IoPolicy policy = activeIoPolicy();
+            bool copied = policy.isThrottled()
+                ? IoThrottle::copyFile(sourceEntry, destEntry, policy, limiter)
+                : QFile::copy(sourceEntry, destEntry);
+            if (!copied) {
                 log("ERROR: Falló copia de archivo: " + sourceEntry);
                 return false;
             }
@@ -4,9 +4,20 @@
 #include <QObject>
 #include <QString>
 #include <QUrl>
-#include <QSqlDatabase>
 #include <QProgressBar>
 #include <QTextEdit>
+#include <functional>
+#include "InstallManifest.h"
+#include "AppRegistry.h"
+#include "DedupStore.h"
+#include "UpdateChecker.h"
+#include "IoThrottle.h"
+#include "InstallJournal.h"
+#include "ArchiveCache.h"
+#include "InstallMetrics.h"
+#include "DesktopEntryWriter.h"
+#include "DesktopEntryIndex.h"
+#include "Trace.h"
 
 class Installer : public QObject
 {
@@ -18,6 +29,15 @@ public:
 
     void setProgressBar(QProgressBar *bar);
     void setLogTextEdit(QTextEdit *textEdit);
+    // Expected SHA-256 of the next archive; overrides any vendor .sha256 sidecar
+    void setExpectedSha256(const QString &checksum);
+    // Share identical files with other installed apps through the dedup store;
+    // hard links are only used where reflinks are not supported if allowed
+    void setDeduplicationEnabled(bool enabled, bool allowHardlinks = false);
+    // Priority, write cap and cache behaviour of extraction and copies
+    void setIoPolicy(const IoPolicy &policy);
+    // Read the files needed to start the app into memory after installing it
+    void setWarmupEnabled(bool enabled);
 
     bool installFromLocalFile(const QString &filePath, const QString &installPath,
                              bool createDesktop, bool createSymlink);
@@ -28,8 +48,55 @@ public:
                           const QString &installPath, bool isUrl);
     
     QStringList getInstalledApps() const;
+    // Rows of the installed apps dashboard
+    QVector<InstalledAppStatus> installedAppStatus();
+    bool recordDiskUsage(const QString &appName, qint64 bytes, qint64 stamp);
     bool removeApp(const QString &appName);
     
+    // Checks installed trees against their manifests. An empty list verifies
+    // every registered app. Returns true when nothing was found altered.
+    bool verifyInstalledApps(const QStringList &appNames = QStringList(), bool full = false);
+    
+    DedupReport deduplicationReport();
+    
+    // Asks the origin of every app installed from a URL whether a newer
+    // payload exists, without downloading it. Emits updateCheckCompleted.
+    void checkForUpdates();
+    QStringList appsWithUpdates() const;
+    // URL to reinstall from: the stored source, which for "latest" links
+    // resolves to the newest version
+    QString updateSourceFor(const QString &appName) const;
+    
+    // Downloads, verifies and extracts the next version of apps with a known
+    // update into the staging area, at low priority and only while the
+    // system is idle, so that updating is just a swap of directories.
+    void setPrefetchEnabled(bool enabled);
+    void prefetchPendingUpdates();
+    bool prefetchUpdate(const QString &appName);
+    bool hasStagedUpdate(const QString &appName) const;
+    bool applyStagedUpdate(const QString &appName);
+    
+    // Replaces the warmup profile with the files read since the app was
+    // installed, if any were. Returns the number of files learned.
+    int learnWarmupProfile(const QString &appName);
+    // Prefetches the app's startup files; asynchronous unless wait is set
+    bool warmUpApp(const QString &appName, bool wait = false);
+    
+    // Installs leave a fast re-encoding of their archive behind, built in
+    // the background. Blocks until the pending ones are done.
+    void waitForArchiveCache();
+    
+    // Percentiles of each phase per app, over the recorded install history
+    QVector<PhaseStats> installStats(const QStringList &appNames = QStringList());
+    // Writes the history as a Prometheus textfile for node_exporter
+    bool exportInstallMetrics(const QString &path, const QStringList &appNames = QStringList());
+    
+    // Every .desktop file on the system, shared with the launcher generator
+    DesktopEntryIndex *desktopEntryIndex();
+    
+    // The registry opens on first use; this opens it ahead of time
+    bool openDatabase();
+    
     bool checkAdminPrivileges() const;
     bool restartWithAdminPrivileges(const QStringList &args);
     bool checkDependencies();
@@ -39,33 +106,117 @@ signals:
     void logMessage(const QString &message);
     void installationCompleted(bool success, const QString &message);
     void adminPrivilegesRequired();
+    void updateCheckCompleted(const QStringList &appsWithUpdates);
+    void updateStaged(const QString &appName);
+    // The last pending archive re-encoding finished and was recorded
+    void archiveCacheIdle();
+
+private:
+    // bench/vscip_bench.cpp times the private install phases one by one
+    friend class PipelineBench;
 
 private slots:
     void onDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+    void onUpdateCheckFinished(const QVector<UpdateCheckResult> &results);
 
 private:
-    bool extractTarball(const QString &tarballPath, const QString &destPath);
+    bool installLocalFile(const QString &filePath, const QString &installPath,
+                          bool createDesktop, bool createSymlink);
+    bool installUrl(const QUrl &url, const QString &installPath,
+                    bool createDesktop, bool createSymlink);
+    bool swapInStagedUpdate(const QString &appName);
+    // Installs and prefetches share the per-payload state below and both
+    // wait in nested event loops, where a timer or a click could start the
+    // other one. Only one runs at a time, except for installs nested in
+    // another install. A refused install reports installationCompleted.
+    enum Activity { Idle, Installing, Staging };
+    bool beginActivity(Activity activity);
+    void endActivity();
+    // Starts timing the phases of an install; false if one is already timed
+    bool beginMetric(const QString &source);
+    void finishMetric(bool success);
+    // extracted, when given, receives the hash of each file written in
+    // process; the external tar fallback leaves it empty
+    bool extractTarball(const QString &tarballPath, const QString &destPath, QByteArray *sha256 = nullptr,
+                        ExtractedFiles *extracted = nullptr);
+    bool extractZip(const QString &zipPath, const QString &destPath, QByteArray *sha256,
+                    ExtractedFiles *extracted);
+    bool extractPlainTar(const QString &tarPath, const QString &destPath, QByteArray *sha256,
+                         ExtractedFiles *extracted);
+    bool extractInParallel(const uchar *data, qint64 length, int count,
+                           const std::function<bool(int, QString *)> &extractEntry,
+                           const std::function<qint64(int)> &entrySize,
+                           QByteArray *sha256, QString *error);
+    static void setDirectoryAttributes(const QString &path, uint mode, qint64 mtime);
+    bool checkExtractedContents(const QString &destPath);
     bool createDesktopEntry(const QString &appName, const QString &execPath, const QString &iconPath);
+    // Renders the tree's own icon into the hicolor theme; returns the icon name, or empty
+    QString installThemeIcons(const QString &appName, const QString &installDir);
     bool createSymlink(const QString &targetPath, const QString &linkName);
     bool registerApp(const QString &appName, const QString &version, const QString &installPath,
-                     const QString &sourceUrl, const QString &execPath);
-    bool downloadFile(const QUrl &url, const QString &destPath);
+                     const QString &sourceUrl, const QString &execPath,
+                     const QVector<ManifestEntry> &manifest);
+    bool downloadFile(const QUrl &url, const QString &destPath, QByteArray *sha256 = nullptr);
+    QByteArray fetchRemoteSha256(const QUrl &url);
+    QByteArray expectedSha256For(const QString &filePath) const;
+    bool stageUpdate(const AppRecord &record, const QString &installPath, const QString &stagedTree);
+    void discardStagedUpdate(const QString &appName);
+    void schedulePrefetch(int msecs);
+    bool extractToStaging(const QString &filePath, const QString &installPath,
+                          JournalEntry *journal, QString *stagingDir, ExtractedFiles *extracted);
+    bool canResumeExtraction(const JournalEntry &journal, const QString &filePath) const;
+    int reclaimInterruptedInstalls();
+    static QString downloadCacheDir();
+    bool findCachedArchive(const QString &filePath, CachedArchive *cached);
+    void cacheArchive(const QString &archivePath, const QByteArray &sha256, const QString &appName);
     QString findExecutableInDirectory(const QString &dirPath);
     QString findExecutableInDirectoryRecursive(const QString &dirPath, int depth);
     QString getAppNameFromPath(const QString &path);
     QString getVersionFromExecutable(const QString &execPath);
+    QString versionFromArchive(const QString &archivePath) const;
     
-    bool initializeDatabase();
+    void initializeDatabase();
     void log(const QString &message);
     void updateProgress(int value);
     bool needsAdminPrivileges(const QString &installPath, bool createSymlink) const;
-    bool copyDirectoryRecursively(const QString &sourcePath, const QString &destPath);
+    bool copyDirectoryRecursively(const QString &sourcePath, const QString &destPath,
+                                  WriteRateLimiter *limiter = nullptr);
+    IoPolicy activeIoPolicy() const;
     mutable QString m_tempLogBuffer;
 
-    QSqlDatabase m_db;
+    // Mutable because lookups reuse cached prepared statements
+    mutable AppRegistry m_registry;
     QProgressBar *m_progressBar;
     QTextEdit *m_logTextEdit;
+    DedupStore m_dedupStore;
+    bool m_deduplicate;
+    InstallJournal m_journal;
+    ArchiveCache m_archiveCache;
+    InstallMetrics m_metrics;
+    // The install being timed, and its spans as Trace reports them
+    InstallMetric m_metric;
+    PhaseTimings m_phaseTimings;
+    bool m_recordingMetric;
+    // Archives being re-encoded for the cache; not to be deleted yet
+    QStringList m_cachingArchives;
+    IoPolicy m_ioPolicy;
+    bool m_warmup;
     QString m_currentDownloadPath;
+    QString m_currentInstallPath;
+    QVector<ManifestEntry> m_pendingArtifacts;
+    // Menu entries written since the menu databases were last refreshed
+    DesktopEntryWriter m_desktopEntries;
+    DesktopEntryIndex m_desktopIndex;
+    QByteArray m_expectedSha256;
+    // Source URL and HTTP validators of the payload being installed
+    AppRecord m_currentSource;
+    UpdateChecker *m_updateChecker;
+    bool m_prefetchEnabled;
+    bool m_prefetchScheduled;
+    // Staging is work done on behalf of a prefetch: low priority, no progress bar
+    Activity m_activity;
+    int m_activityDepth;
+    bool m_dependenciesChecked;
 };
 
 #endif // INSTALLER_H
@@ -0,0 +1,169 @@
+#include "IoThrottle.h"
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QFile>
+#include <QThread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// From linux/ioprio.h, which is not installed everywhere
+#define VSCIP_IOPRIO_CLASS_SHIFT 13
+#define VSCIP_IOPRIO_CLASS_IDLE 3
+#define VSCIP_IOPRIO_WHO_PROCESS 1
+
+namespace {
+
+// Lowest CPU priority; leaves room for nothing else to yield to us
+const int IDLE_NICE = 19;
+
+void dropFileCache(int fd)
+{
+    // DONTNEED only evicts clean pages, so write them back first
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+} // namespace
+
+IoPolicy IoPolicy::background()
+{
+    IoPolicy policy;
+    policy.idlePriority = true;
+    policy.dropCache = true;
+    return policy;
+}
+
+ThrottledProcess::ThrottledProcess(const IoPolicy &policy, QObject *parent)
+    : QProcess(parent)
+    , m_policy(policy)
+{
+}
+
+void ThrottledProcess::setupChildProcess()
+{
+    if (m_policy.idlePriority) {
+        IoThrottle::lowerPriority(0);
+    }
+}
+
+WriteRateLimiter::WriteRateLimiter(qint64 bytesPerSecond)
+    : m_bytesPerSecond(bytesPerSecond)
+    , m_consumed(0)
+{
+    m_timer.start();
+}
+
+void WriteRateLimiter::pace(qint64 totalWritten)
+{
+    if (m_bytesPerSecond <= 0) {
+        return;
+    }
+
+    const qint64 burst = m_bytesPerSecond / 4;
+    for (;;) {
+        qint64 budget = m_bytesPerSecond * m_timer.elapsed() / 1000 + burst;
+        if (totalWritten <= budget) {
+            return;
+        }
+
+        // Sleep in short slices so the UI keeps repainting
+        qint64 waitMs = (totalWritten - budget) * 1000 / m_bytesPerSecond + 1;
+        QThread::msleep(static_cast<unsigned long>(qMin<qint64>(waitMs, 100)));
+        QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+    }
+}
+
+void WriteRateLimiter::consume(qint64 bytes)
+{
+    m_consumed += bytes;
+    pace(m_consumed);
+}
+
+bool IoThrottle::lowerPriority(qint64 pid)
+{
+    // On Linux both calls act on a single thread when pid is 0, which is
+    // exactly the child between fork() and exec()
+    bool ok = ::setpriority(PRIO_PROCESS, static_cast<id_t>(pid), IDLE_NICE) == 0;
+
+#ifdef SYS_ioprio_set
+    int ioprio = VSCIP_IOPRIO_CLASS_IDLE << VSCIP_IOPRIO_CLASS_SHIFT;
+    ok = ::syscall(SYS_ioprio_set, VSCIP_IOPRIO_WHO_PROCESS, static_cast<int>(pid), ioprio) == 0 && ok;
+#endif
+
+    return ok;
+}
+
+qint64 IoThrottle::bytesWritten(qint64 pid)
+{
+    QFile io(QString("/proc/%1/io").arg(pid));
+    if (!io.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+
+    // wchar counts what write() accepted; write_bytes only moves at writeback
+    foreach (const QByteArray &line, io.readAll().split('\n')) {
+        if (line.startsWith("wchar:")) {
+            bool ok = false;
+            qint64 bytes = line.mid(6).trimmed().toLongLong(&ok);
+            return ok ? bytes : -1;
+        }
+    }
+    return -1;
+}
+
+void IoThrottle::dropCache(const QString &root)
+{
+    QDirIterator it(root, QDir::Files | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QByteArray path = QFile::encodeName(it.next());
+
+        int fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NOATIME);
+        if (fd < 0) {
+            // O_NOATIME is refused on files we do not own
+            fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        }
+        if (fd < 0) {
+            continue;
+        }
+
+        dropFileCache(fd);
+        ::close(fd);
+    }
+}
+
+bool IoThrottle::copyFile(const QString &sourcePath, const QString &destPath,
+                          const IoPolicy &policy, WriteRateLimiter *limiter)
+{
+    QFile source(sourcePath);
+    QFile dest(destPath);
+    if (!source.open(QIODevice::ReadOnly) || !dest.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    const qint64 chunkSize = 1024 * 1024;
+    while (!source.atEnd()) {
+        QByteArray chunk = source.read(chunkSize);
+        if (chunk.isEmpty() || dest.write(chunk) != chunk.size()) {
+            return false;
+        }
+
+        if (limiter) {
+            limiter->consume(chunk.size());
+        }
+    }
+
+    if (!dest.flush()) {
+        return false;
+    }
+
+    if (policy.dropCache) {
+        dropFileCache(dest.handle());
+        ::posix_fadvise(source.handle(), 0, 0, POSIX_FADV_DONTNEED);
+    }
+
+    dest.setPermissions(source.permissions());
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef IOTHROTTLE_H
+#define IOTHROTTLE_H
+
+#include <QProcess>
+#include <QString>
+#include <QElapsedTimer>
+
+// How much an install may get in the way of other work on the machine
+struct IoPolicy
+{
+    bool idlePriority = false;       // nice 19 and the idle I/O scheduling class
+    qint64 writeBytesPerSecond = 0;  // Cap on data written, 0 for no cap
+    bool dropCache = false;          // Evict written data from the page cache
+
+    bool isThrottled() const { return idlePriority || writeBytesPerSecond > 0 || dropCache; }
+
+    // What background work such as update prefetching runs with
+    static IoPolicy background();
+};
+
+// QProcess whose child lowers its own priority between fork() and exec(),
+// so helpers it forks (gzip, xz under tar) inherit the idle class too
+class ThrottledProcess : public QProcess
+{
+    Q_OBJECT
+
+public:
+    explicit ThrottledProcess(const IoPolicy &policy, QObject *parent = nullptr);
+
+protected:
+    void setupChildProcess() override;
+
+private:
+    IoPolicy m_policy;
+};
+
+// Paces a writer to a byte rate. Allows a quarter second of burst so short
+// stalls elsewhere do not turn into lost budget. The event loop keeps
+// running while waiting, like the copy loop it is used from.
+class WriteRateLimiter
+{
+public:
+    explicit WriteRateLimiter(qint64 bytesPerSecond);
+
+    // Blocks until totalWritten bytes fit in the budget accumulated so far
+    void pace(qint64 totalWritten);
+    // Same, for callers that only know what they just wrote
+    void consume(qint64 bytes);
+
+private:
+    qint64 m_bytesPerSecond;
+    qint64 m_consumed;
+    QElapsedTimer m_timer;
+};
+
+class IoThrottle
+{
+public:
+    // Applies the idle policy to pid (0 for the calling thread). Only uses
+    // async-signal-safe calls so it can run in a freshly forked child.
+    static bool lowerPriority(qint64 pid);
+
+    // Bytes the process has passed to write(), from /proc/<pid>/io; -1 if unknown
+    static qint64 bytesWritten(qint64 pid);
+
+    // Writes back and evicts every regular file under root from the page cache
+    static void dropCache(const QString &root);
+
+    // Chunked copy that honours the write cap and cache policy
+    static bool copyFile(const QString &sourcePath, const QString &destPath,
+                         const IoPolicy &policy, WriteRateLimiter *limiter);
+};
+
+#endif // IOTHROTTLE_H
@@ -16,8 +16,15 @@
 #include <QTextStream>
 #include <QPixmap>
 #include <QFileInfo>
+#include <QDialog>
+#include <QHeaderView>
+#include <QSet>
+#include <QTableWidget>
+#include <QtConcurrent>
+#include "IconPreviewLoader.h"
+#include "DesktopEntryIndex.h"
 
-LauncherCreator::LauncherCreator(QWidget *parent)
+LauncherCreator::LauncherCreator(DesktopEntryIndex *desktopIndex, QWidget *parent)
     : QWidget(parent)
     , m_nameLineEdit(nullptr)
     , m_executableLineEdit(nullptr)
@@ -26,7 +33,9 @@ LauncherCreator::LauncherCreator(QWidget *parent)
     , m_browseIconButton(nullptr)
     , m_createButton(nullptr)
     , m_clearButton(nullptr)
+    , m_bulkButton(nullptr)
     , m_iconPreviewLabel(nullptr)
+    , m_iconPreviewLoader(new IconPreviewLoader(QSize(64, 64), this))
     , m_mimeTypeComboBox(nullptr)
     , m_developmentCheckBox(nullptr)
     , m_officeCheckBox(nullptr)
@@ -37,9 +46,22 @@ LauncherCreator::LauncherCreator(QWidget *parent)
     , m_networkCheckBox(nullptr)
     , m_gameCheckBox(nullptr)
     , m_educationCheckBox(nullptr)
+    , m_desktopIndex(desktopIndex)
+    , m_bulkScanWatcher(new QFutureWatcher<QVector<LaunchCandidate>>(this))
+    , m_cancelBulkScan(false)
 {
     setupUI();
     resetForm();
+    
+    connect(m_bulkScanWatcher, &QFutureWatcher<QVector<LaunchCandidate>>::finished,
+            this, &LauncherCreator::onBulkScanFinished);
+}
+
+LauncherCreator::~LauncherCreator()
+{
+    // The scan reads m_cancelBulkScan; it must be over before the member goes
+    m_cancelBulkScan = true;
+    m_bulkScanWatcher->waitForFinished();
 }
 
 void LauncherCreator::setupUI()
@@ -151,6 +173,9 @@ void LauncherCreator::setupUI()
     m_createButton = new QPushButton("Crear Lanzador", this);
     m_createButton->setStyleSheet("QPushButton { background-color: #4CAF50; color: white; font-weight: bold; padding: 8px 16px; }");
     m_clearButton = new QPushButton("Limpiar", this);
+    m_bulkButton = new QPushButton("Generar desde carpeta...", this);
+    m_bulkButton->setToolTip("Busca aplicaciones portables y AppImages en una carpeta y crea todos sus lanzadores");
+    buttonLayout->addWidget(m_bulkButton);
     buttonLayout->addStretch();
     buttonLayout->addWidget(m_createButton);
     buttonLayout->addWidget(m_clearButton);
@@ -163,22 +188,26 @@ void LauncherCreator::setupUI()
     connect(m_browseIconButton, &QPushButton::clicked, this, &LauncherCreator::onBrowseIconButtonClicked);
     connect(m_createButton, &QPushButton::clicked, this, &LauncherCreator::onCreateLauncherButtonClicked);
     connect(m_clearButton, &QPushButton::clicked, this, &LauncherCreator::onClearButtonClicked);
-    
-    // Icon preview update
-    connect(m_iconLineEdit, &QLineEdit::textChanged, [this](const QString &iconPath) {
-        if (!iconPath.isEmpty() && QFile::exists(iconPath)) {
-            QPixmap pixmap(iconPath);
-            if (!pixmap.isNull()) {
-                m_iconPreviewLabel->setPixmap(pixmap.scaled(64, 64, Qt::KeepAspectRatio, Qt::SmoothTransformation));
-                m_iconPreviewLabel->setText("");
-            } else {
-                m_iconPreviewLabel->setText("Icono inválido");
-            }
-        } else {
-            m_iconPreviewLabel->setText("Sin icono");
-            m_iconPreviewLabel->setPixmap(QPixmap());
-        }
+    connect(m_bulkButton, &QPushButton::clicked, this, &LauncherCreator::onBulkButtonClicked);
+    
+    // Icon preview update; decoding happens off the GUI thread once typing pauses
+    connect(m_iconLineEdit, &QLineEdit::textChanged, m_iconPreviewLoader, &IconPreviewLoader::request);
+    connect(m_iconPreviewLoader, &IconPreviewLoader::previewReady, this, &LauncherCreator::onIconPreviewReady);
+    connect(m_iconPreviewLoader, &IconPreviewLoader::previewMissing, this, [this]() {
+        m_iconPreviewLabel->setPixmap(QPixmap());
+        m_iconPreviewLabel->setText("Sin icono");
     });
+    connect(m_iconPreviewLoader, &IconPreviewLoader::previewInvalid, this, [this]() {
+        m_iconPreviewLabel->setPixmap(QPixmap());
+        m_iconPreviewLabel->setText("Icono inválido");
+    });
+}
+
+void LauncherCreator::onIconPreviewReady(const QString &path, const QPixmap &pixmap)
+{
+    Q_UNUSED(path);
+    m_iconPreviewLabel->setPixmap(pixmap);
+    m_iconPreviewLabel->setText("");
 }
 
 void LauncherCreator::onBrowseExecutableButtonClicked()
@@ -274,6 +303,161 @@ void LauncherCreator::onClearButtonClicked()
     resetForm();
 }
 
+void LauncherCreator::onBulkButtonClicked()
+{
+    QString root = QFileDialog::getExistingDirectory(this, "Seleccionar carpeta de aplicaciones", "/opt");
+    if (root.isEmpty()) {
+        return;
+    }
+    
+    m_bulkButton->setEnabled(false);
+    m_bulkButton->setText("Buscando aplicaciones...");
+    
+    // Walking thousands of directories must not block the widget
+    m_cancelBulkScan = false;
+    m_bulkScanWatcher->setFuture(QtConcurrent::run([this, root]() {
+        return AppDiscovery::scan(root, &m_cancelBulkScan);
+    }));
+}
+
+void LauncherCreator::onBulkScanFinished()
+{
+    m_bulkButton->setText("Generar desde carpeta...");
+    m_bulkButton->setEnabled(true);
+    
+    QVector<LaunchCandidate> candidates = m_bulkScanWatcher->result();
+    if (candidates.isEmpty()) {
+        QMessageBox::information(this, "Generar lanzadores", 
+            "No se encontraron ejecutables ELF ni AppImages en la carpeta seleccionada.");
+        return;
+    }
+    
+    showBulkDialog(candidates);
+}
+
+void LauncherCreator::showBulkDialog(const QVector<LaunchCandidate> &candidates)
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("Generar lanzadores");
+    dialog.resize(850, 500);
+    
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    layout->addWidget(new QLabel(QString("Se encontraron %1 aplicaciones. Revise el nombre, la categoría y el icono propuestos:")
+                                 .arg(candidates.size())));
+    
+    QTableWidget *table = new QTableWidget(candidates.size(), 4);
+    table->setHorizontalHeaderLabels(QStringList() << "Nombre" << "Categoría" << "Icono" << "Ejecutable");
+    table->verticalHeader()->hide();
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    table->horizontalHeader()->setStretchLastSection(true);
+    table->setUpdatesEnabled(false);
+    for (int row = 0; row < candidates.size(); ++row) {
+        const LaunchCandidate &candidate = candidates.at(row);
+        
+        QTableWidgetItem *name = new QTableWidgetItem(candidate.name);
+        name->setFlags(name->flags() | Qt::ItemIsUserCheckable);
+        name->setCheckState(Qt::Checked);
+        
+        // Apps that already have a launcher start unchecked
+        QVector<DesktopEntryInfo> existing = m_desktopIndex->entriesForExec(candidate.path);
+        if (!existing.isEmpty()) {
+            name->setCheckState(Qt::Unchecked);
+            name->setToolTip("Ya tiene lanzador: " + existing.first().path);
+        }
+        table->setItem(row, 0, name);
+        table->setItem(row, 1, new QTableWidgetItem(candidate.category));
+        table->setItem(row, 2, new QTableWidgetItem(candidate.icon));
+        
+        QTableWidgetItem *exec = new QTableWidgetItem(candidate.path);
+        exec->setFlags(exec->flags() & ~Qt::ItemIsEditable);
+        table->setItem(row, 3, exec);
+    }
+    table->setUpdatesEnabled(true);
+    table->resizeColumnToContents(0);
+    table->resizeColumnToContents(1);
+    layout->addWidget(table);
+    
+    QHBoxLayout *buttons = new QHBoxLayout();
+    QPushButton *createButton = new QPushButton("Crear lanzadores");
+    QPushButton *cancelButton = new QPushButton("Cancelar");
+    connect(createButton, &QPushButton::clicked, &dialog, &QDialog::accept);
+    connect(cancelButton, &QPushButton::clicked, &dialog, &QDialog::reject);
+    buttons->addStretch();
+    buttons->addWidget(createButton);
+    buttons->addWidget(cancelButton);
+    layout->addLayout(buttons);
+    
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+    
+    // Build every entry now; writing them is left to the thread pool
+    QStringList paths;
+    QStringList contents;
+    QSet<QString> usedPaths;
+    for (int row = 0; row < table->rowCount(); ++row) {
+        if (table->item(row, 0)->checkState() != Qt::Checked) {
+            continue;
+        }
+        
+        QString name = table->item(row, 0)->text().trimmed();
+        QString category = table->item(row, 1)->text().trimmed();
+        QString icon = table->item(row, 2)->text().trimmed();
+        QString exec = table->item(row, 3)->text();
+        if (name.isEmpty()) {
+            continue;
+        }
+        
+        // Two apps proposing the same name must not overwrite each other, nor an existing launcher
+        QString path = desktopFilePath(name);
+        QString resolvedExec = DesktopEntryIndex::resolveExec(exec);
+        for (int n = 2; usedPaths.contains(path)
+                        || (m_desktopIndex->contains(path) && m_desktopIndex->entry(path).exec != resolvedExec); ++n) {
+            path = desktopFilePath(name + " " + QString::number(n));
+        }
+        usedPaths.insert(path);
+        
+        paths << path;
+        contents << desktopFileContent(name, exec, icon, QStringList() << (category.isEmpty() ? "Utility" : category), QString());
+    }
+    
+    if (paths.isEmpty()) {
+        return;
+    }
+    
+    m_bulkButton->setEnabled(false);
+    m_bulkButton->setText("Creando lanzadores...");
+    
+    // One writer for the whole batch: the menu databases are refreshed once, when it goes out of scope
+    QFutureWatcher<QVector<int>> *watcher = new QFutureWatcher<QVector<int>>(this);
+    connect(watcher, &QFutureWatcher<QVector<int>>::finished, this, [this, watcher]() {
+        QVector<int> counts = watcher->result();
+        watcher->deleteLater();
+        
+        m_bulkButton->setText("Generar desde carpeta...");
+        m_bulkButton->setEnabled(true);
+        
+        QString summary = QString("Lanzadores creados: %1\nSin cambios: %2")
+                          .arg(counts.at(DesktopEntryWriter::Written))
+                          .arg(counts.at(DesktopEntryWriter::Unchanged));
+        if (counts.at(DesktopEntryWriter::Failed) > 0) {
+            summary += QString("\nNo se pudieron crear: %1").arg(counts.at(DesktopEntryWriter::Failed));
+            QMessageBox::warning(this, "Generar lanzadores", summary);
+        } else {
+            QMessageBox::information(this, "Generar lanzadores", summary);
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([paths, contents]() {
+        QVector<int> counts(3, 0);
+        DesktopEntryWriter writer;
+        for (int i = 0; i < paths.size(); ++i) {
+            counts[writer.write(paths.at(i), contents.at(i))]++;
+        }
+        writer.flush();
+        return counts;
+    }));
+}
+
 void LauncherCreator::resetForm()
 {
     m_nameLineEdit->clear();
@@ -298,20 +482,62 @@ void LauncherCreator::resetForm()
 bool LauncherCreator::createDesktopFile(const QString &name, const QString &exec, const QString &icon, 
                                        const QStringList &categories, const QString &mimeType)
 {
-    QString desktopFilePath = QStandardPaths::writableLocation(QStandardPaths::ApplicationsLocation) + "/" + name.toLower().replace(" ", "-") + ".desktop";
+    QString path = desktopFilePath(name);
+    
+    // Writing used to replace whatever had the same file name without a word
+    QStringList conflicts;
+    QString resolvedExec = DesktopEntryIndex::resolveExec(exec);
+    if (m_desktopIndex->contains(path)) {
+        DesktopEntryInfo existing = m_desktopIndex->entry(path);
+        if (existing.exec != resolvedExec) {
+            conflicts << QString("Se reemplazará %1, que abre %2.").arg(path, existing.exec);
+        }
+    }
+    foreach (const DesktopEntryInfo &other, m_desktopIndex->entriesForExec(exec)) {
+        if (other.path != path) {
+            conflicts << QString("«%1» (%2) ya abre este ejecutable.").arg(other.name, other.path);
+        }
+    }
+    foreach (const DesktopEntryInfo &other, m_desktopIndex->entriesNamed(name)) {
+        if (other.path != path && other.exec != resolvedExec) {
+            conflicts << QString("%1 ya usa el nombre «%2» para otro programa.").arg(other.path, other.name);
+        }
+    }
+    
+    if (!conflicts.isEmpty()) {
+        QMessageBox::StandardButton answer = QMessageBox::question(this, "Lanzador existente",
+            conflicts.join("\n") + "\n\n¿Crear el lanzador de todos modos?");
+        if (answer != QMessageBox::Yes) {
+            return false;
+        }
+    }
     
-    QFile desktopFile(desktopFilePath);
-    if (!desktopFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    QString content = desktopFileContent(name, exec, icon, categories, mimeType);
+    if (m_desktopEntries.write(path, content) == DesktopEntryWriter::Failed) {
         QMessageBox::critical(this, "Error", "No se pudo crear el archivo .desktop.");
         return false;
     }
     
-    QTextStream out(&desktopFile);
+    m_desktopIndex->refreshFile(path);
+    m_desktopEntries.flush();
+    return true;
+}
+
+QString LauncherCreator::desktopFilePath(const QString &name)
+{
+    return DesktopEntryWriter::applicationsDir(false) + "/" + name.toLower().replace(" ", "-") + ".desktop";
+}
+
+QString LauncherCreator::desktopFileContent(const QString &name, const QString &exec, const QString &icon,
+                                            const QStringList &categories, const QString &mimeType)
+{
+    QString content;
+    QTextStream out(&content);
     out << "[Desktop Entry]\n";
     out << "Version=1.0\n";
     out << "Type=Application\n";
     out << "Name=" << name << "\n";
-    out << "Exec=" << exec << "\n";
+    out << "Exec=" << DesktopEntryWriter::quoteExec(exec) << "\n";
     
     if (!icon.isEmpty()) {
         out << "Icon=" << icon << "\n";
@@ -324,9 +550,9 @@ bool LauncherCreator::createDesktopFile(const QString &name, const QString &exec
     if (!mimeType.isEmpty()) {
         out << "MimeType=" << mimeType << "\n";
     }
+    out.flush();
     
-    desktopFile.close();
-    return true;
+    return content;
 }
 
 QString LauncherCreator::getSelectedCategories() const
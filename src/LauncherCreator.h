@@ -3,32 +3,49 @@
 
 #include <QWidget>
 #include <QIcon>
+#include <QFutureWatcher>
+#include <QVector>
+#include <atomic>
+#include "DesktopEntryWriter.h"
+#include "AppDiscovery.h"
 
 class QLineEdit;
 class QPushButton;
 class QCheckBox;
 class QLabel;
 class QComboBox;
+class IconPreviewLoader;
+class DesktopEntryIndex;
 
 class LauncherCreator : public QWidget
 {
     Q_OBJECT
 
 public:
-    explicit LauncherCreator(QWidget *parent = nullptr);
+    // desktopIndex is used to catch duplicates before writing, and is not owned
+    explicit LauncherCreator(DesktopEntryIndex *desktopIndex, QWidget *parent = nullptr);
+    ~LauncherCreator();
 
 private slots:
     void onBrowseExecutableButtonClicked();
     void onBrowseIconButtonClicked();
     void onCreateLauncherButtonClicked();
     void onClearButtonClicked();
+    void onIconPreviewReady(const QString &path, const QPixmap &pixmap);
+    void onBulkButtonClicked();
+    void onBulkScanFinished();
 
 private:
     void setupUI();
     void resetForm();
     bool createDesktopFile(const QString &name, const QString &exec, const QString &icon, 
                           const QStringList &categories, const QString &mimeType);
+    void showBulkDialog(const QVector<LaunchCandidate> &candidates);
     QString getSelectedCategories() const;
+    
+    static QString desktopFilePath(const QString &name);
+    static QString desktopFileContent(const QString &name, const QString &exec, const QString &icon,
+                                      const QStringList &categories, const QString &mimeType);
     QString getMimeType() const;
 
     // UI elements
@@ -39,7 +56,9 @@ private:
     QPushButton *m_browseIconButton;
     QPushButton *m_createButton;
     QPushButton *m_clearButton;
+    QPushButton *m_bulkButton;
     QLabel *m_iconPreviewLabel;
+    IconPreviewLoader *m_iconPreviewLoader;
     QComboBox *m_mimeTypeComboBox;
     
     // Category checkboxes
@@ -52,6 +71,13 @@ private:
     QCheckBox *m_networkCheckBox;
     QCheckBox *m_gameCheckBox;
     QCheckBox *m_educationCheckBox;
+    
+    DesktopEntryWriter m_desktopEntries;
+    DesktopEntryIndex *m_desktopIndex;
+    
+    // Bulk mode: directory scan running on the thread pool
+    QFutureWatcher<QVector<LaunchCandidate>> *m_bulkScanWatcher;
+    std::atomic<bool> m_cancelBulkScan;
 };
 
 #endif // LAUNCHERCREATOR_H
@@ -1,27 +1,74 @@
 #include "MainWindow.h"
 #include "ui_MainWindow.h"
+#include <QStatusBar>
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QDir>
+#include <QFile>
 #include <QStandardPaths>
 #include <QInputDialog>
-#include <QListWidget>
+#include <QTableView>
+#include <QSortFilterProxyModel>
 #include <QDialog>
 #include <QVBoxLayout>
 #include <QLabel>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QHBoxLayout>
+#include <QTimer>
+#include <QSignalBlocker>
+#include <QTextStream>
+#include <time.h>
+#include <unistd.h>
+#include "DiskPreflight.h"
+#include "Trace.h"
+#include "InstalledAppsModel.h"
+
+namespace {
+
+// Time since the kernel started this process, dynamic loading included.
+// /proc/self/stat field 22 is the start time in clock ticks since boot.
+qint64 processAgeNs()
+{
+    QFile stat("/proc/self/stat");
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    
+    // The command name may contain spaces; fields are counted after it
+    QByteArray line = stat.readAll();
+    QList<QByteArray> fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 20) {
+        return -1;
+    }
+    
+    qint64 startTicks = fields.at(19).toLongLong();
+    timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    qint64 nowNs = qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+    return nowNs - startTicks * (1000000000 / sysconf(_SC_CLK_TCK));
+}
+
+} // namespace
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
     , m_installer(new Installer(this))
-    , m_launcherCreator(new LauncherCreator(this))
+    , m_launcherCreator(nullptr)
     , m_tabWidget(new QTabWidget(this))
+    , m_reportUpdateCheck(false)
+    , m_firstPaintSeen(false)
+    , m_reportStartupTime(false)
+    , m_dedupeHardlinks(false)
 {
     ui->setupUi(this);
     
-    // Create tab widget and add installer interface
+    // Only the installer tab is built up front; the launcher generator is
+    // built the first time its tab is selected
     m_tabWidget->addTab(ui->centralwidget, "Instalador de Aplicaciones");
-    m_tabWidget->addTab(m_launcherCreator, "Generador de Lanzadores");
+    m_tabWidget->addTab(new QWidget(), "Generador de Lanzadores");
+    connect(m_tabWidget, &QTabWidget::currentChanged, this, &MainWindow::onTabChanged);
     
     setCentralWidget(m_tabWidget);
     
@@ -34,6 +81,9 @@ MainWindow::MainWindow(QWidget *parent)
     
     setWindowTitle("VSC-INSTALLER-PLUS v1.0.0");
     resize(800, 600);
+    
+    // Quiet background check; results only show up in the status bar
+    QTimer::singleShot(5000, m_installer, &Installer::checkForUpdates);
 }
 
 MainWindow::~MainWindow()
@@ -41,6 +91,56 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+void MainWindow::setReportStartupTime(bool report)
+{
+    m_reportStartupTime = report;
+}
+
+bool MainWindow::event(QEvent *event)
+{
+    // The first paint is done once control is back in the event loop
+    if (event->type() == QEvent::Paint && !m_firstPaintSeen) {
+        m_firstPaintSeen = true;
+        QTimer::singleShot(0, this, &MainWindow::onFirstPaint);
+    }
+    return QMainWindow::event(event);
+}
+
+void MainWindow::onFirstPaint()
+{
+    qint64 age = processAgeNs();
+    if (age >= 0) {
+        qint64 now = Trace::now();
+        Trace::complete("startup_to_first_paint", now - age, now);
+        if (m_reportStartupTime) {
+            QTextStream(stderr) << QString("Primer pintado a los %1 ms del inicio del proceso\n")
+                                   .arg(age / 1e6, 0, 'f', 1);
+        }
+    }
+    
+    // The window is up; SQLite can open now without delaying it
+    QTimer::singleShot(0, m_installer, &Installer::openDatabase);
+}
+
+void MainWindow::onTabChanged(int index)
+{
+    if (index != LAUNCHER_TAB || m_launcherCreator) {
+        return;
+    }
+    
+    TRACE_SCOPE("build_launcher_tab");
+    m_launcherCreator = new LauncherCreator(m_installer->desktopEntryIndex(), this);
+    
+    // Swapping the placeholder would report two more tab changes
+    QSignalBlocker blocker(m_tabWidget);
+    QWidget *placeholder = m_tabWidget->widget(LAUNCHER_TAB);
+    QString title = m_tabWidget->tabText(LAUNCHER_TAB);
+    m_tabWidget->removeTab(LAUNCHER_TAB);
+    m_tabWidget->insertTab(LAUNCHER_TAB, m_launcherCreator, title);
+    m_tabWidget->setCurrentIndex(LAUNCHER_TAB);
+    placeholder->deleteLater();
+}
+
 void MainWindow::setupConnections()
 {
     connect(ui->browseButton, &QPushButton::clicked, this, &MainWindow::onBrowseButtonClicked);
@@ -54,12 +154,19 @@ void MainWindow::setupConnections()
     
     connect(ui->actionSalir, &QAction::triggered, this, &MainWindow::onActionSalirTriggered);
     connect(ui->actionVer_instalados, &QAction::triggered, this, &MainWindow::onActionVerInstaladosTriggered);
+    connect(ui->actionVerificar_instalaciones, &QAction::triggered, this, &MainWindow::onActionVerificarInstalacionesTriggered);
+    connect(ui->actionInforme_deduplicacion, &QAction::triggered, this, &MainWindow::onActionInformeDeduplicacionTriggered);
+    connect(ui->actionEstadisticas_instalacion, &QAction::triggered, this, &MainWindow::onActionEstadisticasInstalacionTriggered);
+    connect(ui->actionBuscar_actualizaciones, &QAction::triggered, this, &MainWindow::onActionBuscarActualizacionesTriggered);
+    connect(ui->actionPreparar_actualizaciones, &QAction::toggled, m_installer, &Installer::setPrefetchEnabled);
     connect(ui->actionLimpiar_registros, &QAction::triggered, this, &MainWindow::onActionLimpiarRegistrosTriggered);
     
     connect(m_installer, &Installer::installationCompleted, this, &MainWindow::onInstallationCompleted);
     connect(m_installer, &Installer::progressUpdated, this, &MainWindow::onProgressUpdated);
     connect(m_installer, &Installer::logMessage, this, &MainWindow::onLogMessage);
     connect(m_installer, &Installer::adminPrivilegesRequired, this, &MainWindow::onAdminPrivilegesRequired);
+    connect(m_installer, &Installer::updateCheckCompleted, this, &MainWindow::onUpdateCheckCompleted);
+    connect(m_installer, &Installer::updateStaged, this, &MainWindow::onUpdateStaged);
 }
 
 void MainWindow::onBrowseButtonClicked()
@@ -68,7 +175,7 @@ void MainWindow::onBrowseButtonClicked()
         this,
         "Seleccionar archivo tarball",
         QDir::homePath(),
-        "Archivos comprimidos (*.tar.gz *.tgz *.tar.bz2 *.tbz2 *.tar.xz *.tar);;Todos los archivos (*)"
+        "Archivos comprimidos (*.tar.gz *.tgz *.tar.bz2 *.tbz2 *.tar.xz *.tar *.zip);;Todos los archivos (*)"
     );
     
     if (!fileName.isEmpty()) {
@@ -111,6 +218,11 @@ void MainWindow::onInstallButtonClicked()
     bool createDesktop = shouldCreateDesktop();
     bool createSymlink = shouldCreateSymlink();
     
+    m_installer->setExpectedSha256(ui->checksumLineEdit->text());
+    m_installer->setDeduplicationEnabled(shouldDeduplicate(), m_dedupeHardlinks);
+    m_installer->setIoPolicy(ioPolicy());
+    m_installer->setWarmupEnabled(ui->warmupCheckBox->isChecked());
+    
     if (ui->localFileRadio->isChecked()) {
         m_installer->installFromLocalFile(source, installPath, createDesktop, createSymlink);
     } else {
@@ -127,13 +239,17 @@ void MainWindow::onUpdateButtonClicked()
         return;
     }
     
+    // Offer apps with a known update first
+    QStringList withUpdates = m_installer->appsWithUpdates();
+    int current = withUpdates.isEmpty() ? 0 : installedApps.indexOf(withUpdates.first());
+    
     bool ok;
     QString appName = QInputDialog::getItem(
         this,
         "Actualizar Aplicación",
         "Seleccione la aplicación a actualizar:",
         installedApps,
-        0,
+        qMax(0, current),
         false,
         &ok
     );
@@ -148,7 +264,7 @@ void MainWindow::onUpdateButtonClicked()
         "Nueva Fuente",
         "Ingrese la URL o ruta del nuevo paquete:",
         QLineEdit::Normal,
-        "",
+        m_installer->updateSourceFor(appName),
         &ok2
     );
     
@@ -162,6 +278,10 @@ void MainWindow::onUpdateButtonClicked()
     ui->progressBar->setValue(0);
     ui->logTextEdit->clear();
     
+    m_installer->setExpectedSha256(ui->checksumLineEdit->text());
+    m_installer->setDeduplicationEnabled(shouldDeduplicate(), m_dedupeHardlinks);
+    m_installer->setIoPolicy(ioPolicy());
+    m_installer->setWarmupEnabled(ui->warmupCheckBox->isChecked());
     m_installer->updateExistingApp(appName, newSource, "", isUrl);
 }
 
@@ -191,28 +311,170 @@ void MainWindow::onActionSalirTriggered()
 
 void MainWindow::onActionVerInstaladosTriggered()
 {
-    QStringList installedApps = m_installer->getInstalledApps();
-    
     QDialog dialog(this);
     dialog.setWindowTitle("Aplicaciones Instaladas");
-    dialog.resize(500, 400);
+    dialog.resize(900, 400);
     
     QVBoxLayout *layout = new QVBoxLayout(&dialog);
     
-    QLabel *label = new QLabel("Aplicaciones instaladas:");
+    // Sizes known from the last visit show at once; changed trees are re-measured in the background
+    InstalledAppsModel *model = new InstalledAppsModel(m_installer, &dialog);
+    QSortFilterProxyModel *proxy = new QSortFilterProxyModel(&dialog);
+    proxy->setSourceModel(model);
+    proxy->setSortRole(InstalledAppsModel::SortRole);
+    
+    QLabel *label = new QLabel(QString("Aplicaciones instaladas: %1").arg(model->rowCount()));
     layout->addWidget(label);
     
-    QListWidget *listWidget = new QListWidget();
-    listWidget->addItems(installedApps);
-    layout->addWidget(listWidget);
+    QTableView *view = new QTableView();
+    view->setModel(proxy);
+    view->setSortingEnabled(true);
+    view->sortByColumn(InstalledAppsModel::NameColumn, Qt::AscendingOrder);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->verticalHeader()->hide();
+    view->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    view->horizontalHeader()->setSectionResizeMode(InstalledAppsModel::PathColumn, QHeaderView::Stretch);
+    layout->addWidget(view);
+    
+    QHBoxLayout *buttons = new QHBoxLayout();
+    QPushButton *reloadButton = new QPushButton("Actualizar");
+    connect(reloadButton, &QPushButton::clicked, model, [model, label]() {
+        model->reload();
+        label->setText(QString("Aplicaciones instaladas: %1").arg(model->rowCount()));
+    });
+    QPushButton *closeButton = new QPushButton("Cerrar");
+    connect(closeButton, &QPushButton::clicked, &dialog, &QDialog::accept);
+    buttons->addWidget(reloadButton);
+    buttons->addStretch();
+    buttons->addWidget(closeButton);
+    layout->addLayout(buttons);
+    
+    dialog.exec();
+}
+
+void MainWindow::onActionVerificarInstalacionesTriggered()
+{
+    if (m_installer->getInstalledApps().isEmpty()) {
+        QMessageBox::information(this, "Información", "No hay aplicaciones instaladas para verificar");
+        return;
+    }
+    
+    enableControls(false);
+    ui->logTextEdit->clear();
+    
+    bool clean = m_installer->verifyInstalledApps();
+    
+    enableControls(true);
+    
+    if (clean) {
+        QMessageBox::information(this, "Verificación", "Todas las instalaciones están íntegras");
+    } else {
+        QMessageBox::warning(this, "Verificación", 
+            "Se encontraron archivos alterados o faltantes.\nConsulte el registro para ver los detalles.");
+    }
+}
+
+void MainWindow::onActionInformeDeduplicacionTriggered()
+{
+    DedupReport report = m_installer->deduplicationReport();
+    
+    QString text = QString("Archivos únicos en el almacén: %1 (%2)\n"
+                           "Referencias desde aplicaciones: %3\n"
+                           "Espacio ahorrado: %4")
+        .arg(report.blobs)
+        .arg(DiskPreflight::formatBytes(report.storedBytes))
+        .arg(report.links)
+        .arg(DiskPreflight::formatBytes(report.savedBytes));
+    
+    if (!report.perApp.isEmpty()) {
+        text += "\n\n" + report.perApp.join("\n");
+    }
+    
+    QMessageBox::information(this, "Informe de deduplicación", text);
+}
+
+void MainWindow::onActionEstadisticasInstalacionTriggered()
+{
+    QVector<PhaseStats> stats = m_installer->installStats();
+    
+    QDialog dialog(this);
+    dialog.setWindowTitle("Estadísticas de instalación");
+    dialog.resize(700, 450);
     
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    layout->addWidget(new QLabel(stats.isEmpty() ? "Todavía no hay instalaciones registradas"
+                                                 : "Duración de cada fase en segundos, por aplicación:"));
+    
+    QTableWidget *table = new QTableWidget(stats.size(), 6);
+    table->setHorizontalHeaderLabels(QStringList() << "Aplicación" << "Fase" << "N" << "p50" << "p90" << "p99");
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->verticalHeader()->hide();
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    for (int row = 0; row < stats.size(); ++row) {
+        const PhaseStats &entry = stats.at(row);
+        table->setItem(row, 0, new QTableWidgetItem(entry.appName));
+        table->setItem(row, 1, new QTableWidgetItem(entry.phase));
+        table->setItem(row, 2, new QTableWidgetItem(QString::number(entry.count)));
+        table->setItem(row, 3, new QTableWidgetItem(QString::number(entry.p50, 'f', 3)));
+        table->setItem(row, 4, new QTableWidgetItem(QString::number(entry.p90, 'f', 3)));
+        table->setItem(row, 5, new QTableWidgetItem(QString::number(entry.p99, 'f', 3)));
+    }
+    layout->addWidget(table);
+    
+    QHBoxLayout *buttons = new QHBoxLayout();
+    QPushButton *exportButton = new QPushButton("Exportar para Prometheus...");
+    exportButton->setEnabled(!stats.isEmpty());
+    connect(exportButton, &QPushButton::clicked, &dialog, [this, &dialog]() {
+        QString path = QFileDialog::getSaveFileName(&dialog, "Exportar métricas", 
+                                                    QDir::homePath() + "/vscip.prom", 
+                                                    "Textfile de Prometheus (*.prom)");
+        if (!path.isEmpty() && !m_installer->exportInstallMetrics(path)) {
+            QMessageBox::warning(&dialog, "Error", "No se pudo escribir " + path);
+        }
+    });
     QPushButton *closeButton = new QPushButton("Cerrar");
     connect(closeButton, &QPushButton::clicked, &dialog, &QDialog::accept);
-    layout->addWidget(closeButton);
+    buttons->addWidget(exportButton);
+    buttons->addStretch();
+    buttons->addWidget(closeButton);
+    layout->addLayout(buttons);
     
     dialog.exec();
 }
 
+void MainWindow::onActionBuscarActualizacionesTriggered()
+{
+    m_reportUpdateCheck = true;
+    statusBar()->showMessage("Buscando actualizaciones...");
+    m_installer->checkForUpdates();
+}
+
+void MainWindow::onUpdateCheckCompleted(const QStringList &appsWithUpdates)
+{
+    if (appsWithUpdates.isEmpty()) {
+        statusBar()->showMessage("Todas las aplicaciones están actualizadas", 10000);
+    } else {
+        statusBar()->showMessage("Actualizaciones disponibles: " + appsWithUpdates.join(", "));
+    }
+    
+    if (m_reportUpdateCheck) {
+        m_reportUpdateCheck = false;
+        if (appsWithUpdates.isEmpty()) {
+            QMessageBox::information(this, "Actualizaciones", "Todas las aplicaciones están actualizadas");
+        } else {
+            QMessageBox::information(this, "Actualizaciones",
+                "Hay actualizaciones disponibles para:\n\n" + appsWithUpdates.join("\n") +
+                "\n\nUse el botón Actualizar para instalarlas.");
+        }
+    }
+}
+
+void MainWindow::onUpdateStaged(const QString &appName)
+{
+    statusBar()->showMessage("Actualización de " + appName + " preparada, aplíquela con el botón Actualizar");
+}
+
 void MainWindow::onActionLimpiarRegistrosTriggered()
 {
     int ret = QMessageBox::warning(
@@ -286,6 +548,26 @@ void MainWindow::onAdminPrivilegesRequired()
             args << "--create-symlink";
         }
         
+        if (ui->dedupeCheckBox->isChecked()) {
+            args << "--dedupe";
+        }
+        
+        if (ui->warmupCheckBox->isChecked()) {
+            args << "--preload";
+        }
+        
+        if (ui->lowPriorityCheckBox->isChecked()) {
+            args << "--background";
+        }
+        
+        if (ui->ioLimitSpinBox->value() > 0) {
+            args << "--io-limit" << QString::number(ui->ioLimitSpinBox->value());
+        }
+        
+        if (!ui->checksumLineEdit->text().trimmed().isEmpty()) {
+            args << "--sha256" << ui->checksumLineEdit->text().trimmed();
+        }
+        
         args << "--auto-install";
         
         // Restart with admin privileges
@@ -325,6 +607,36 @@ void MainWindow::setCreateSymlink(bool create)
     ui->createSymlinkCheckBox->setChecked(create);
 }
 
+void MainWindow::setExpectedSha256(const QString &checksum)
+{
+    ui->checksumLineEdit->setText(checksum);
+}
+
+void MainWindow::setDeduplicate(bool deduplicate)
+{
+    ui->dedupeCheckBox->setChecked(deduplicate);
+}
+
+void MainWindow::setDeduplicateHardlinks(bool hardlinks)
+{
+    m_dedupeHardlinks = hardlinks;
+}
+
+void MainWindow::setLowPriority(bool lowPriority)
+{
+    ui->lowPriorityCheckBox->setChecked(lowPriority);
+}
+
+void MainWindow::setWarmup(bool warmup)
+{
+    ui->warmupCheckBox->setChecked(warmup);
+}
+
+void MainWindow::setIoLimit(int megabytesPerSecond)
+{
+    ui->ioLimitSpinBox->setValue(megabytesPerSecond);
+}
+
 void MainWindow::startAutoInstall()
 {
     // Simulate clicking the install button
@@ -336,6 +648,11 @@ void MainWindow::resetForm()
     ui->localFileLineEdit->clear();
     ui->urlLineEdit->clear();
     ui->installPathLineEdit->setText("/opt");
+    ui->checksumLineEdit->clear();
+    ui->dedupeCheckBox->setChecked(false);
+    ui->warmupCheckBox->setChecked(false);
+    ui->lowPriorityCheckBox->setChecked(false);
+    ui->ioLimitSpinBox->setValue(0);
     ui->progressBar->setValue(0);
     ui->logTextEdit->clear();
     ui->localFileRadio->setChecked(true);
@@ -375,3 +692,17 @@ bool MainWindow::shouldCreateSymlink() const
 {
     return ui->createSymlinkCheckBox->isChecked();
 }
+
+bool MainWindow::shouldDeduplicate() const
+{
+    return ui->dedupeCheckBox->isChecked();
+}
+
+IoPolicy MainWindow::ioPolicy() const
+{
+    IoPolicy policy;
+    policy.idlePriority = ui->lowPriorityCheckBox->isChecked();
+    policy.dropCache = policy.idlePriority;
+    policy.writeBytesPerSecond = qint64(ui->ioLimitSpinBox->value()) * 1024 * 1024;
+    return policy;
+}
@@ -39,6 +39,12 @@ public slots:
     void onUrlRadioToggled(bool checked);
     void onActionSalirTriggered();
     void onActionVerInstaladosTriggered();
+    void onActionVerificarInstalacionesTriggered();
+    void onActionInformeDeduplicacionTriggered();
+    void onActionEstadisticasInstalacionTriggered();
+    void onActionBuscarActualizacionesTriggered();
+    void onUpdateCheckCompleted(const QStringList &appsWithUpdates);
+    void onUpdateStaged(const QString &appName);
     void onActionLimpiarRegistrosTriggered();
     void onInstallationCompleted(bool success, const QString &message);
     void onProgressUpdated(int value);
@@ -51,7 +57,23 @@ public slots:
     void setInstallPath(const QString &path);
     void setCreateDesktop(bool create);
     void setCreateSymlink(bool create);
+    void setExpectedSha256(const QString &checksum);
+    void setDeduplicate(bool deduplicate);
+    // Also share files as hard links on filesystems without reflinks
+    void setDeduplicateHardlinks(bool hardlinks);
+    void setLowPriority(bool lowPriority);
+    void setWarmup(bool warmup);
+    void setIoLimit(int megabytesPerSecond);
     void startAutoInstall();
+    // Print the time from process start to the first paint on stderr
+    void setReportStartupTime(bool report);
+
+protected:
+    bool event(QEvent *event) override;
+
+private slots:
+    void onFirstPaint();
+    void onTabChanged(int index);
 
 private:
     void setupConnections();
@@ -61,11 +83,19 @@ private:
     QString getInstallPath() const;
     bool shouldCreateDesktop() const;
     bool shouldCreateSymlink() const;
+    bool shouldDeduplicate() const;
+    IoPolicy ioPolicy() const;
 
     Ui::MainWindow *ui;
     Installer *m_installer;
     LauncherCreator *m_launcherCreator;
     QTabWidget *m_tabWidget;
+    bool m_reportUpdateCheck;
+    bool m_firstPaintSeen;
+    bool m_reportStartupTime;
+    bool m_dedupeHardlinks;
+    
+    static const int LAUNCHER_TAB = 1;
 };
 
 #endif // MAINWINDOW_H
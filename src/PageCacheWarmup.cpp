@@ -0,0 +1,143 @@
+#include "PageCacheWarmup.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+// In launch order: the main ELF, the V8 and ICU snapshots, the resource
+// packs, then the scripts of the main and renderer processes
+const char *const ELECTRON_LAUNCH_FILES[] = {
+    "v8_context_snapshot.bin",
+    "snapshot_blob.bin",
+    "icudtl.dat",
+    "resources.pak",
+    "chrome_100_percent.pak",
+    "chrome_200_percent.pak",
+    "locales/en-US.pak",
+    "libffmpeg.so",
+    "libEGL.so",
+    "libGLESv2.so",
+    "resources/app.asar",
+    "resources/app/node_modules.asar",
+    "resources/app/out/main.js",
+    "resources/app/out/vs/code/electron-main/main.js",
+    "resources/app/out/vs/workbench/workbench.desktop.main.js",
+    "resources/app/out/vs/workbench/workbench.desktop.main.css",
+    "resources/app/out/vs/workbench/workbench.desktop.main.nls.js"
+};
+
+qint64 toNanoseconds(const struct timespec &ts)
+{
+    return qint64(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+} // namespace
+
+QStringList PageCacheWarmup::defaultProfile(const QString &installDir, const QString &execPath)
+{
+    QStringList profile;
+    QDir dir(installDir);
+
+    QString exec = dir.relativeFilePath(execPath);
+    if (QFileInfo(execPath).isFile()) {
+        profile << exec;
+    }
+
+    for (const char *name : ELECTRON_LAUNCH_FILES) {
+        if (QFileInfo(dir.filePath(name)).isFile()) {
+            profile << QString::fromLatin1(name);
+        }
+    }
+
+    return profile;
+}
+
+QStringList PageCacheWarmup::filesReadSinceInstall(const QString &installDir,
+                                                   const QVector<ManifestEntry> &manifest)
+{
+    QStringList files;
+    QDir dir(installDir);
+
+    foreach (const ManifestEntry &entry, manifest) {
+        if (entry.kind != ManifestEntry::File || entry.size == 0) {
+            continue;
+        }
+
+        struct stat st;
+        if (::stat(QFile::encodeName(entry.path).constData(), &st) != 0) {
+            continue;
+        }
+
+        if (toNanoseconds(st.st_atim) > toNanoseconds(st.st_ctim)) {
+            files << dir.relativeFilePath(entry.path);
+        }
+    }
+
+    return files;
+}
+
+WarmupResult PageCacheWarmup::prefetch(const QString &installDir, const QStringList &profile)
+{
+    WarmupResult result;
+    QDir dir(installDir);
+
+    qint64 budget = availableMemory();
+    budget = budget > 0 ? budget / 2 : -1;
+
+    foreach (const QString &relativePath, profile) {
+        QByteArray path = QFile::encodeName(dir.filePath(relativePath));
+
+        // O_NOATIME keeps our own reads out of the next learned profile
+        int fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+        if (fd < 0) {
+            fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+        }
+        if (fd < 0) {
+            continue;
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            continue;
+        }
+
+        if (budget >= 0 && result.bytes + st.st_size > budget) {
+            ::close(fd);
+            break;
+        }
+
+        // readahead() waits for the reads, which is why callers run this off the
+        // UI thread; WILLNEED covers filesystems that refuse it
+        if (::readahead(fd, 0, size_t(st.st_size)) != 0) {
+            ::posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+        }
+        ::close(fd);
+
+        result.files++;
+        result.bytes += st.st_size;
+    }
+
+    return result;
+}
+
+qint64 PageCacheWarmup::availableMemory()
+{
+    QFile meminfo("/proc/meminfo");
+    if (!meminfo.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+
+    foreach (const QByteArray &line, meminfo.readAll().split('\n')) {
+        if (line.startsWith("MemAvailable:")) {
+            bool ok = false;
+            qint64 kilobytes = line.mid(13).trimmed().split(' ').value(0).toLongLong(&ok);
+            return ok ? kilobytes * 1024 : -1;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,39 @@
+#ifndef PAGECACHEWARMUP_H
+#define PAGECACHEWARMUP_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "InstallManifest.h"
+
+struct WarmupResult
+{
+    int files = 0;
+    qint64 bytes = 0;
+};
+
+// Prefetches the files an editor reads while starting into the page cache,
+// so the first launch after an install does not wait on cold disk reads.
+// Profiles hold paths relative to the install directory so that one learned
+// on a version keeps working for the next.
+class PageCacheWarmup
+{
+public:
+    // Files Electron editors read before their first window appears
+    static QStringList defaultProfile(const QString &installDir, const QString &execPath);
+
+    // Files of manifest read since they were installed: extraction leaves
+    // atime older than ctime and the installer's own reads use O_NOATIME,
+    // so only real use moves atime past ctime. Empty on noatime mounts.
+    static QStringList filesReadSinceInstall(const QString &installDir,
+                                             const QVector<ManifestEntry> &manifest);
+
+    // Reads the profile into the page cache, in order, stopping once half of
+    // the available memory would be used. Blocks; run it on a worker thread.
+    static WarmupResult prefetch(const QString &installDir, const QStringList &profile);
+
+    // MemAvailable from /proc/meminfo, -1 if unknown
+    static qint64 availableMemory();
+};
+
+#endif // PAGECACHEWARMUP_H
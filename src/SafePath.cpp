@@ -0,0 +1,35 @@
+#include "SafePath.h"
+#include <QFile>
+#include <QStringList>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+int SafePath::openParent(const QString &root, const QString &relative, QByteArray *leaf)
+{
+    QStringList parts = relative.split('/', QString::SkipEmptyParts);
+    foreach (const QString &part, parts) {
+        if (part == "." || part == "..") {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    if (parts.isEmpty()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = ::open(QFile::encodeName(root).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    for (int i = 0; fd >= 0 && i < parts.size() - 1; ++i) {
+        // O_NOFOLLOW makes a symlinked parent fail with ELOOP or ENOTDIR
+        int next = ::openat(fd, QFile::encodeName(parts.at(i)).constData(),
+                            O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        ::close(fd);
+        fd = next;
+    }
+
+    if (fd >= 0) {
+        *leaf = QFile::encodeName(parts.last());
+    }
+    return fd;
+}
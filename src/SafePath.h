@@ -0,0 +1,21 @@
+#ifndef SAFEPATH_H
+#define SAFEPATH_H
+
+#include <QByteArray>
+#include <QString>
+
+// Path resolution for archive extraction. Archives may hold symlinks, and
+// an entry such as "a/l/x" after "a/l -> /etc" must not land in /etc, so
+// parents are opened one component at a time without following links and
+// entries are then created relative to that directory.
+class SafePath
+{
+public:
+    // Opens the directory containing relative, a path below root already
+    // checked not to leave it, and stores its last component in leaf.
+    // Fails if any parent is a symlink or not a directory. Returns the
+    // directory's file descriptor, to be closed by the caller, or -1.
+    static int openParent(const QString &root, const QString &relative, QByteArray *leaf);
+};
+
+#endif // SAFEPATH_H
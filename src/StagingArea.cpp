@@ -0,0 +1,119 @@
+#include "StagingArea.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QCoreApplication>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifndef RENAME_EXCHANGE
+#define RENAME_EXCHANGE (1 << 1)
+#endif
+
+const char *const StagingArea::DISPLACED_SUFFIX = ".displaced-";
+
+namespace {
+
+bool exchangePaths(const QString &first, const QString &second)
+{
+#ifdef SYS_renameat2
+    // Called through syscall() because older glibc has no renameat2 wrapper
+    return ::syscall(SYS_renameat2, AT_FDCWD, QFile::encodeName(first).constData(),
+                     AT_FDCWD, QFile::encodeName(second).constData(), RENAME_EXCHANGE) == 0;
+#else
+    Q_UNUSED(first);
+    Q_UNUSED(second);
+    return false;
+#endif
+}
+
+bool renamePath(const QString &from, const QString &to)
+{
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+}
+
+} // namespace
+
+QString StagingArea::rootFor(const QString &installPath)
+{
+    return QDir::cleanPath(installPath) + "/.vscip-staging";
+}
+
+QString StagingArea::treePathFor(const QString &installPath, const QString &appName)
+{
+    return rootFor(installPath) + "/" + appName;
+}
+
+bool StagingArea::swapInto(const QString &stagedPath, const QString &targetPath, QString *displacedPath)
+{
+    if (displacedPath) {
+        displacedPath->clear();
+    }
+
+    if (!QFileInfo::exists(targetPath)) {
+        return renamePath(stagedPath, targetPath);
+    }
+
+    QString displaced = stagedPath + DISPLACED_SUFFIX + QString::number(QCoreApplication::applicationPid());
+
+    if (exchangePaths(stagedPath, targetPath)) {
+        // The previous install now sits where the staged tree was
+        if (!renamePath(stagedPath, displaced)) {
+            displaced = stagedPath;
+        }
+    } else {
+        // No RENAME_EXCHANGE (old kernel, or a filesystem without it): there
+        // is a short window where targetPath does not exist
+        if (!renamePath(targetPath, displaced)) {
+            return false;
+        }
+        if (!renamePath(stagedPath, targetPath)) {
+            renamePath(displaced, targetPath);
+            return false;
+        }
+    }
+
+    if (displacedPath) {
+        *displacedPath = displaced;
+    }
+    return true;
+}
+
+void StagingArea::sweep(const QString &installPath)
+{
+    QDir root(rootFor(installPath));
+    if (!root.exists()) {
+        return;
+    }
+
+    QStringList leftovers = root.entryList(QStringList() << "*.extract" << "*.download"
+                                                         << QString("*%1*").arg(DISPLACED_SUFFIX),
+                                           QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden);
+    foreach (const QString &name, leftovers) {
+        QString path = root.absoluteFilePath(name);
+        if (QFileInfo(path).isDir()) {
+            QDir(path).removeRecursively();
+        } else {
+            QFile::remove(path);
+        }
+    }
+}
+
+bool StagingArea::isSystemIdle(double maxLoadPerCpu)
+{
+    QFile loadavg("/proc/loadavg");
+    if (!loadavg.open(QIODevice::ReadOnly)) {
+        return true;
+    }
+
+    bool ok = false;
+    double load = loadavg.readLine().split(' ').value(0).toDouble(&ok);
+    if (!ok) {
+        return true;
+    }
+
+    return load <= maxLoadPerCpu * QThread::idealThreadCount();
+}
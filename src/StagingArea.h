@@ -0,0 +1,32 @@
+#ifndef STAGINGAREA_H
+#define STAGINGAREA_H
+
+#include <QString>
+
+// Hidden directory next to the installed apps where the next version of an
+// app is downloaded and extracted ahead of time. Living on the same
+// filesystem as the install is what makes applying it a rename.
+class StagingArea
+{
+public:
+    static QString rootFor(const QString &installPath);
+
+    // Path of the fully extracted next version of appName
+    static QString treePathFor(const QString &installPath, const QString &appName);
+
+    // Puts stagedPath in place of targetPath. With RENAME_EXCHANGE both trees
+    // swap in one step and the previous install ends up at stagedPath; other
+    // filesystems fall back to two renames. displacedPath receives where the
+    // previous install now lives, or stays empty if there was none.
+    static bool swapInto(const QString &stagedPath, const QString &targetPath, QString *displacedPath);
+
+    // Removes leftovers of interrupted downloads, extractions and swaps
+    static void sweep(const QString &installPath);
+
+    // True when the 1 minute load average leaves most CPUs free
+    static bool isSystemIdle(double maxLoadPerCpu = 0.25);
+
+    static const char *const DISPLACED_SUFFIX;
+};
+
+#endif // STAGINGAREA_H
@@ -0,0 +1,485 @@
+#include "TarArchive.h"
+#include "SafePath.h"
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+// ustar header layout (POSIX.1-1988)
+const int NAME_OFFSET = 0;
+const int NAME_LENGTH = 100;
+const int MODE_OFFSET = 100;
+const int SIZE_OFFSET = 124;
+const int MTIME_OFFSET = 136;
+const int NUMERIC_LENGTH = 12;
+const int CHECKSUM_OFFSET = 148;
+const int TYPE_OFFSET = 156;
+const int LINKNAME_OFFSET = 157;
+const int MAGIC_OFFSET = 257;
+const int PREFIX_OFFSET = 345;
+const int PREFIX_LENGTH = 155;
+
+QByteArray fieldString(const uchar *field, int length)
+{
+    const char *begin = reinterpret_cast<const char *>(field);
+    return QByteArray(begin, int(qstrnlen(begin, uint(length))));
+}
+
+// Octal, or GNU base-256 when the high bit of the first byte is set
+qint64 parseNumber(const uchar *field, int length)
+{
+    if (field[0] & 0x80) {
+        qint64 value = field[0] & 0x7f;
+        for (int i = 1; i < length; ++i) {
+            value = (value << 8) | field[i];
+        }
+        return value;
+    }
+
+    qint64 value = 0;
+    int i = 0;
+    while (i < length && (field[i] == ' ' || field[i] == '\0')) {
+        ++i;
+    }
+    while (i < length && field[i] >= '0' && field[i] <= '7') {
+        value = value * 8 + (field[i] - '0');
+        ++i;
+    }
+    return value;
+}
+
+bool isZeroBlock(const uchar *block)
+{
+    for (int i = 0; i < TarArchive::BLOCK_SIZE; ++i) {
+        if (block[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checksumMatches(const uchar *block)
+{
+    qint64 expected = parseNumber(block + CHECKSUM_OFFSET, 8);
+    qint64 unsignedSum = 0;
+    qint64 signedSum = 0;
+
+    for (int i = 0; i < TarArchive::BLOCK_SIZE; ++i) {
+        uchar byte = (i >= CHECKSUM_OFFSET && i < CHECKSUM_OFFSET + 8) ? uchar(' ') : block[i];
+        unsignedSum += byte;
+        signedSum += static_cast<signed char>(byte);
+    }
+
+    // Some historic writers summed signed chars
+    return expected == unsignedSum || expected == signedSum;
+}
+
+qint64 paddedSize(qint64 size)
+{
+    return (size + TarArchive::BLOCK_SIZE - 1) / TarArchive::BLOCK_SIZE * TarArchive::BLOCK_SIZE;
+}
+
+// pax extended header records: "<len> <key>=<value>\n"
+void parsePax(const QByteArray &data, QByteArray *path, QByteArray *linkPath, qint64 *size)
+{
+    int pos = 0;
+    while (pos < data.size()) {
+        int space = data.indexOf(' ', pos);
+        if (space < 0) {
+            return;
+        }
+
+        bool ok = false;
+        int recordLength = data.mid(pos, space - pos).toInt(&ok);
+        if (!ok || recordLength <= 0 || pos + recordLength > data.size()) {
+            return;
+        }
+
+        QByteArray record = data.mid(space + 1, pos + recordLength - space - 2);
+        int equals = record.indexOf('=');
+        if (equals > 0) {
+            QByteArray key = record.left(equals);
+            QByteArray value = record.mid(equals + 1);
+
+            if (key == "path") {
+                *path = value;
+            } else if (key == "linkpath") {
+                *linkPath = value;
+            } else if (key == "size") {
+                *size = value.toLongLong();
+            }
+        }
+
+        pos += recordLength;
+    }
+}
+
+// The entry a regular header describes, with the overrides of the GNU or
+// pax records that preceded it
+TarEntry entryFromHeader(const uchar *header, char type, const QByteArray &longName,
+                         const QByteArray &longLink, qint64 size, qint64 dataOffset)
+{
+    TarEntry entry;
+
+    if (!longName.isEmpty()) {
+        entry.path = QString::fromUtf8(longName);
+    } else {
+        QByteArray name = fieldString(header + NAME_OFFSET, NAME_LENGTH);
+        if (std::memcmp(header + MAGIC_OFFSET, "ustar", 5) == 0) {
+            QByteArray prefix = fieldString(header + PREFIX_OFFSET, PREFIX_LENGTH);
+            if (!prefix.isEmpty()) {
+                name = prefix + "/" + name;
+            }
+        }
+        entry.path = QString::fromUtf8(name);
+    }
+
+    entry.linkTarget = QString::fromUtf8(longLink.isEmpty()
+                                         ? fieldString(header + LINKNAME_OFFSET, NAME_LENGTH)
+                                         : longLink);
+    entry.mode = uint(parseNumber(header + MODE_OFFSET, 8)) & 07777;
+    entry.mtime = parseNumber(header + MTIME_OFFSET, NUMERIC_LENGTH);
+    entry.size = size;
+    entry.dataOffset = dataOffset;
+
+    switch (type) {
+    case '0':
+    case '\0':
+    case '7':
+        entry.type = TarEntry::File;
+        break;
+    case '1':
+        entry.type = TarEntry::Hardlink;
+        break;
+    case '2':
+        entry.type = TarEntry::Symlink;
+        break;
+    case '5':
+        entry.type = TarEntry::Directory;
+        break;
+    default:
+        entry.type = TarEntry::Other;
+        break;
+    }
+
+    // Old archives mark directories only by a trailing slash
+    if (entry.type == TarEntry::File && entry.path.endsWith('/')) {
+        entry.type = TarEntry::Directory;
+    }
+
+    return entry;
+}
+
+} // namespace
+
+bool TarArchive::scan(const uchar *data, qint64 length, QVector<TarEntry> *entries, QString *error)
+{
+    QByteArray longName;
+    QByteArray longLink;
+    qint64 paxSize = -1;
+    qint64 offset = 0;
+
+    while (offset + BLOCK_SIZE <= length) {
+        const uchar *header = data + offset;
+
+        if (isZeroBlock(header)) {
+            return true;
+        }
+
+        if (!checksumMatches(header)) {
+            if (error) {
+                *error = QString("Cabecera tar inválida en el desplazamiento %1").arg(offset);
+            }
+            return false;
+        }
+
+        char type = char(header[TYPE_OFFSET]);
+        qint64 size = parseNumber(header + SIZE_OFFSET, NUMERIC_LENGTH);
+        if (paxSize >= 0) {
+            size = paxSize;
+        }
+
+        qint64 dataOffset = offset + BLOCK_SIZE;
+        if (size < 0 || dataOffset + size > length) {
+            if (error) {
+                *error = QString("Archivo tar truncado en el desplazamiento %1").arg(offset);
+            }
+            return false;
+        }
+
+        offset = dataOffset + paddedSize(size);
+
+        // Metadata records that describe the following header
+        if (type == 'L') {
+            longName = fieldString(data + dataOffset, int(size));
+            continue;
+        } else if (type == 'K') {
+            longLink = fieldString(data + dataOffset, int(size));
+            continue;
+        } else if (type == 'x') {
+            QByteArray records(reinterpret_cast<const char *>(data + dataOffset), int(size));
+            parsePax(records, &longName, &longLink, &paxSize);
+            continue;
+        }
+
+        if (type == 'g') {
+            continue;
+        }
+
+        entries->append(entryFromHeader(header, type, longName, longLink, size, dataOffset));
+
+        longName.clear();
+        longLink.clear();
+        paxSize = -1;
+    }
+
+    // A missing end-of-archive marker is tolerated, GNU tar does the same
+    return true;
+}
+
+bool TarStreamScanner::feed(const uchar *data, qint64 length, QString *error)
+{
+    // Metadata bodies are the only thing held in memory, GNU and pax ones are small
+    const qint64 maxCarry = 1024 * 1024;
+
+    QByteArray joined;
+    const uchar *buffer = data;
+    qint64 bufferStart = m_received;
+    qint64 bufferLength = length;
+    if (!m_carry.isEmpty()) {
+        joined = m_carry + QByteArray::fromRawData(reinterpret_cast<const char *>(data), int(length));
+        buffer = reinterpret_cast<const uchar *>(joined.constData());
+        bufferStart -= m_carry.size();
+        bufferLength = joined.size();
+        m_carry.clear();
+    }
+    m_received += length;
+
+    while (!m_ended) {
+        qint64 position = m_nextHeader - bufferStart;
+        if (position >= bufferLength) {
+            // Still inside a body
+            return true;
+        }
+        if (position + TarArchive::BLOCK_SIZE > bufferLength) {
+            m_carry = QByteArray(reinterpret_cast<const char *>(buffer + position), int(bufferLength - position));
+            return true;
+        }
+
+        const uchar *header = buffer + position;
+        if (isZeroBlock(header)) {
+            m_ended = true;
+            return true;
+        }
+
+        if (!checksumMatches(header)) {
+            if (error) {
+                *error = QString("Cabecera tar inválida en el desplazamiento %1").arg(m_nextHeader);
+            }
+            return false;
+        }
+
+        char type = char(header[TYPE_OFFSET]);
+        qint64 size = parseNumber(header + SIZE_OFFSET, NUMERIC_LENGTH);
+        if (m_paxSize >= 0) {
+            size = m_paxSize;
+        }
+        if (size < 0) {
+            if (error) {
+                *error = QString("Cabecera tar inválida en el desplazamiento %1").arg(m_nextHeader);
+            }
+            return false;
+        }
+
+        qint64 dataOffset = m_nextHeader + TarArchive::BLOCK_SIZE;
+        bool metadata = type == 'L' || type == 'K' || type == 'x';
+
+        if (metadata) {
+            qint64 bodyStart = position + TarArchive::BLOCK_SIZE;
+            if (bodyStart + size > bufferLength) {
+                if (bufferLength - position + size > maxCarry) {
+                    if (error) {
+                        *error = QString("Registro de metadatos tar demasiado grande en %1").arg(m_nextHeader);
+                    }
+                    return false;
+                }
+                m_carry = QByteArray(reinterpret_cast<const char *>(header), int(bufferLength - position));
+                return true;
+            }
+
+            if (type == 'L') {
+                m_longName = fieldString(buffer + bodyStart, int(size));
+            } else if (type == 'K') {
+                m_longLink = fieldString(buffer + bodyStart, int(size));
+            } else {
+                QByteArray records(reinterpret_cast<const char *>(buffer + bodyStart), int(size));
+                parsePax(records, &m_longName, &m_longLink, &m_paxSize);
+            }
+        } else if (type != 'g') {
+            m_entries.append(entryFromHeader(header, type, m_longName, m_longLink, size, dataOffset));
+            m_longName.clear();
+            m_longLink.clear();
+            m_paxSize = -1;
+        }
+
+        m_nextHeader = dataOffset + paddedSize(size);
+    }
+
+    return true;
+}
+
+qint64 TarArchive::diskFootprint(const QVector<TarEntry> &entries, qint64 blockSize)
+{
+    qint64 total = 0;
+
+    foreach (const TarEntry &entry, entries) {
+        switch (entry.type) {
+        case TarEntry::File:
+            total += (entry.size + blockSize - 1) / blockSize * blockSize;
+            break;
+        case TarEntry::Directory:
+            total += blockSize;
+            break;
+        default:
+            // Symlinks fit in the inode, hardlinks share the target's blocks
+            break;
+        }
+    }
+
+    return total;
+}
+
+bool TarArchive::extract(int archiveFd, const uchar *data, const TarEntry &entry,
+                         const QString &destRoot, QString *error, ExtractedFile *record)
+{
+    QString relative = safeRelativePath(entry.path);
+    if (entry.type == TarEntry::Directory || entry.type == TarEntry::Other) {
+        return true;
+    }
+
+    // Earlier link entries must not redirect this one out of destRoot
+    QByteArray leaf;
+    int dirFd = SafePath::openParent(destRoot, relative, &leaf);
+    if (dirFd < 0) {
+        if (error) {
+            *error = "Ruta insegura en el tarball: " + entry.path;
+        }
+        return false;
+    }
+
+    if (entry.type == TarEntry::Symlink) {
+        bool ok = ::symlinkat(QFile::encodeName(entry.linkTarget).constData(), dirFd, leaf.constData()) == 0;
+        ::close(dirFd);
+        if (!ok && error) {
+            *error = "No se pudo crear el enlace " + relative;
+        }
+        return ok;
+    }
+
+    if (entry.type == TarEntry::Hardlink) {
+        // The target's parents are checked the same way, and linkat()
+        // without AT_SYMLINK_FOLLOW links a symlink itself, so a hard link
+        // cannot pick up a file outside the tree
+        QString target = safeRelativePath(entry.linkTarget);
+        QByteArray targetLeaf;
+        int targetFd = target.isEmpty() ? -1 : SafePath::openParent(destRoot, target, &targetLeaf);
+        bool ok = targetFd >= 0
+            && ::linkat(targetFd, targetLeaf.constData(), dirFd, leaf.constData(), 0) == 0;
+        if (targetFd >= 0) {
+            ::close(targetFd);
+        }
+        ::close(dirFd);
+        if (!ok && error) {
+            *error = "No se pudo crear el enlace duro " + relative;
+        }
+        return ok;
+    }
+
+    int fd = ::openat(dirFd, leaf.constData(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        ::close(dirFd);
+        if (error) {
+            *error = "No se pudo crear " + relative;
+        }
+        return false;
+    }
+
+    loff_t offset = entry.dataOffset;
+    qint64 remaining = entry.size;
+    bool ok = true;
+
+    // In-kernel copy; reflinks on btrfs and XFS, page cache to page cache elsewhere
+    while (remaining > 0) {
+        ssize_t copied = ::copy_file_range(archiveFd, &offset, fd, nullptr, size_t(remaining), 0);
+        if (copied > 0) {
+            remaining -= copied;
+        } else if (copied < 0 && errno == EINTR) {
+            continue;
+        } else {
+            break;
+        }
+    }
+
+    // Old kernels, or filesystems that refuse the copy: write out of the mapping
+    while (ok && remaining > 0) {
+        ssize_t written = ::write(fd, data + (entry.dataOffset + entry.size - remaining), size_t(remaining));
+        if (written > 0) {
+            remaining -= written;
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else {
+            ok = false;
+        }
+    }
+
+    // fchmod, since the umask would have masked the mode given to open()
+    struct timespec times[2];
+    times[0].tv_sec = times[1].tv_sec = time_t(entry.mtime);
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    ok = ok && ::fchmod(fd, entry.mode) == 0 && ::futimens(fd, times) == 0;
+    ok = ::close(fd) == 0 && ok;
+
+    if (!ok) {
+        if (error) {
+            *error = "Error escribiendo " + relative;
+        }
+        ::unlinkat(dirFd, leaf.constData(), 0);
+    }
+    ::close(dirFd);
+
+    // The archive is read through the mapping for its own hash anyway;
+    // hashing the body here saves the manifest reading the file back
+    if (ok && record) {
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        const qint64 chunkSize = 1024 * 1024;
+        for (qint64 done = 0; done < entry.size; done += chunkSize) {
+            hash.addData(reinterpret_cast<const char *>(data + entry.dataOffset + done),
+                         int(qMin(chunkSize, entry.size - done)));
+        }
+        record->hash = hash.result().toHex();
+        record->size = entry.size;
+        record->mtime = entry.mtime * 1000000000LL;
+    }
+    return ok;
+}
+
+QString TarArchive::safeRelativePath(const QString &path)
+{
+    QString cleaned = QDir::cleanPath(path);
+    if (cleaned.startsWith("./")) {
+        cleaned = cleaned.mid(2);
+    }
+
+    if (cleaned.isEmpty() || cleaned == "." || cleaned == ".." || cleaned.startsWith('/')
+        || cleaned.startsWith("../")) {
+        return QString();
+    }
+    return cleaned;
+}
@@ -0,0 +1,76 @@
+#ifndef TARARCHIVE_H
+#define TARARCHIVE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "InstallManifest.h"
+
+struct TarEntry
+{
+    enum Type {
+        File,
+        Directory,
+        Symlink,
+        Hardlink,
+        Other       // Devices, FIFOs: never extracted
+    };
+
+    QString path;
+    QString linkTarget;
+    Type type = File;
+    uint mode = 0;        // Permission bits only
+    qint64 size = 0;      // Body size in bytes
+    qint64 dataOffset = 0; // Offset of the body from the start of the archive
+    qint64 mtime = 0;     // Seconds since the epoch
+};
+
+// Walks ustar/GNU/pax headers of an uncompressed tar image in memory.
+// Bodies are never touched, so on a mapped file only the header pages are
+// faulted in.
+class TarArchive
+{
+public:
+    static bool scan(const uchar *data, qint64 length, QVector<TarEntry> *entries, QString *error);
+
+    // Bytes the entries will take on a filesystem with the given block size
+    static qint64 diskFootprint(const QVector<TarEntry> &entries, qint64 blockSize = 4096);
+
+    // Writes a file, symlink or hardlink entry below destRoot, whose parent
+    // directories must already exist. File bodies are copied from
+    // archiveFd with copy_file_range(), so they never pass through user
+    // space; data is the same archive mapped, used where the kernel cannot
+    // copy. Fails rather than write through a symlinked parent. Safe to
+    // call from several threads at once. For a file, record receives its
+    // hash, taken from the mapping, size and mtime, for the manifest.
+    static bool extract(int archiveFd, const uchar *data, const TarEntry &entry,
+                        const QString &destRoot, QString *error, ExtractedFile *record = nullptr);
+
+    // Path relative to the extraction root, or empty if it would leave it
+    static QString safeRelativePath(const QString &path);
+
+    static const qint64 BLOCK_SIZE = 512;
+};
+
+// Same header walk as TarArchive::scan(), for a tar stream that arrives in
+// pieces, such as the output of a decompressor. Bodies are skipped without
+// being copied; only a header split across two pieces is buffered.
+class TarStreamScanner
+{
+public:
+    bool feed(const uchar *data, qint64 length, QString *error);
+    bool atEnd() const { return m_ended; }
+    const QVector<TarEntry> &entries() const { return m_entries; }
+
+private:
+    QVector<TarEntry> m_entries;
+    QByteArray m_carry;       // Start of a header record split across feeds
+    QByteArray m_longName;
+    QByteArray m_longLink;
+    qint64 m_paxSize = -1;
+    qint64 m_received = 0;    // Stream offset just past the last byte fed
+    qint64 m_nextHeader = 0;  // Stream offset of the next header block
+    bool m_ended = false;
+};
+
+#endif // TARARCHIVE_H
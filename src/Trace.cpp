@@ -0,0 +1,159 @@
+#include "Trace.h"
+#include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QVector>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+struct TraceEvent
+{
+    const char *name;
+    char phase;       // 'X' complete span, 'C' counter
+    qint64 start;
+    qint64 duration;  // Span length, or the counter value
+    int tid;
+};
+
+QMutex eventMutex;
+QVector<TraceEvent> events;
+
+std::atomic<PhaseTimings *> collector(nullptr);
+std::atomic<int> collectorTid(0);
+
+int currentTid()
+{
+    static thread_local int tid = int(::syscall(SYS_gettid));
+    return tid;
+}
+
+void append(const TraceEvent &event)
+{
+    QMutexLocker locker(&eventMutex);
+    events.append(event);
+}
+
+// Trace event timestamps are microseconds; the fraction keeps nanoseconds
+QString micros(qint64 nanoseconds)
+{
+    return QString::number(nanoseconds / 1000) + "." + QString::number(nanoseconds % 1000).rightJustified(3, '0');
+}
+
+QString quoted(const char *text)
+{
+    QString escaped = QString::fromUtf8(text);
+    escaped.replace("\\", "\\\\").replace("\"", "\\\"");
+    return "\"" + escaped + "\"";
+}
+
+} // namespace
+
+std::atomic<bool> Trace::s_enabled(false);
+std::atomic<bool> Trace::s_active(false);
+
+void Trace::setEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+    updateActive();
+}
+
+void Trace::collect(PhaseTimings *timings)
+{
+    collectorTid.store(timings ? currentTid() : 0);
+    collector.store(timings);
+    updateActive();
+}
+
+void Trace::updateActive()
+{
+    s_active.store(isEnabled() || collector.load(), std::memory_order_relaxed);
+}
+
+qint64 Trace::now()
+{
+    timespec time;
+    ::clock_gettime(CLOCK_MONOTONIC, &time);
+    return qint64(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+void Trace::complete(const char *name, qint64 startNs, qint64 endNs)
+{
+    int tid = currentTid();
+    if (isEnabled()) {
+        append(TraceEvent{ name, 'X', startNs, endNs - startNs, tid });
+    }
+
+    // Only the collecting thread touches the timings, so they need no lock
+    if (tid == collectorTid.load()) {
+        if (PhaseTimings *timings = collector.load()) {
+            timings->add(name, endNs - startNs);
+        }
+    }
+}
+
+void Trace::counter(const char *name, qint64 value)
+{
+    if (isEnabled()) {
+        append(TraceEvent{ name, 'C', now(), value, currentTid() });
+    }
+}
+
+bool Trace::save(const QString &path)
+{
+    QVector<TraceEvent> recorded;
+    {
+        QMutexLocker locker(&eventMutex);
+        recorded = events;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    qint64 pid = QCoreApplication::applicationPid();
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << pid
+        << ",\"args\":{\"name\":" << quoted(QCoreApplication::applicationName().toUtf8().constData()) << "}}";
+
+    foreach (const TraceEvent &event, recorded) {
+        out << ",\n{\"name\":" << quoted(event.name) << ",\"cat\":\"install\",\"ph\":\"" << event.phase
+            << "\",\"ts\":" << micros(event.start) << ",\"pid\":" << pid << ",\"tid\":" << event.tid;
+        if (event.phase == 'X') {
+            out << ",\"dur\":" << micros(event.duration) << "}";
+        } else {
+            out << ",\"args\":{\"value\":" << event.duration << "}}";
+        }
+    }
+
+    out << "\n]}\n";
+    out.flush();
+    return out.status() == QTextStream::Ok && file.commit();
+}
+
+TraceSession::TraceSession(const QString &path)
+    : m_path(path)
+{
+    if (!m_path.isEmpty()) {
+        Trace::setEnabled(true);
+    }
+}
+
+TraceSession::~TraceSession()
+{
+    if (m_path.isEmpty()) {
+        return;
+    }
+
+    Trace::setEnabled(false);
+    if (!Trace::save(m_path)) {
+        QTextStream(stderr) << "No se pudo escribir la traza en " << m_path << "\n";
+    }
+}
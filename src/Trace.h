@@ -0,0 +1,98 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QMap>
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+
+// Durations of the spans closed on one thread, summed by name
+class PhaseTimings
+{
+public:
+    void add(const char *name, qint64 nanoseconds) { m_durations[QString::fromLatin1(name)] += nanoseconds; }
+    QMap<QString, qint64> durations() const { return m_durations; }
+    void clear() { m_durations.clear(); }
+
+private:
+    QMap<QString, qint64> m_durations;
+};
+
+// In-process tracing of install phases, written as Chrome trace event JSON
+// that Perfetto and chrome://tracing open directly. Spans are recorded per
+// thread with nanosecond timestamps. While disabled, a span costs one
+// relaxed load, so instrumentation can stay in release builds.
+class Trace
+{
+public:
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // Also sums the spans closed on the calling thread into timings, traced
+    // or not, until called again with nullptr
+    static void collect(PhaseTimings *timings);
+    // Whether spans need timing at all
+    static bool isActive() { return s_active.load(std::memory_order_relaxed); }
+
+    // CLOCK_MONOTONIC, in nanoseconds
+    static qint64 now();
+
+    // Names must outlive the trace; string literals are meant
+    static void complete(const char *name, qint64 startNs, qint64 endNs);
+    static void counter(const char *name, qint64 value);
+
+    // Writes everything recorded so far
+    static bool save(const QString &path);
+
+private:
+    static void updateActive();
+
+    static std::atomic<bool> s_enabled;
+    static std::atomic<bool> s_active;
+};
+
+// Records the span from construction to destruction, or to end()
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : m_name(Trace::isActive() ? name : nullptr)
+        , m_start(m_name ? Trace::now() : 0)
+    {
+    }
+
+    ~TraceScope() { end(); }
+
+    void end()
+    {
+        if (m_name) {
+            Trace::complete(m_name, m_start, Trace::now());
+            m_name = nullptr;
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(TraceScope)
+
+    const char *m_name;
+    qint64 m_start;
+};
+
+// Enables tracing for its lifetime when given a path, and saves there on exit
+class TraceSession
+{
+public:
+    explicit TraceSession(const QString &path);
+    ~TraceSession();
+
+private:
+    Q_DISABLE_COPY(TraceSession)
+
+    QString m_path;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+#endif // TRACE_H
@@ -0,0 +1,181 @@
+#include "UpdateChecker.h"
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QCoreApplication>
+#include <QTimer>
+
+UpdateChecker::UpdateChecker(QNetworkAccessManager *manager, QObject *parent)
+    : QObject(parent)
+    , m_manager(manager ? manager : new QNetworkAccessManager(this))
+    , m_maxConcurrent(8)
+    , m_timeout(15000)
+    , m_completed(0)
+{
+}
+
+void UpdateChecker::setMaxConcurrentRequests(int count)
+{
+    m_maxConcurrent = qMax(1, count);
+}
+
+void UpdateChecker::setRequestTimeout(int msecs)
+{
+    m_timeout = msecs;
+}
+
+bool UpdateChecker::isRunning() const
+{
+    return !m_inFlight.isEmpty() || !m_pending.isEmpty();
+}
+
+void UpdateChecker::check(const QVector<UpdateCheckTarget> &targets)
+{
+    if (isRunning()) {
+        return;
+    }
+
+    m_targets = targets;
+    m_results = QVector<UpdateCheckResult>(targets.size());
+    m_completed = 0;
+
+    // Reported from the event loop like any other result, so that callers
+    // which connect to finished() and then start their loop still see it
+    if (targets.isEmpty()) {
+        QTimer::singleShot(0, this, [this]() {
+            emit finished(QVector<UpdateCheckResult>());
+        });
+        return;
+    }
+
+    for (int i = 0; i < targets.size(); ++i) {
+        m_pending.enqueue(i);
+    }
+
+    startNext();
+}
+
+void UpdateChecker::startNext()
+{
+    while (m_inFlight.size() < m_maxConcurrent && !m_pending.isEmpty()) {
+        sendRequest(m_pending.dequeue(), false);
+    }
+}
+
+void UpdateChecker::sendRequest(int index, bool useGet)
+{
+    const UpdateCheckTarget &target = m_targets.at(index);
+
+    QNetworkRequest request(target.url);
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+    request.setHeader(QNetworkRequest::UserAgentHeader,
+                      QCoreApplication::applicationName() + "/" + QCoreApplication::applicationVersion());
+
+    if (!target.etag.isEmpty()) {
+        request.setRawHeader("If-None-Match", target.etag.toUtf8());
+    }
+    if (!target.lastModified.isEmpty()) {
+        request.setRawHeader("If-Modified-Since", target.lastModified.toUtf8());
+    }
+
+    QNetworkReply *reply = useGet ? m_manager->get(request) : m_manager->head(request);
+    m_inFlight.insert(reply, index);
+    m_isGet.insert(reply, useGet);
+
+    if (useGet) {
+        // Only the headers of the final response matter, never the payload
+        connect(reply, &QNetworkReply::metaDataChanged, reply, [reply]() {
+            int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (status < 300 || status >= 400) {
+                reply->setProperty("vscipHeadersOnly", true);
+                reply->abort();
+            }
+        });
+    }
+
+    QTimer::singleShot(m_timeout, reply, [reply]() {
+        if (reply->isRunning()) {
+            reply->setProperty("vscipTimedOut", true);
+            reply->abort();
+        }
+    });
+
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        onReplyFinished(reply);
+    });
+}
+
+void UpdateChecker::onReplyFinished(QNetworkReply *reply)
+{
+    int index = m_inFlight.take(reply);
+    bool wasGet = m_isGet.take(reply);
+    reply->deleteLater();
+
+    // Some servers refuse HEAD; retry the same slot with a GET
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (!wasGet && (status == 405 || status == 501)) {
+        sendRequest(index, true);
+        return;
+    }
+
+    m_results[index] = evaluate(m_targets.at(index), reply);
+    m_completed++;
+    emit resultReady(m_results.at(index));
+
+    if (m_completed == m_targets.size()) {
+        emit finished(m_results);
+        return;
+    }
+
+    startNext();
+}
+
+UpdateCheckResult UpdateChecker::evaluate(const UpdateCheckTarget &target, QNetworkReply *reply) const
+{
+    UpdateCheckResult result;
+    result.appName = target.appName;
+    result.httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    bool headersOnly = reply->property("vscipHeadersOnly").toBool();
+
+    if (reply->property("vscipTimedOut").toBool()) {
+        result.failed = true;
+        result.errorString = "Tiempo de espera agotado";
+        return result;
+    }
+
+    if (result.httpStatus == 304) {
+        // Unchanged: keep the validators we already have
+        result.etag = target.etag;
+        result.lastModified = target.lastModified;
+        result.resolvedUrl = target.resolvedUrl;
+        result.contentLength = target.contentLength;
+        return result;
+    }
+
+    if (reply->error() != QNetworkReply::NoError
+        && !(headersOnly && reply->error() == QNetworkReply::OperationCanceledError)) {
+        result.failed = true;
+        result.errorString = reply->errorString();
+        return result;
+    }
+
+    result.etag = QString::fromUtf8(reply->rawHeader("ETag"));
+    result.lastModified = QString::fromUtf8(reply->rawHeader("Last-Modified"));
+    result.resolvedUrl = reply->url().toString();
+    QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+    result.contentLength = length.isValid() ? length.toLongLong() : -1;
+
+    // Strongest validator first; without any baseline there is nothing to compare
+    if (!target.etag.isEmpty() && !result.etag.isEmpty()) {
+        result.updateAvailable = result.etag != target.etag;
+    } else if (!target.lastModified.isEmpty() && !result.lastModified.isEmpty()) {
+        result.updateAvailable = result.lastModified != target.lastModified;
+    } else if (!target.resolvedUrl.isEmpty()) {
+        result.updateAvailable = result.resolvedUrl != target.resolvedUrl;
+    } else if (target.contentLength > 0 && result.contentLength > 0) {
+        result.updateAvailable = result.contentLength != target.contentLength;
+    }
+
+    return result;
+}
@@ -0,0 +1,77 @@
+#ifndef UPDATECHECKER_H
+#define UPDATECHECKER_H
+
+#include <QObject>
+#include <QUrl>
+#include <QQueue>
+#include <QVector>
+#include <QHash>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+struct UpdateCheckTarget
+{
+    QString appName;
+    QUrl url;             // URL the app was installed from, often a "latest" link
+    // Validators recorded when the installed payload was downloaded
+    QString etag;
+    QString lastModified;
+    QString resolvedUrl;  // Final URL after redirects
+    qint64 contentLength = -1;
+};
+
+struct UpdateCheckResult
+{
+    QString appName;
+    bool updateAvailable = false;
+    bool failed = false;
+    QString errorString;
+    int httpStatus = 0;
+    QString etag;
+    QString lastModified;
+    QString resolvedUrl;
+    qint64 contentLength = -1;
+};
+
+// Asks the origin of every registered app whether its payload changed,
+// without downloading it: a conditional HEAD (falling back to a GET that is
+// aborted once headers arrive) with If-None-Match / If-Modified-Since.
+// Redirects are followed so "latest" links resolve to the versioned file.
+// At most maxConcurrentRequests are in flight at once.
+class UpdateChecker : public QObject
+{
+    Q_OBJECT
+
+public:
+    // A custom manager can be injected, e.g. one pointed at a local HTTP stand-in
+    explicit UpdateChecker(QNetworkAccessManager *manager = nullptr, QObject *parent = nullptr);
+
+    void setMaxConcurrentRequests(int count);
+    void setRequestTimeout(int msecs);
+
+    void check(const QVector<UpdateCheckTarget> &targets);
+    bool isRunning() const;
+
+signals:
+    void resultReady(const UpdateCheckResult &result);
+    void finished(const QVector<UpdateCheckResult> &results);
+
+private:
+    void startNext();
+    void sendRequest(int index, bool useGet);
+    void onReplyFinished(QNetworkReply *reply);
+    UpdateCheckResult evaluate(const UpdateCheckTarget &target, QNetworkReply *reply) const;
+
+    QNetworkAccessManager *m_manager;
+    QVector<UpdateCheckTarget> m_targets;
+    QVector<UpdateCheckResult> m_results;
+    QQueue<int> m_pending;
+    QHash<QNetworkReply *, int> m_inFlight;
+    QHash<QNetworkReply *, bool> m_isGet;
+    int m_maxConcurrent;
+    int m_timeout;
+    int m_completed;
+};
+
+#endif // UPDATECHECKER_H
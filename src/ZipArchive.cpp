@@ -0,0 +1,430 @@
+#include "ZipArchive.h"
+#include "SafePath.h"
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDate>
+#include <QDateTime>
+#include <QStringList>
+#include <QTime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+namespace {
+
+const quint32 LOCAL_HEADER_SIGNATURE = 0x04034b50;
+const quint32 CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+const quint32 END_SIGNATURE = 0x06054b50;
+const quint32 ZIP64_END_SIGNATURE = 0x06064b50;
+const quint32 ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+
+const int LOCAL_HEADER_SIZE = 30;
+const int CENTRAL_HEADER_SIZE = 46;
+const int END_SIZE = 22;
+const int ZIP64_LOCATOR_SIZE = 20;
+const int ZIP64_END_SIZE = 56;
+const int MAX_COMMENT_LENGTH = 0xffff;
+
+const quint16 ZIP64_EXTRA_ID = 0x0001;
+const quint16 TIMESTAMP_EXTRA_ID = 0x5455;
+
+const quint16 FLAG_ENCRYPTED = 0x0001;
+const int HOST_UNIX = 3;
+
+const qint64 OUTPUT_CHUNK = 256 * 1024;
+
+quint16 read16(const uchar *p)
+{
+    return quint16(p[0] | (p[1] << 8));
+}
+
+quint32 read32(const uchar *p)
+{
+    return quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16) | (quint32(p[3]) << 24);
+}
+
+qint64 read64(const uchar *p)
+{
+    return qint64(read32(p)) | (qint64(read32(p + 4)) << 32);
+}
+
+void setError(QString *error, const QString &message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+// MS-DOS date and time fields, in local time with two second resolution
+qint64 dosTimeToEpoch(quint16 time, quint16 date)
+{
+    QDate day(1980 + (date >> 9), (date >> 5) & 0x0f, date & 0x1f);
+    QTime clock(time >> 11, (time >> 5) & 0x3f, (time & 0x1f) * 2);
+    if (!day.isValid() || !clock.isValid()) {
+        return 0;
+    }
+    return QDateTime(day, clock).toSecsSinceEpoch();
+}
+
+// Zip64 and Info-ZIP timestamp extra fields override the 32-bit header values
+void parseExtra(const uchar *extra, int length, ZipEntry *entry,
+                bool sizeOverflow, bool compressedOverflow, bool offsetOverflow)
+{
+    int pos = 0;
+    while (pos + 4 <= length) {
+        quint16 id = read16(extra + pos);
+        int size = read16(extra + pos + 2);
+        const uchar *body = extra + pos + 4;
+        if (pos + 4 + size > length) {
+            return;
+        }
+
+        if (id == ZIP64_EXTRA_ID) {
+            // Only the fields saturated in the header are present, in this order
+            int field = 0;
+            if (sizeOverflow && field + 8 <= size) {
+                entry->size = read64(body + field);
+                field += 8;
+            }
+            if (compressedOverflow && field + 8 <= size) {
+                entry->compressedSize = read64(body + field);
+                field += 8;
+            }
+            if (offsetOverflow && field + 8 <= size) {
+                entry->localHeaderOffset = read64(body + field);
+            }
+        } else if (id == TIMESTAMP_EXTRA_ID && size >= 5 && (body[0] & 0x01)) {
+            entry->mtime = qint32(read32(body + 1));
+        }
+
+        pos += 4 + size;
+    }
+}
+
+bool isSafePath(const QString &path)
+{
+    if (path.isEmpty() || path.startsWith('/')) {
+        return false;
+    }
+    foreach (const QString &part, path.split('/')) {
+        if (part == "..") {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Start of the entry's data, past its local header
+bool dataRange(const uchar *data, qint64 length, const ZipEntry &entry, const uchar **begin, QString *error)
+{
+    qint64 offset = entry.localHeaderOffset;
+    if (offset < 0 || offset + LOCAL_HEADER_SIZE > length || read32(data + offset) != LOCAL_HEADER_SIGNATURE) {
+        setError(error, "Cabecera local zip inválida para " + entry.path);
+        return false;
+    }
+
+    // The local name and extra lengths may differ from the central ones
+    qint64 start = offset + LOCAL_HEADER_SIZE + read16(data + offset + 26) + read16(data + offset + 28);
+    if (start + entry.compressedSize > length) {
+        setError(error, "Archivo zip truncado en " + entry.path);
+        return false;
+    }
+
+    *begin = data + start;
+    return true;
+}
+
+// Inflates or copies the entry, handing each uncompressed chunk to sink
+template <typename Sink>
+bool decode(const uchar *input, const ZipEntry &entry, Sink sink, QString *error)
+{
+    quint32 crc = ::crc32(0L, Z_NULL, 0);
+
+    if (entry.method == 0) {
+        qint64 pos = 0;
+        while (pos < entry.size) {
+            qint64 chunk = qMin(OUTPUT_CHUNK, entry.size - pos);
+            crc = ::crc32(crc, input + pos, uInt(chunk));
+            if (!sink(input + pos, chunk)) {
+                return false;
+            }
+            pos += chunk;
+        }
+    } else {
+        z_stream stream = {};
+        // Negative window bits: raw deflate, zip has no zlib header
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+            setError(error, "No se pudo inicializar zlib");
+            return false;
+        }
+
+        QByteArray output(int(OUTPUT_CHUNK), Qt::Uninitialized);
+        qint64 consumed = 0;
+        qint64 produced = 0;
+        int status = Z_OK;
+
+        while (status != Z_STREAM_END) {
+            if (stream.avail_in == 0) {
+                // avail_in is 32-bit, so larger entries are fed in slices
+                qint64 slice = qMin<qint64>(entry.compressedSize - consumed, 1 << 30);
+                if (slice <= 0) {
+                    break;
+                }
+                stream.next_in = const_cast<Bytef *>(input + consumed);
+                stream.avail_in = uInt(slice);
+                consumed += slice;
+            }
+
+            stream.next_out = reinterpret_cast<Bytef *>(output.data());
+            stream.avail_out = uInt(output.size());
+            status = inflate(&stream, Z_NO_FLUSH);
+            if (status != Z_OK && status != Z_STREAM_END) {
+                break;
+            }
+
+            qint64 chunk = output.size() - stream.avail_out;
+            const uchar *bytes = reinterpret_cast<const uchar *>(output.constData());
+            crc = ::crc32(crc, bytes, uInt(chunk));
+            produced += chunk;
+            if (produced > entry.size || !sink(bytes, chunk)) {
+                inflateEnd(&stream);
+                setError(error, "Error escribiendo " + entry.path);
+                return false;
+            }
+        }
+        inflateEnd(&stream);
+
+        if (status != Z_STREAM_END || produced != entry.size) {
+            setError(error, "Datos comprimidos dañados en " + entry.path);
+            return false;
+        }
+    }
+
+    if (crc != entry.crc32) {
+        setError(error, "CRC-32 incorrecto en " + entry.path);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool ZipArchive::scan(const uchar *data, qint64 length, QVector<ZipEntry> *entries, QString *error)
+{
+    // The end record sits before an optional trailing comment of up to 64 KiB
+    qint64 end = -1;
+    for (qint64 pos = length - END_SIZE; pos >= 0 && pos >= length - END_SIZE - MAX_COMMENT_LENGTH; --pos) {
+        if (read32(data + pos) == END_SIGNATURE) {
+            end = pos;
+            break;
+        }
+    }
+    if (end < 0) {
+        setError(error, "No es un archivo zip: falta el directorio central");
+        return false;
+    }
+
+    qint64 count = read16(data + end + 10);
+    qint64 directorySize = read32(data + end + 12);
+    qint64 directoryOffset = read32(data + end + 16);
+
+    qint64 locator = end - ZIP64_LOCATOR_SIZE;
+    if (locator >= 0 && read32(data + locator) == ZIP64_LOCATOR_SIGNATURE) {
+        qint64 zip64End = read64(data + locator + 8);
+        if (zip64End < 0 || zip64End + ZIP64_END_SIZE > length || read32(data + zip64End) != ZIP64_END_SIGNATURE) {
+            setError(error, "Registro zip64 inválido");
+            return false;
+        }
+        count = read64(data + zip64End + 32);
+        directorySize = read64(data + zip64End + 40);
+        directoryOffset = read64(data + zip64End + 48);
+    }
+
+    if (directoryOffset < 0 || directorySize < 0 || directoryOffset + directorySize > length) {
+        setError(error, "Directorio central zip fuera del archivo");
+        return false;
+    }
+
+    entries->clear();
+    entries->reserve(int(qMin<qint64>(count, directorySize / CENTRAL_HEADER_SIZE)));
+
+    qint64 pos = directoryOffset;
+    const qint64 directoryEnd = directoryOffset + directorySize;
+    for (qint64 i = 0; i < count; ++i) {
+        if (pos + CENTRAL_HEADER_SIZE > directoryEnd || read32(data + pos) != CENTRAL_HEADER_SIGNATURE) {
+            setError(error, QString("Cabecera central zip inválida en el desplazamiento %1").arg(pos));
+            return false;
+        }
+
+        const uchar *header = data + pos;
+        int nameLength = read16(header + 28);
+        int extraLength = read16(header + 30);
+        int commentLength = read16(header + 32);
+        if (pos + CENTRAL_HEADER_SIZE + nameLength + extraLength + commentLength > directoryEnd) {
+            setError(error, QString("Cabecera central zip truncada en el desplazamiento %1").arg(pos));
+            return false;
+        }
+
+        ZipEntry entry;
+        // Bit 11 flags UTF-8; older archivers wrote their local code page, for
+        // which UTF-8 is still the best guess on Linux
+        QByteArray name(reinterpret_cast<const char *>(header + CENTRAL_HEADER_SIZE), nameLength);
+        entry.path = QString::fromUtf8(name);
+
+        quint16 flags = read16(header + 8);
+        entry.method = read16(header + 10);
+        entry.crc32 = read32(header + 16);
+        entry.compressedSize = read32(header + 20);
+        entry.size = read32(header + 24);
+        entry.localHeaderOffset = read32(header + 42);
+        entry.mtime = dosTimeToEpoch(read16(header + 12), read16(header + 14));
+
+        parseExtra(header + CENTRAL_HEADER_SIZE + nameLength, extraLength, &entry,
+                   entry.size == 0xffffffff, entry.compressedSize == 0xffffffff,
+                   entry.localHeaderOffset == 0xffffffff);
+
+        // Unix hosts keep st_mode in the high half of the external attributes
+        int host = read16(header + 4) >> 8;
+        uint unixMode = read32(header + 38) >> 16;
+        bool directory = entry.path.endsWith('/');
+
+        if (host == HOST_UNIX && unixMode != 0) {
+            if (S_ISLNK(unixMode)) {
+                entry.type = ZipEntry::Symlink;
+            } else if (S_ISDIR(unixMode) || directory) {
+                entry.type = ZipEntry::Directory;
+            }
+            entry.mode = unixMode & 07777;
+        } else {
+            entry.type = directory ? ZipEntry::Directory : ZipEntry::File;
+            entry.mode = directory ? 0755 : 0644;
+        }
+
+        if (directory) {
+            entry.path.chop(1);
+        }
+
+        if (!isSafePath(entry.path)) {
+            setError(error, "Ruta insegura en el archivo zip: " + QString::fromUtf8(name));
+            return false;
+        }
+        if (flags & FLAG_ENCRYPTED) {
+            setError(error, "Entrada zip cifrada no soportada: " + entry.path);
+            return false;
+        }
+        if (entry.type != ZipEntry::Directory && entry.method != 0 && entry.method != 8) {
+            setError(error, QString("Método de compresión zip %1 no soportado: %2").arg(entry.method).arg(entry.path));
+            return false;
+        }
+
+        if (entry.method == 0 && entry.size != entry.compressedSize) {
+            setError(error, "Tamaño inconsistente en la entrada zip: " + entry.path);
+            return false;
+        }
+
+        entries->append(entry);
+        pos += CENTRAL_HEADER_SIZE + nameLength + extraLength + commentLength;
+    }
+
+    return true;
+}
+
+bool ZipArchive::extract(const uchar *data, qint64 length, const ZipEntry &entry,
+                         const QString &destRoot, QString *error, ExtractedFile *record)
+{
+    const uchar *input = nullptr;
+    if (!dataRange(data, length, entry, &input, error)) {
+        return false;
+    }
+
+    // Earlier symlink entries must not redirect this one out of destRoot
+    QByteArray leaf;
+    int dirFd = SafePath::openParent(destRoot, entry.path, &leaf);
+    if (dirFd < 0) {
+        setError(error, "Ruta insegura en el zip: " + entry.path);
+        return false;
+    }
+
+    if (entry.type == ZipEntry::Symlink) {
+        QByteArray target;
+        auto append = [&target](const uchar *bytes, qint64 size) {
+            target.append(reinterpret_cast<const char *>(bytes), int(size));
+            return true;
+        };
+        bool ok = decode(input, entry, append, error);
+        if (ok && ::symlinkat(target.constData(), dirFd, leaf.constData()) != 0) {
+            setError(error, "No se pudo crear el enlace " + entry.path);
+            ok = false;
+        }
+        ::close(dirFd);
+        return ok;
+    }
+
+    int fd = ::openat(dirFd, leaf.constData(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        ::close(dirFd);
+        setError(error, "No se pudo crear " + entry.path);
+        return false;
+    }
+
+    // Hashed as inflated, so the manifest need not read the file back
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    auto writeOut = [fd, record, &hash](const uchar *bytes, qint64 size) {
+        if (record) {
+            hash.addData(reinterpret_cast<const char *>(bytes), int(size));
+        }
+        while (size > 0) {
+            ssize_t written = ::write(fd, bytes, size_t(size));
+            if (written <= 0) {
+                return false;
+            }
+            bytes += written;
+            size -= written;
+        }
+        return true;
+    };
+
+    bool decoded = decode(input, entry, writeOut, error);
+
+    // fchmod, since the umask would have masked the mode given to open()
+    struct timespec times[2];
+    times[0].tv_sec = times[1].tv_sec = time_t(entry.mtime);
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    bool ok = decoded && ::fchmod(fd, entry.mode) == 0 && ::futimens(fd, times) == 0;
+    ok = ::close(fd) == 0 && ok;
+
+    if (!ok) {
+        if (decoded) {
+            setError(error, "Error escribiendo " + entry.path);
+        }
+        ::unlinkat(dirFd, leaf.constData(), 0);
+    } else if (record) {
+        record->hash = hash.result().toHex();
+        record->size = entry.size;
+        record->mtime = entry.mtime * 1000000000LL;
+    }
+    ::close(dirFd);
+    return ok;
+}
+
+qint64 ZipArchive::diskFootprint(const QVector<ZipEntry> &entries, qint64 blockSize)
+{
+    qint64 total = 0;
+
+    foreach (const ZipEntry &entry, entries) {
+        switch (entry.type) {
+        case ZipEntry::File:
+            total += (entry.size + blockSize - 1) / blockSize * blockSize;
+            break;
+        case ZipEntry::Directory:
+            total += blockSize;
+            break;
+        default:
+            // Short symlinks fit in the inode
+            break;
+        }
+    }
+
+    return total;
+}
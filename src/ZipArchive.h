@@ -0,0 +1,48 @@
+#ifndef ZIPARCHIVE_H
+#define ZIPARCHIVE_H
+
+#include <QString>
+#include <QVector>
+#include "InstallManifest.h"
+
+struct ZipEntry
+{
+    enum Type {
+        File,
+        Directory,
+        Symlink     // Body holds the link target
+    };
+
+    QString path;
+    Type type = File;
+    uint mode = 0;              // Permission bits only
+    quint16 method = 0;         // 0 stored, 8 deflated
+    quint32 crc32 = 0;
+    qint64 compressedSize = 0;
+    qint64 size = 0;            // Uncompressed size in bytes
+    qint64 localHeaderOffset = 0;
+    qint64 mtime = 0;           // Seconds since the epoch
+};
+
+// Reads zip archives from memory. The central directory lists every entry
+// with its offset, so entries can be inflated independently and in any
+// order; extract() is safe to call from several threads at once.
+class ZipArchive
+{
+public:
+    // Reads the central directory, including zip64 records. Fails on
+    // encrypted entries, unsupported methods and paths leaving the root.
+    static bool scan(const uchar *data, qint64 length, QVector<ZipEntry> *entries, QString *error);
+
+    // Writes a file or symlink entry below destRoot, whose parent
+    // directories must already exist, and checks its CRC-32. Fails
+    // rather than write through a symlinked parent. For a file, record
+    // receives the hash of the inflated bytes, size and mtime.
+    static bool extract(const uchar *data, qint64 length, const ZipEntry &entry,
+                        const QString &destRoot, QString *error, ExtractedFile *record = nullptr);
+
+    // Bytes the entries will take on a filesystem with the given block size
+    static qint64 diskFootprint(const QVector<ZipEntry> &entries, qint64 blockSize = 4096);
+};
+
+#endif // ZIPARCHIVE_H
@@ -1,19 +1,297 @@
 #include <QApplication>
 #include <QStyleFactory>
 #include <QDir>
+#include <QFile>
 #include <QStandardPaths>
 #include <QCommandLineParser>
 #include <QTimer>
+#include <QTextStream>
 #include "MainWindow.h"
+#include "Installer.h"
+#include "DiskPreflight.h"
+#include "ArchiveIndex.h"
+#include "Trace.h"
 
-int main(int argc, char *argv[])
+static void setApplicationInfo(QCoreApplication &app)
 {
-    QApplication app(argc, argv);
-    
     app.setApplicationName("VSC-INSTALLER-PLUS");
     app.setApplicationVersion("1.0.0");
     app.setOrganizationName("VSC-Installer-Plus");
     app.setOrganizationDomain("vscinstallerplus.local");
+}
+
+// Commands that run without a display, e.g. from ssh or a fleet-wide cron job
+static bool isHeadlessCommand(int argc, char *argv[])
+{
+    static const QStringList headlessOptions = { "--verify", "--dedupe-report", "--check-updates", "--prefetch-updates", "--install", "--warmup", "--archive-cat", "--stats" };
+    
+    for (int i = 1; i < argc; ++i) {
+        QString arg = QString::fromLocal8Bit(argv[i]);
+        foreach (const QString &option, headlessOptions) {
+            if (arg == option || arg.startsWith(option + "=")) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static QCommandLineOption backgroundOption()
+{
+    return QCommandLineOption(QStringList() << "background", 
+                              "Instalar con prioridad mínima de CPU y E/S, sin llenar la caché de páginas");
+}
+
+static QCommandLineOption ioLimitOption()
+{
+    return QCommandLineOption(QStringList() << "io-limit", 
+                              "Límite de escritura durante la instalación", "MB/s");
+}
+
+static QCommandLineOption preloadOption()
+{
+    return QCommandLineOption(QStringList() << "preload", 
+                              "Precargar en memoria los archivos de arranque tras instalar");
+}
+
+static QCommandLineOption dedupeOption()
+{
+    return QCommandLineOption(QStringList() << "dedupe", 
+                              "Compartir archivos idénticos con otras aplicaciones instaladas, "
+                              "mediante reflinks (btrfs, XFS); en otros sistemas de archivos no se comparte nada");
+}
+
+static QCommandLineOption dedupeHardlinksOption()
+{
+    return QCommandLineOption(QStringList() << "dedupe-hardlinks", 
+                              "Con --dedupe: sin reflinks, compartir con enlaces duros. Las aplicaciones "
+                              "comparten entonces el mismo archivo y escribir en uno cambia todos");
+}
+
+static QCommandLineOption sha256Option()
+{
+    return QCommandLineOption(QStringList() << "sha256", 
+                              "Suma SHA-256 esperada del paquete", "suma");
+}
+
+static QCommandLineOption traceOutOption()
+{
+    return QCommandLineOption(QStringList() << "trace-out", 
+                              "Guardar una traza de las fases de instalación (Perfetto / chrome://tracing)", "archivo.json");
+}
+
+static IoPolicy ioPolicyFromArguments(const QCommandLineParser &parser)
+{
+    IoPolicy policy;
+    policy.idlePriority = parser.isSet("background");
+    policy.dropCache = policy.idlePriority;
+    policy.writeBytesPerSecond = parser.value("io-limit").toLongLong() * 1024 * 1024;
+    return policy;
+}
+
+static int runHeadless(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    setApplicationInfo(app);
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Gestor de instalación de tarballs para Linux");
+    parser.addHelpOption();
+    
+    QCommandLineOption verifyOption(QStringList() << "verify", 
+                                  "Verificar las aplicaciones instaladas contra su manifiesto");
+    QCommandLineOption appOption(QStringList() << "app", 
+                               "Limitar la operación a una aplicación (repetible)", "nombre");
+    QCommandLineOption fullOption(QStringList() << "full", 
+                                "Releer todos los archivos aunque no hayan cambiado");
+    
+    QCommandLineOption dedupeReportOption(QStringList() << "dedupe-report", 
+                                        "Mostrar el informe de deduplicación");
+    QCommandLineOption checkUpdatesOption(QStringList() << "check-updates", 
+                                        "Buscar actualizaciones de las aplicaciones instaladas desde URL");
+    QCommandLineOption prefetchUpdatesOption(QStringList() << "prefetch-updates", 
+                                           "Buscar actualizaciones y dejarlas preparadas para aplicarlas al instante");
+    
+    parser.addOption(verifyOption);
+    parser.addOption(appOption);
+    parser.addOption(fullOption);
+    parser.addOption(dedupeReportOption);
+    parser.addOption(checkUpdatesOption);
+    parser.addOption(prefetchUpdatesOption);
+    
+    QCommandLineOption installOption(QStringList() << "install", 
+                                   "Instalar sin interfaz desde un archivo local o una URL", "origen");
+    QCommandLineOption installPathOption(QStringList() << "install-path", 
+                                       "Ruta de instalación", "ruta", "/opt");
+    QCommandLineOption createDesktopOption(QStringList() << "create-desktop", 
+                                         "Crear entrada en el menú de aplicaciones");
+    QCommandLineOption createSymlinkOption(QStringList() << "create-symlink", 
+                                         "Crear enlace simbólico en /usr/local/bin");
+    
+    parser.addOption(installOption);
+    parser.addOption(installPathOption);
+    parser.addOption(createDesktopOption);
+    parser.addOption(createSymlinkOption);
+    parser.addOption(dedupeOption());
+    parser.addOption(dedupeHardlinksOption());
+    parser.addOption(sha256Option());
+    parser.addOption(backgroundOption());
+    parser.addOption(ioLimitOption());
+    parser.addOption(preloadOption());
+    parser.addOption(traceOutOption());
+    
+    QCommandLineOption warmupOption(QStringList() << "warmup", 
+                                  "Aprender el perfil de arranque y precargarlo en memoria, p. ej. al iniciar sesión");
+    parser.addOption(warmupOption);
+    
+    QCommandLineOption archiveCatOption(QStringList() << "archive-cat", 
+                                      "Escribir en la salida un archivo contenido en el paquete, sin extraerlo entero", "paquete");
+    parser.addOption(archiveCatOption);
+    parser.addPositionalArgument("ruta", "Con --archive-cat: ruta o final de ruta del archivo a leer");
+    
+    QCommandLineOption statsOption(QStringList() << "stats", 
+                                 "Mostrar percentiles de la duración de cada fase de instalación por aplicación");
+    QCommandLineOption prometheusOption(QStringList() << "prometheus", 
+                                      "Con --stats: escribir además las métricas en formato textfile de Prometheus", "archivo.prom");
+    parser.addOption(statsOption);
+    parser.addOption(prometheusOption);
+    
+    parser.process(app);
+    
+    TraceSession trace(parser.value("trace-out"));
+    
+    if (parser.isSet(archiveCatOption)) {
+        QString archivePath = parser.value(archiveCatOption);
+        ArchiveIndex index;
+        if (!index.load(archivePath) && !(ArchiveIndex::build(archivePath) && index.load(archivePath))) {
+            QTextStream(stderr) << "No se pudo indexar " << archivePath << "\n";
+            return 1;
+        }
+        
+        QByteArray contents;
+        if (!index.read(index.find(parser.positionalArguments().value(0)), &contents)) {
+            QTextStream(stderr) << "No se encontró " << parser.positionalArguments().value(0) << "\n";
+            return 1;
+        }
+        
+        QFile output;
+        output.open(stdout, QIODevice::WriteOnly);
+        output.write(contents);
+        return 0;
+    }
+    
+    QTextStream out(stdout);
+    Installer installer;
+    QObject::connect(&installer, &Installer::logMessage, [&out](const QString &message) {
+        out << message << "\n";
+        out.flush();
+    });
+    
+    if (parser.isSet(installOption)) {
+        QString source = parser.value(installOption);
+        installer.setIoPolicy(ioPolicyFromArguments(parser));
+        installer.setWarmupEnabled(parser.isSet("preload"));
+        installer.setExpectedSha256(parser.value("sha256"));
+        installer.setDeduplicationEnabled(parser.isSet("dedupe"), parser.isSet("dedupe-hardlinks"));
+        
+        bool ok;
+        if (source.contains("://")) {
+            ok = installer.installFromUrl(QUrl(source), parser.value(installPathOption), 
+                                          parser.isSet(createDesktopOption), parser.isSet(createSymlinkOption));
+        } else {
+            ok = installer.installFromLocalFile(source, parser.value(installPathOption), 
+                                                parser.isSet(createDesktopOption), parser.isSet(createSymlinkOption));
+        }
+        installer.waitForArchiveCache();
+        return ok ? 0 : 1;
+    }
+    
+    if (parser.isSet(warmupOption)) {
+        QStringList apps = parser.values(appOption);
+        if (apps.isEmpty()) {
+            apps = installer.getInstalledApps();
+        }
+        
+        bool ok = true;
+        foreach (const QString &appName, apps) {
+            installer.learnWarmupProfile(appName);
+            ok = installer.warmUpApp(appName, true) && ok;
+        }
+        return ok ? 0 : 1;
+    }
+    
+    if (parser.isSet(verifyOption)) {
+        bool clean = installer.verifyInstalledApps(parser.values(appOption), parser.isSet(fullOption));
+        return clean ? 0 : 1;
+    }
+    
+    if (parser.isSet(prefetchUpdatesOption)) {
+        // Meant for timers that already pick quiet hours, so no idle check here
+        QObject::connect(&installer, &Installer::updateCheckCompleted, &app, [&app, &installer](const QStringList &updates) {
+            bool ok = true;
+            foreach (const QString &appName, updates) {
+                ok = installer.prefetchUpdate(appName) && ok;
+            }
+            app.exit(ok ? 0 : 1);
+        });
+        installer.checkForUpdates();
+        return app.exec();
+    }
+    
+    if (parser.isSet(checkUpdatesOption)) {
+        QObject::connect(&installer, &Installer::updateCheckCompleted, &app, [&app](const QStringList &updates) {
+            // Exit code 2 lets scripts tell "updates pending" apart from errors
+            app.exit(updates.isEmpty() ? 0 : 2);
+        });
+        installer.checkForUpdates();
+        return app.exec();
+    }
+    
+    if (parser.isSet(statsOption)) {
+        QStringList apps = parser.values(appOption);
+        QVector<PhaseStats> stats = installer.installStats(apps);
+        if (stats.isEmpty()) {
+            out << "No hay instalaciones registradas\n";
+        } else {
+            out << QString("%1 %2 %3 %4 %5 %6\n").arg("Aplicación", -20).arg("Fase", -20).arg("N", 5)
+                   .arg("p50 (s)", 10).arg("p90 (s)", 10).arg("p99 (s)", 10);
+        }
+        foreach (const PhaseStats &entry, stats) {
+            out << QString("%1 %2 %3 %4 %5 %6\n").arg(entry.appName, -20).arg(entry.phase, -20).arg(entry.count, 5)
+                   .arg(entry.p50, 10, 'f', 3).arg(entry.p90, 10, 'f', 3).arg(entry.p99, 10, 'f', 3);
+        }
+        out.flush();
+        
+        if (parser.isSet(prometheusOption) && !installer.exportInstallMetrics(parser.value(prometheusOption), apps)) {
+            QTextStream(stderr) << "No se pudo escribir " << parser.value(prometheusOption) << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    
+    if (parser.isSet(dedupeReportOption)) {
+        DedupReport report = installer.deduplicationReport();
+        out << "Archivos únicos: " << report.blobs << " (" << DiskPreflight::formatBytes(report.storedBytes) << ")\n";
+        out << "Referencias: " << report.links << "\n";
+        out << "Espacio ahorrado: " << DiskPreflight::formatBytes(report.savedBytes) << "\n";
+        foreach (const QString &line, report.perApp) {
+            out << "  " << line << "\n";
+        }
+        out.flush();
+    }
+    
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (isHeadlessCommand(argc, argv)) {
+        return runHeadless(argc, argv);
+    }
+    
+    QApplication app(argc, argv);
+    
+    setApplicationInfo(app);
     
     app.setWindowIcon(QIcon(":/assets/icon.png"));
     
@@ -34,17 +312,30 @@ int main(int argc, char *argv[])
                                            "Crear enlace simbólico en /usr/local/bin");
     QCommandLineOption autoInstallOption(QStringList() << "auto-install", 
                                         "Iniciar instalación automáticamente");
+    QCommandLineOption startupTimingOption(QStringList() << "startup-timing", 
+                                         "Mostrar cuánto tarda la ventana en pintarse por primera vez");
     
     parser.addOption(localFileOption);
     parser.addOption(urlOption);
     parser.addOption(installPathOption);
     parser.addOption(createDesktopOption);
     parser.addOption(createSymlinkOption);
+    parser.addOption(dedupeOption());
+    parser.addOption(dedupeHardlinksOption());
+    parser.addOption(sha256Option());
     parser.addOption(autoInstallOption);
+    parser.addOption(startupTimingOption);
+    parser.addOption(backgroundOption());
+    parser.addOption(ioLimitOption());
+    parser.addOption(preloadOption());
+    parser.addOption(traceOutOption());
     
     parser.process(app);
     
+    TraceSession trace(parser.value("trace-out"));
+    
     MainWindow window;
+    window.setReportStartupTime(parser.isSet(startupTimingOption));
     window.show();
     
     // If auto-install is requested, trigger installation after window is shown
@@ -60,6 +351,12 @@ int main(int argc, char *argv[])
             window.setInstallPath(parser.value(installPathOption));
             window.setCreateDesktop(parser.isSet(createDesktopOption));
             window.setCreateSymlink(parser.isSet(createSymlinkOption));
+            window.setExpectedSha256(parser.value("sha256"));
+            window.setDeduplicate(parser.isSet("dedupe"));
+            window.setDeduplicateHardlinks(parser.isSet("dedupe-hardlinks"));
+            window.setLowPriority(parser.isSet("background"));
+            window.setWarmup(parser.isSet("preload"));
+            window.setIoLimit(parser.value("io-limit").toInt());
             
             // Trigger installation
             window.startAutoInstall();